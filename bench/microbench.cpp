@@ -0,0 +1,431 @@
+/** @file
+ * Microbenchmarks for the Xlib-free model classes.
+ *
+ * Each benchmark is run at several sizes and reports the time and the number
+ * of heap allocations per operation. Run with a substring as the first
+ * argument to only run the benchmarks whose names contain it.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../src/model/changes.hpp"
+#include "../src/model/client-model.hpp"
+#include "../src/model/focus-cycle.hpp"
+#include "../src/model/screen.hpp"
+#include "../src/model/unique-multimap.hpp"
+
+/// How many times operator new has been called
+static unsigned long long allocations = 0;
+
+void * operator new(std::size_t size) {
+    allocations++;
+
+    void *memory = std::malloc(size ? size : 1);
+
+    if (!memory) throw std::bad_alloc();
+
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+/**
+ * A benchmark which can be run at a particular size. The setup isn't
+ * timed - only run() is.
+ */
+struct Benchmark {
+    virtual ~Benchmark() {
+    };
+
+    /// Prepares the data structures for a run of the given size.
+    virtual void setup(unsigned long size) = 0;
+
+    /// Does the work being measured, returning the number of operations done.
+    virtual unsigned long run() = 0;
+
+    /// Cleans up after a run.
+    virtual void teardown() {
+    };
+};
+
+/**
+ * Adds a batch of members across several categories, and then removes them.
+ */
+struct MultimapAddRemove : public Benchmark {
+    void setup(unsigned long size) {
+        members = size;
+
+        for (int category = 0; category < 10; category++) map.add_category(category);
+    };
+
+    unsigned long run() {
+        for (unsigned long member = 0; member < members; member++) map.add_member(member % 10, member);
+
+        for (unsigned long member = 0; member < members; member++) map.remove_member(member);
+
+        return members * 2;
+    };
+
+    unsigned long members;
+    UniqueMultimap<int, Window> map;
+};
+
+/**
+ * Moves every member of a populated multimap to another category.
+ */
+struct MultimapMove : public Benchmark {
+    void setup(unsigned long size) {
+        members = size;
+        shift = 0;
+
+        for (int category = 0; category < 10; category++) map.add_category(category);
+
+        for (unsigned long member = 0; member < members; member++) map.add_member(member % 10, member);
+    };
+
+    unsigned long run() {
+        shift++;
+
+        for (unsigned long member = 0; member < members; member++) map.move_member(member, (member + shift) % 10);
+
+        return members;
+    };
+
+    unsigned long members, shift;
+    UniqueMultimap<int, Window> map;
+};
+
+/**
+ * Walks all the way around a focus cycle, forwards and then backwards.
+ */
+struct FocusCycleTraversal : public Benchmark {
+    void setup(unsigned long size) {
+        windows = size;
+        cycle = new FocusCycle();
+
+        for (unsigned long window = 1; window <= windows; window++) cycle->add(window);
+
+        cycle->set(1);
+    };
+
+    unsigned long run() {
+        for (unsigned long step = 0; step < windows; step++) cycle->forward();
+
+        for (unsigned long step = 0; step < windows; step++) cycle->backward();
+
+        return windows * 2;
+    };
+
+    void teardown() {
+        delete cycle;
+    };
+
+    unsigned long windows;
+    FocusCycle *cycle;
+};
+
+/**
+ * Finds the screens of points spread over a row of screens.
+ */
+struct ScreenOfCoord : public Benchmark {
+    void setup(unsigned long size) {
+        screens = size;
+
+        std::vector<Box> boxes;
+
+        for (unsigned long screen = 0; screen < screens; screen++) boxes.push_back(Box(screen * 1920, 0, 1920, 1080));
+
+        manager.rebuild_graph(boxes);
+    };
+
+    unsigned long run() {
+        const unsigned long queries = 1000;
+
+        for (unsigned long query = 0; query < queries; query++) {
+            Dimension x = (query * 7919) % (screens * 1920);
+            Dimension y = (query * 104729) % 1080;
+
+            if (!manager.screen_of_coord(x, y)) std::abort();
+        }
+
+        return queries;
+    };
+
+    unsigned long screens;
+    CrtManager manager;
+};
+
+/**
+ * Pushes a batch of changes, and then drains them the way that
+ * ClientModelEvents does.
+ */
+struct ChangeBatch : public Benchmark {
+    void setup(unsigned long size) {
+        changes = size;
+    };
+
+    unsigned long run() {
+        for (unsigned long change = 0; change < changes; change++) stream.push(new ChangeLayer(change, change % 10));
+
+        ChangeStream::change_ptr change;
+
+        while ((change = stream.get_next()) != 0) delete change;
+
+        return changes;
+    };
+
+    unsigned long changes;
+    ChangeStream stream;
+};
+
+/**
+ * Gets all the visible clients in stacking order, from a model with clients
+ * spread across every layer.
+ */
+struct VisibleLayerOrder : public Benchmark {
+    void setup(unsigned long size) {
+        in_place = false;
+
+        std::vector<Box> boxes;
+        boxes.push_back(Box(0, 0, 1920, 1080));
+        manager.rebuild_graph(boxes);
+
+        #ifdef WITH_BORDERS
+        clients = new ClientModel(changes, manager, 4, 1);
+        #else
+        clients = new ClientModel(changes, manager, 4);
+        #endif
+
+        for (unsigned long window = 1; window <= size; window++) {
+            clients->add_client(window, IS_VISIBLE, Dimension2D(0, 0),
+                                Dimension2D(100, 100), false);
+            clients->set_layer(window, MIN_LAYER + (window % (MAX_LAYER - MIN_LAYER + 1)));
+        }
+
+        changes.flush();
+    };
+
+    unsigned long run() {
+        const unsigned long queries = 10;
+
+        for (unsigned long query = 0; query < queries; query++) {
+            if (in_place) {
+                ClientModel::layer_order_range visible = clients->visible_in_layer_order();
+
+                for (ClientModel::LayerOrderIterator client = visible.begin();
+                     client != visible.end();
+                     client++) {
+                    if (*client == None) std::abort();
+                }
+            } else {
+                std::vector<Window> visible;
+                clients->get_visible_in_layer_order(visible);
+            }
+        }
+
+        return queries;
+    };
+
+    void teardown() {
+        delete clients;
+        changes.flush();
+    };
+
+    ChangeStream changes;
+    CrtManager manager;
+    ClientModel *clients;
+
+    /// Whether to walk the model in place, rather than copying it out
+    bool in_place;
+};
+
+/**
+ * The same as VisibleLayerOrder, but walking the model in place.
+ */
+struct VisibleLayerView : public VisibleLayerOrder {
+    void setup(unsigned long size) {
+        VisibleLayerOrder::setup(size);
+        in_place = true;
+    };
+};
+
+/**
+ * Finds free space for new clients, in a model with clients scattered across
+ * a screen. Each client moving in between searches means that the visible
+ * boxes have to be rebuilt for the next one.
+ */
+struct FreeSpace : public Benchmark {
+    void setup(unsigned long size) {
+        std::vector<Box> boxes;
+        boxes.push_back(Box(0, 0, 1920, 1080));
+        manager.rebuild_graph(boxes);
+
+        #ifdef WITH_BORDERS
+        clients = new ClientModel(changes, manager, 4, 1);
+        #else
+        clients = new ClientModel(changes, manager, 4);
+        #endif
+
+        for (unsigned long window = 1; window <= size; window++) {
+            clients->add_client(window, IS_VISIBLE,
+                                Dimension2D((window * 97) % 1820, (window * 53) % 980),
+                                Dimension2D(100, 100), false);
+        }
+
+        changes.flush();
+    };
+
+    unsigned long run() {
+        const unsigned long searches = 10;
+
+        for (unsigned long search = 0; search < searches; search++) {
+            clients->find_free_space(Dimension2D(0, 0), Dimension2D(400, 300));
+            clients->update_location(1, search * 10, search * 10);
+        }
+
+        return searches;
+    };
+
+    void teardown() {
+        delete clients;
+        changes.flush();
+    };
+
+    ChangeStream changes;
+    CrtManager manager;
+    ClientModel *clients;
+};
+
+/**
+ * Opens a batch of clients, iconifies and deiconifies them, and then closes
+ * them again, draining the changes after each step the way ClientModelEvents
+ * does. Once the pools have grown to the size of the batch, this shouldn't
+ * need to allocate any changes or per-client sets.
+ */
+struct ClientChurn : public Benchmark {
+    void setup(unsigned long size) {
+        windows = size;
+
+        std::vector<Box> boxes;
+        boxes.push_back(Box(0, 0, 1920, 1080));
+        manager.rebuild_graph(boxes);
+
+        #ifdef WITH_BORDERS
+        clients = new ClientModel(changes, manager, 4, 1);
+        #else
+        clients = new ClientModel(changes, manager, 4);
+        #endif
+    };
+
+    unsigned long run() {
+        for (unsigned long window = 1; window <= windows; window++)
+            clients->add_client(window, IS_VISIBLE, Dimension2D(0, 0),
+                                Dimension2D(100, 100), true);
+
+        drain();
+
+        for (unsigned long window = 1; window <= windows; window++) clients->iconify(window);
+
+        drain();
+
+        for (unsigned long window = 1; window <= windows; window++) clients->deiconify(window);
+
+        drain();
+
+        for (unsigned long window = 1; window <= windows; window++) clients->remove_client(window);
+
+        drain();
+        return windows * 4;
+    };
+
+    void drain() {
+        ChangeStream::change_ptr change;
+
+        while ((change = changes.get_next()) != 0) delete change;
+    };
+
+    void teardown() {
+        delete clients;
+        changes.flush();
+    };
+
+    unsigned long windows;
+    ChangeStream changes;
+    CrtManager manager;
+    ClientModel *clients;
+};
+
+/**
+ * Runs a benchmark at a particular size, repeating it until enough time has
+ * passed to get a stable measurement.
+ */
+template <class BenchmarkType>
+void measure(const char *name, unsigned long size, const char *filter) {
+    if (filter && !std::strstr(name, filter)) return;
+
+    BenchmarkType benchmark;
+    benchmark.setup(size);
+
+    // Warm up any caches and lazily-allocated storage before measuring
+    benchmark.run();
+
+    typedef std::chrono::steady_clock clock;
+    const clock::duration minimum_time = std::chrono::milliseconds(200);
+
+    unsigned long long operations = 0;
+    unsigned long long allocations_before = allocations;
+    clock::time_point start = clock::now();
+    clock::duration elapsed;
+
+    do {
+        operations += benchmark.run();
+        elapsed = clock::now() - start;
+    } while (elapsed < minimum_time);
+
+    unsigned long long allocations_made = allocations - allocations_before;
+    benchmark.teardown();
+
+    double nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+    std::printf("%-24s %8lu %12.1f %12.3f\n", name, size,
+                nanoseconds / operations,
+                static_cast<double>(allocations_made) / operations);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+
+    std::printf("%-24s %8s %12s %12s\n", "benchmark", "size", "ns/op", "allocs/op");
+
+    const unsigned long window_counts[] = { 10, 100, 1000, 0 };
+
+    for (const unsigned long *size = window_counts; *size; size++) {
+        measure<MultimapAddRemove>("multimap-add-remove", *size, filter);
+        measure<MultimapMove>("multimap-move", *size, filter);
+        measure<FocusCycleTraversal>("focus-cycle-traversal", *size, filter);
+        measure<ChangeBatch>("change-batch", *size, filter);
+        measure<VisibleLayerOrder>("visible-layer-order", *size, filter);
+        measure<VisibleLayerView>("visible-layer-view", *size, filter);
+        measure<FreeSpace>("free-space", *size, filter);
+        measure<ClientChurn>("client-churn", *size, filter);
+    }
+
+    const unsigned long screen_counts[] = { 1, 4, 16, 0 };
+
+    for (const unsigned long *size = screen_counts; *size; size++) {
+        measure<ScreenOfCoord>("screen-of-coord", *size, filter);
+    }
+
+    return 0;
+}
@@ -1,5 +1,5 @@
 { lib, stdenv, cmake, ninja, fetchFromGitHub, xorg, xorgserver, pkg-config
-, libX11, libXext, libXrandr }:
+, libX11, libXext, libXrandr, libxcb, libXft, fontconfig, freetype }:
 
 stdenv.mkDerivation (finalAttrs: {
   pname = "smallwm-molasses";
@@ -8,6 +8,6 @@ stdenv.mkDerivation (finalAttrs: {
   src = ../../.;
 
   nativeBuildInputs = [ cmake ninja ];
-  buildInputs = [ libX11 libXext libXrandr ];
+  buildInputs = [ libX11 libXext libXrandr libxcb libXft fontconfig freetype ];
 
 })
@@ -0,0 +1,54 @@
+/** @file */
+#include <cerrno>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cgroup.hpp"
+
+/**
+ * Gets the path of the group of a process.
+ * @param root The cgroup which the groups are created under.
+ * @param pid The process.
+ */
+std::string cgroup_app_path(const std::string &root, unsigned long pid) {
+    std::ostringstream path;
+    path << root << "/app-" << pid;
+    return path.str();
+}
+
+/**
+ * Moves a process into its group, creating the group if it doesn't exist.
+ * This does nothing if the process is already in its group.
+ * @return true if the process is in its group, false otherwise (with errno
+ *      set).
+ */
+bool cgroup_join(const std::string &root, unsigned long pid) {
+    std::string path = cgroup_app_path(root, pid);
+
+    if (mkdir(path.c_str(), 0755) == -1 && errno != EEXIST) return false;
+
+    std::ostringstream pid_text;
+    pid_text << pid;
+    return cgroup_write(path + "/cgroup.procs", pid_text.str());
+}
+
+/**
+ * Writes a value to a cgroup control file, all at once (as the kernel
+ * expects).
+ * @return true if the value was written, false otherwise (with errno set).
+ */
+bool cgroup_write(const std::string &path, const std::string &value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+
+    if (fd == -1) return false;
+
+    ssize_t written = write(fd, value.c_str(), value.size());
+    int write_error = errno;
+    close(fd);
+
+    errno = write_error;
+    return written == static_cast<ssize_t>(value.size());
+}
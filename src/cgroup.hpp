@@ -0,0 +1,18 @@
+/** @file */
+#ifndef __SMALLWM_CGROUP__
+#define __SMALLWM_CGROUP__
+
+#include <string>
+
+/*
+ * Helpers for the per-process groups which SmallWM creates under a cgroup v2
+ * directory that has been delegated to the user. Every subsystem which
+ * controls clients' processes through cgroups shares the same group for each
+ * process, named app-<pid>.
+ */
+
+std::string cgroup_app_path(const std::string&, unsigned long);
+bool cgroup_join(const std::string&, unsigned long);
+bool cgroup_write(const std::string&, const std::string&);
+
+#endif // ifndef __SMALLWM_CGROUP__
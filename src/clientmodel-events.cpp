@@ -1,12 +1,18 @@
+#include <sstream>
+
 #include "clientmodel-events.hpp"
 #include "xdata.hpp"
 
+const unsigned long ClientModelEvents::BATCH_SIZE_BOUNDS[BATCH_SIZE_BUCKETS] = {
+    1, 4, 16, 64, 256
+};
+
 /**
  * Maps all the windows in the given window list.
  */
-void ClientModelEvents::map_all(const std::vector<Window> &windows) {
-    for (std::vector<Window>::const_iterator win = windows.cbegin();
-         win != windows.cend();
+void ClientModelEvents::map_all(ClientModel::child_range windows) {
+    for (ClientModel::child_iter win = windows.begin();
+         win != windows.end();
          win++) {
         m_xmodel.set_effect(*win, EXPECT_MAP);
         m_xdata.map_win(*win);
@@ -17,9 +23,9 @@ void ClientModelEvents::map_all(const std::vector<Window> &windows) {
  * Unmaps all the windows in the given window list, and unfocuses any that might
  * be focused.
  */
-void ClientModelEvents::unmap_unfocus_all(const std::vector<Window> &windows) {
-    for (std::vector<Window>::const_iterator win = windows.cbegin();
-         win != windows.cend();
+void ClientModelEvents::unmap_unfocus_all(ClientModel::child_range windows) {
+    for (ClientModel::child_iter win = windows.begin();
+         win != windows.end();
          win++) {
         m_xmodel.set_effect(*win, EXPECT_UNMAP);
         m_clients.unfocus_if_focused(*win);
@@ -28,19 +34,26 @@ void ClientModelEvents::unmap_unfocus_all(const std::vector<Window> &windows) {
 }
 
 /**
- * Raises a client first, and then puts all its children above it.
+ * Puts a client on top of the (bottom-to-top) stack first, and then puts all
+ * its children above it.
  */
-void ClientModelEvents::raise_family(Window client) {
-    std::vector<Window> children;
-
-    m_clients.get_children_of(client, children);
+void ClientModelEvents::stack_family(Window client, std::vector<Window> &stack) {
+    ClientModel::child_range children = m_clients.children_of(client);
 
-    m_xdata.raise(client);
+    stack.push_back(client);
+    stack.insert(stack.end(), children.begin(), children.end());
+}
 
-    for (std::vector<Window>::iterator win = children.begin();
-         win != children.end();
-         win++) {
-        m_xdata.raise(*win);
+/**
+ * Puts the families of several clients on top of the (bottom-to-top) stack,
+ * in order.
+ */
+void ClientModelEvents::stack_group(const std::vector<Window> &clients,
+                                    std::vector<Window> &stack) {
+    for (std::vector<Window>::const_iterator client = clients.begin();
+         client != clients.end();
+         client++) {
+        stack_family(*client, stack);
     }
 }
 
@@ -52,7 +65,17 @@ void ClientModelEvents::handle_queued_changes() {
     m_should_relayer = false;
     m_should_reposition_icons = false;
 
+    unsigned long batch_size = 0;
+
     while ((m_change = m_changes.get_next()) != 0) {
+        batch_size++;
+
+        for (std::vector<ChangeObserver *>::iterator observer = m_observers.begin();
+             observer != m_observers.end();
+             observer++) {
+            (*observer)->prepare(*m_change);
+        }
+
         if (m_change->is_layer_change()) handle_layer_change();
         else if (m_change->is_focus_change()) handle_focus_change();
         else if (m_change->is_client_desktop_change()) handle_client_desktop_change();
@@ -64,12 +87,72 @@ void ClientModelEvents::handle_queued_changes() {
         else if (m_change->is_destroy_change()) handle_destroy_change();
         else if (m_change->is_unmap_change()) handle_unmap_change();
 
+        for (std::vector<ChangeObserver *>::iterator observer = m_observers.begin();
+             observer != m_observers.end();
+             observer++) {
+            (*observer)->observe(*m_change);
+        }
+
         delete m_change;
     }
 
+    if (batch_size > 0) {
+        int bucket = 0;
+
+        while (bucket < BATCH_SIZE_BUCKETS && batch_size > BATCH_SIZE_BOUNDS[bucket]) bucket++;
+
+        m_batch_sizes[bucket]++;
+        m_batch_changes += batch_size;
+    }
+
     if (m_should_relayer) do_relayer();
 
-    if (m_should_reposition_icons) reposition_icons();
+    if (m_should_reposition_icons || m_clients.get_icon_row() != m_icon_row) reposition_icons();
+
+    m_xdata.end_layout();
+
+    for (std::vector<ChangeObserver *>::iterator observer = m_observers.begin();
+         observer != m_observers.end();
+         observer++) {
+        (*observer)->end_batch();
+    }
+}
+
+/**
+ * Writes out the sizes of the batches of changes that have been handled, and
+ * how often they caused the visible windows to be restacked.
+ */
+void ClientModelEvents::metrics(MetricsWriter &output) {
+    output.family("smallwm_change_batch_size", "histogram",
+                  "Changes handled in each batch.");
+
+    unsigned long long batches = 0;
+
+    for (int bucket = 0; bucket < BATCH_SIZE_BUCKETS; bucket++) {
+        std::ostringstream bound;
+        bound << BATCH_SIZE_BOUNDS[bucket];
+
+        batches += m_batch_sizes[bucket];
+        output.sample("smallwm_change_batch_size_bucket", "le", bound.str(), batches);
+    }
+
+    batches += m_batch_sizes[BATCH_SIZE_BUCKETS];
+    output.sample("smallwm_change_batch_size_bucket", "le", "+Inf", batches);
+    output.sample("smallwm_change_batch_size_sum", m_batch_changes);
+    output.sample("smallwm_change_batch_size_count", batches);
+
+    output.family("smallwm_relayers_total", "counter",
+                  "Times the visible windows were restacked.");
+    output.sample("smallwm_relayers_total", m_relayers);
+}
+
+/**
+ * Registers something to be shown every change, both before and after it
+ * has been applied.
+ * @param observer The observer, which must outlive this object.
+ */
+void ClientModelEvents::add_observer(ChangeObserver *observer) {
+    m_observers.push_back(observer);
 }
 
 /**
@@ -153,6 +236,8 @@ void ClientModelEvents::handle_focus_change() {
  *   MovingDesktop -> UserDesktop
  *
  *   ResizingDesktop -> UserDesktop
+ *
+ *   WarmDesktop -> UserDesktop
  */
 void ClientModelEvents::handle_client_desktop_change() {
     const ChangeClientDesktop *change = dynamic_cast<const ChangeClientDesktop *>(m_change);
@@ -173,8 +258,10 @@ void ClientModelEvents::handle_client_desktop_change() {
                                                                                         client);
     else if (old_desktop->is_resizing_desktop()) handle_client_change_from_resizing_desktop(old_desktop, new_desktop,
                                                                                             client);
+    else if (old_desktop->is_warm_desktop()) handle_client_change_from_warm_desktop(old_desktop, new_desktop,
+                                                                                    client);
     else
-        m_logger.log(LOG_WARNING) <<
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
             "Unanticipated switch by " << client << " from " <<
             old_desktop  << " to " << new_desktop << Log::endl;
 }
@@ -182,8 +269,9 @@ void ClientModelEvents::handle_client_desktop_change() {
 /**
  * Sets the desktop of a newly created client.
  *
- * In this state, the only possibilities are either a UserDesktop or an
- * IconDesktop if the window starts out minimized.
+ * In this state, the only possibilities are either a UserDesktop, an
+ * IconDesktop if the window starts out minimized, or a WarmDesktop if the
+ * window was started ahead of time to be shown later.
  */
 void ClientModelEvents::handle_new_client_desktop_change(Desktop *new_desktop, Window client) {
     if (new_desktop->is_user_desktop()) {
@@ -191,8 +279,11 @@ void ClientModelEvents::handle_new_client_desktop_change(Desktop *new_desktop, W
 
         if (will_be_visible) m_should_relayer = true;
     } else if (new_desktop->is_icon_desktop()) register_new_icon(client, true);
-    else {
-        m_logger.log(LOG_WARNING) <<
+    else if (new_desktop->is_warm_desktop()) {
+        // Warm clients are adopted instead of having their map requests
+        // carried out, so they are already hidden until they are revealed
+    } else {
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
             "New client " << client << " asked to start on desktop " <<
             new_desktop << "- making an icon instead"
                                   << Log::endl;
@@ -215,9 +306,7 @@ void ClientModelEvents::handle_client_change_from_user_desktop(
     Desktop *old_desktop,
     Desktop *new_desktop,
     Window  client) {
-    std::vector<Window> children;
-
-    m_clients.get_children_of(client, children);
+    ClientModel::child_range children = m_clients.children_of(client);
 
     if (new_desktop->is_user_desktop()) {
         bool is_currently_visible = m_clients.is_visible_desktop(old_desktop);
@@ -240,7 +329,7 @@ void ClientModelEvents::handle_client_change_from_user_desktop(
             // Do nothing here - the client will still be invisible and
             // thus will not alter the focus
         } else
-            m_logger.log(LOG_WARNING) <<
+            m_logger.log(LOG_WARNING, LOG_SITE) <<
                 "If client is switched from a " << old_desktop << " to "
                                       << new_desktop << " then it cannot be visible in both places."
                                       << Log::endl;
@@ -288,9 +377,7 @@ void ClientModelEvents::handle_client_change_from_all_desktop(
     Desktop *old_desktop,
     Desktop *new_desktop,
     Window  client) {
-    std::vector<Window> children;
-
-    m_clients.get_children_of(client, children);
+    ClientModel::child_range children = m_clients.children_of(client);
 
     if (new_desktop->is_user_desktop()) {
         bool will_be_visible = m_clients.is_visible_desktop(new_desktop);
@@ -324,16 +411,14 @@ void ClientModelEvents::handle_client_change_from_icon_desktop(
     Desktop *old_desktop,
     Desktop *new_desktop,
     Window  client) {
-    std::vector<Window> children;
-
-    m_clients.get_children_of(client, children);
+    ClientModel::child_range children = m_clients.children_of(client);
 
     if (new_desktop->is_user_desktop() || new_desktop->is_all_desktop()) {
         // Get the relevant icon information, and destroy it
         Icon *icon = m_xmodel.find_icon_from_client(client);
 
         if (!icon)
-            m_logger.log(LOG_ERR) <<
+            m_logger.log(LOG_ERR, LOG_SITE) <<
                 "Tried to de-iconify a client (" << client << ") "
                 "that is not currently iconified." << Log::endl;
         else {
@@ -366,15 +451,13 @@ void ClientModelEvents::handle_client_change_from_moving_desktop(
     Desktop *old_desktop,
     Desktop *new_desktop,
     Window  client) {
-    std::vector<Window> children;
-
-    m_clients.get_children_of(client, children);
+    ClientModel::child_range children = m_clients.children_of(client);
 
     if (new_desktop->is_user_desktop() || new_desktop->is_all_desktop()) {
         Window placeholder = m_xmodel.get_move_resize_placeholder();
 
         if (placeholder == None)
-            m_logger.log(LOG_ERR) <<
+            m_logger.log(LOG_ERR, LOG_SITE) <<
                 "Tried to stop moving a client (" << client << ") "
                 "that is not currently moving." << Log::endl;
         else {
@@ -410,15 +493,13 @@ void ClientModelEvents::handle_client_change_from_resizing_desktop(
     Desktop *old_desktop,
     Desktop *new_desktop,
     Window  client) {
-    std::vector<Window> children;
-
-    m_clients.get_children_of(client, children);
+    ClientModel::child_range children = m_clients.children_of(client);
 
     if (new_desktop->is_user_desktop() || new_desktop->is_all_desktop()) {
         Window placeholder = m_xmodel.get_move_resize_placeholder();
 
         if (placeholder == None)
-            m_logger.log(LOG_ERR) <<
+            m_logger.log(LOG_ERR, LOG_SITE) <<
                 "Tried to stop resizing a client (" << client << ") "
                 "that is not currently resizing." << Log::endl;
         else {
@@ -445,6 +526,24 @@ void ClientModelEvents::handle_client_change_from_resizing_desktop(
     }
 }
 
+/**
+ * Changes the desktop of a client from the warm desktop, which only happens
+ * when the client is revealed onto the current desktop.
+ */
+void ClientModelEvents::handle_client_change_from_warm_desktop(
+    Desktop *old_desktop,
+    Desktop *new_desktop,
+    Window  client) {
+    if (!m_clients.is_visible_desktop(new_desktop)) return;
+
+    m_xmodel.set_effect(client, EXPECT_MAP);
+    m_xdata.map_win(client);
+    m_clients.focus(client);
+
+    map_all(m_clients.children_of(client));
+    m_should_relayer = true;
+}
+
 /**
  * This changes the currently visible desktop, which involves figuring out
  * which windows are visible on the current desktop, which are not, and then
@@ -453,67 +552,32 @@ void ClientModelEvents::handle_client_change_from_resizing_desktop(
 void ClientModelEvents::handle_current_desktop_change() {
     const ChangeCurrentDesktop *change = dynamic_cast<const ChangeCurrentDesktop *>(m_change);
 
-    std::vector<Window> old_desktop_list;
-    std::vector<Window> new_desktop_list;
-
-    m_clients.get_clients_of(change->prev_desktop, old_desktop_list);
-    m_clients.get_clients_of(change->next_desktop, new_desktop_list);
-
-    // The output size will have, at most, the size of its largest input
-    size_t max_output_size = std::max(old_desktop_list.size(),
-                                      new_desktop_list.size());
-
-    // std::set_difference requires sorted inputs
-    std::sort(old_desktop_list.begin(), old_desktop_list.end());
-    std::sort(new_desktop_list.begin(), new_desktop_list.end());
-
-    std::vector<Window> to_make_invisible;
-    std::vector<Window> to_make_visible;
-
-    // Fill out all of the output vectors to the length of the input iterators,
-    // so that std::set_difference has somewhere to put the data
-    to_make_invisible.resize(max_output_size, None);
-    to_make_visible.resize(max_output_size, None);
-
-    // The old -> new set difference will produce the list of windows
-    // which are on the old desktop, but not this one - these need to be
-    // hidden
-    std::set_difference(
-        old_desktop_list.begin(), old_desktop_list.end(),
-        new_desktop_list.begin(), new_desktop_list.end(),
-        to_make_invisible.begin());
-
-    for (std::vector<Window>::iterator to_hide = to_make_invisible.begin();
-         /* The extra check that the iterator is not None is necessary,
-          * since the vector was padded with None when it was resized.
-          */
-         to_hide != to_make_invisible.end() && *to_hide != None;
+    // Every client is on exactly one desktop, so (unless the desktop didn't
+    // actually change) everything on the old desktop has to be hidden, and
+    // everything on the new one has to be shown. Neither of these change
+    // which clients are on which desktops, so they can be walked in place.
+    if (*change->prev_desktop == *change->next_desktop) return;
+
+    ClientModel::client_range to_make_invisible = m_clients.clients_of(change->prev_desktop);
+
+    for (ClientModel::client_iter to_hide = to_make_invisible.begin();
+         to_hide != to_make_invisible.end();
          to_hide++) {
         m_xmodel.set_effect(*to_hide, EXPECT_UNMAP);
         m_xdata.unmap_win(*to_hide);
 
-        std::vector<Window> children;
-        m_clients.get_children_of(*to_hide, children);
-        unmap_unfocus_all(children);
+        unmap_unfocus_all(m_clients.children_of(*to_hide));
     }
 
-    // The new -> old set difference will produce the list of windows which
-    // are on the new desktop, but not on the old - these need to be made
-    // visible
-    std::set_difference(
-        new_desktop_list.begin(), new_desktop_list.end(),
-        old_desktop_list.begin(), old_desktop_list.end(),
-        to_make_visible.begin());
+    ClientModel::client_range to_make_visible = m_clients.clients_of(change->next_desktop);
 
-    for (std::vector<Window>::iterator to_show = to_make_visible.begin();
-         to_show != to_make_visible.end() && *to_show != None;
+    for (ClientModel::client_iter to_show = to_make_visible.begin();
+         to_show != to_make_visible.end();
          to_show++) {
         m_xmodel.set_effect(*to_show, EXPECT_MAP);
         m_xdata.map_win(*to_show);
 
-        std::vector<Window> children;
-        m_clients.get_children_of(*to_show, children);
-        map_all(children);
+        map_all(m_clients.children_of(*to_show));
     }
 
     // Since we've made some windows visible and some others invisible, we've
@@ -665,6 +729,12 @@ void ClientModelEvents::register_new_icon(Window client, bool do_unmap) {
 
     m_clients.unfocus_if_focused(client);
 
+    #ifdef WITH_THUMBNAILS
+    // This has to happen before the client is unmapped, since there's
+    // nothing to capture afterwards
+    if (m_config.icon_thumbnails) update_thumbnail(client);
+    #endif
+
     if (do_unmap) {
         m_xmodel.set_effect(client, EXPECT_UNMAP);
         m_xdata.unmap_win(client);
@@ -675,6 +745,43 @@ void ClientModelEvents::register_new_icon(Window client, bool do_unmap) {
     m_should_reposition_icons = true;
 }
 
+#ifdef WITH_THUMBNAILS
+/**
+ * Recaptures a client's thumbnail, if it has changed since it was last
+ * captured and it wasn't captured too recently. A client which is iconified
+ * repeatedly keeps its older thumbnail until the interval has passed.
+ *
+ * @param client The client to capture.
+ */
+void ClientModelEvents::update_thumbnail(Window client) {
+    Thumbnail *thumbnail = m_xmodel.find_thumbnail(client);
+
+    if (!thumbnail || !thumbnail->stale) return;
+
+    unsigned long long now = monotonic_usec();
+
+    if (thumbnail->pixmap != None &&
+        now - thumbnail->captured_at < m_config.thumbnail_interval * 1000ULL) return;
+
+    // Leave room for the label next to the thumbnail
+    Dimension width, height;
+    Pixmap pixmap = m_xdata.capture_thumbnail(client, thumbnail->damage,
+                                              m_config.icon_width / 2,
+                                              m_config.icon_height,
+                                              width, height);
+
+    if (pixmap == None) return;
+
+    if (thumbnail->pixmap != None) m_xdata.free_pixmap(thumbnail->pixmap);
+
+    thumbnail->pixmap = pixmap;
+    thumbnail->width = width;
+    thumbnail->height = height;
+    thumbnail->stale = false;
+    thumbnail->captured_at = now;
+}
+#endif
+
 /**
  * Creates and configures a placeholder window, used for moving/resizing a
  * client.
@@ -756,12 +863,15 @@ void ClientModelEvents::start_resizing(Window client) {
  * Actually does the relayering.
  *
  * This involves sorting the clients, and then sticking the icons and
- * move/resize placeholder on the top.
+ * move/resize placeholder on the top. The whole stack is sent to the server
+ * as a single restack, rather than raising each window in turn.
  */
 void ClientModelEvents::do_relayer() {
-    std::vector<Window> ordered_windows;
+    m_relayers++;
 
-    m_clients.get_visible_in_layer_order(ordered_windows);
+    // Relayering only changes the X stacking order, so the model can be
+    // walked in place
+    ClientModel::layer_order_range ordered_windows = m_clients.visible_in_layer_order();
 
     // Figure out the currently focused client, and where it's at. We'll need
     // this information in order to place it above its peers.
@@ -773,14 +883,36 @@ void ClientModelEvents::do_relayer() {
 
     Layer focused_layer;
 
-    if (focused_window != None) focused_layer = m_clients.find_layer(focused_window);
+    // The rest of the focused client's window group on the same layer goes
+    // up along with it, just underneath it
+    std::vector<Window> &focused_group = m_focused_group;
+    focused_group.clear();
+
+    if (focused_window != None) {
+        focused_layer = m_clients.find_layer(focused_window);
+        m_clients.get_group_members(focused_window, focused_group);
 
-    for (std::vector<Window>::iterator client_iter = ordered_windows.begin();
+        std::vector<Window>::iterator member = focused_group.begin();
+
+        while (member != focused_group.end()) {
+            if (*member == focused_window ||
+                !m_clients.is_visible(*member) ||
+                m_clients.find_layer(*member) != focused_layer)
+                member = focused_group.erase(member);
+            else member++;
+        }
+    }
+
+    // This is built from the bottom up, and reversed at the end
+    std::vector<Window> &stack = m_stack;
+    std::vector<Window> &raised_group = m_raised_group;
+    stack.clear();
+    raised_group.clear();
+
+    for (ClientModel::LayerOrderIterator client_iter = ordered_windows.begin();
          client_iter != ordered_windows.end();
          client_iter++) {
         Window current_client = *client_iter;
-        std::vector<Window> children;
-        m_clients.get_children_of(*client_iter, children);
 
         Layer current_layer = m_clients.find_layer(current_client);
 
@@ -791,37 +923,49 @@ void ClientModelEvents::do_relayer() {
         // put up the focused window
         if (focused_window != None &&
             current_layer > focused_layer) {
-            raise_family(focused_window);
+            stack_group(raised_group, stack);
+            stack_family(focused_window, stack);
 
             // Make sure to erase the focused client, so that we don't raise
             // it more than once
             focused_window = None;
         }
 
-        if (current_client != focused_window) raise_family(current_client);
+        if (focused_window != None &&
+            contains(focused_group.begin(), focused_group.end(), current_client)) {
+            // Keep these in the order they were in, but hold them back until
+            // the focused window goes up
+            raised_group.push_back(current_client);
+            continue;
+        }
+
+        if (current_client != focused_window) stack_family(current_client, stack);
     }
 
     // If we haven't cleared the focused window, then we need to raise it before
     // moving on
-    if (focused_window != None) raise_family(focused_window);
+    if (focused_window != None) {
+        stack_group(raised_group, stack);
+        stack_family(focused_window, stack);
+    }
 
     // Now, raise all the icons since they should always be above all other
     // windows so they aren't obscured
-    std::vector<Icon *> icon_list;
-
-    m_xmodel.get_icons(icon_list);
+    XModel::icon_range icon_list = m_xmodel.icons();
 
-    for (std::vector<Icon *>::iterator icon = icon_list.begin();
+    for (XModel::IconIterator icon = icon_list.begin();
          icon != icon_list.end();
          icon++) {
-        Window icon_win = (*icon)->icon;
-        m_xdata.raise(icon_win);
+        stack.push_back((*icon)->icon);
     }
 
     // Don't obscure the placeholder, since the user is actively working with it
     Window placeholder_win = m_xmodel.get_move_resize_placeholder();
 
-    if (placeholder_win != None) m_xdata.raise(placeholder_win);
+    if (placeholder_win != None) stack.push_back(placeholder_win);
+
+    std::reverse(stack.begin(), stack.end());
+    m_xdata.restack(stack);
 }
 
 /**
@@ -831,22 +975,23 @@ void ClientModelEvents::do_relayer() {
  * toward the bottom right.
  */
 void ClientModelEvents::reposition_icons() {
-    Dimension x = 0, y = 0;
+    // Remember where the row was, so that it can be moved if a dock moves it
+    const Box &row = m_clients.get_icon_row();
+    m_icon_row = row;
+
+    Dimension x = row.x, y = row.y;
 
     const Dimension icon_width = m_config.icon_width,
                     icon_height = m_config.icon_height;
-    const Box &screen = m_clients.get_root_screen();
-
-    std::vector<Icon *> icon_list;
 
-    m_xmodel.get_icons(icon_list);
+    XModel::icon_range icon_list = m_xmodel.icons();
 
-    for (std::vector<Icon *>::iterator icon_iter = icon_list.begin();
+    for (XModel::IconIterator icon_iter = icon_list.begin();
          icon_iter != icon_list.end(); icon_iter++) {
         Icon *the_icon = *icon_iter;
 
-        if (x + icon_width > screen.width) {
-            x = 0;
+        if (x + icon_width > row.x + row.width) {
+            x = row.x;
             y += icon_height;
         }
 
@@ -859,27 +1004,16 @@ void ClientModelEvents::reposition_icons() {
  * Updates the location and size of a window based upon its current CPS mode.
  */
 void ClientModelEvents::update_location_size_for_cps(Window client, ClientPosScale mode) {
-    const Box &screen = m_clients.get_screen(client);
+    // The work area already leaves out docks and the icon row
+    const Box &area = m_clients.get_work_area(client);
 
-    int left_x = screen.x;
-    int right_x = left_x + screen.width;
-    int middle_x = left_x + screen.width / 2;
+    int left_x = area.x;
+    int right_x = left_x + area.width;
+    int middle_x = left_x + area.width / 2;
 
-    int top_y = screen.y;
-    int bottom_y = top_y + screen.height;
-    int middle_y = top_y + screen.height / 2;
-
-    // If the client is on the root screen, then the icon row has to be taken
-    // into account
-    if (screen.x == 0 && screen.y == 0) {
-        top_y = screen.y + m_config.icon_height;
-
-        int working_height = screen.height - m_config.icon_height;
-        middle_y = top_y + working_height / 2;
-    } else {
-        top_y = screen.y;
-        middle_y = top_y + screen.height / 2;
-    }
+    int top_y = area.y;
+    int bottom_y = top_y + area.height;
+    int middle_y = top_y + area.height / 2;
 
     #ifdef WITH_BORDERS
     Dimension border = m_config.border_width * 2;
@@ -921,8 +1055,6 @@ void ClientModelEvents::update_location_size_for_cps(Window client, ClientPosSca
 void ClientModelEvents::handle_unmap_change() {
     const UnmapChange *change_event = dynamic_cast<const UnmapChange *>(m_change);
 
-    std::vector<Window> children;
-
-    m_clients.get_children_of(change_event->window, children);
+    ClientModel::child_range children = m_clients.children_of(change_event->window);
     unmap_unfocus_all(children);
 }
@@ -11,6 +11,7 @@
 #include "configparse.hpp"
 #include "common.hpp"
 #include "logging/logging.hpp"
+#include "metrics.hpp"
 #include "utils.hpp"
 #include "xdata.hpp"
 
@@ -28,13 +29,29 @@ ClientModelEvents(WMConfig &config, Log &logger, ChangeStream &changes,
                   XData &xdata, ClientModel &clients, XModel &xmodel) :
     m_config(config), m_xdata(xdata), m_clients(clients), m_xmodel(xmodel),
     m_changes(changes), m_logger(logger),
-    m_change(0), m_should_relayer(false), m_should_reposition_icons(false) {
+    m_change(0), m_should_relayer(false), m_should_reposition_icons(false),
+    m_batch_changes(0), m_relayers(0) {
+    std::fill(m_batch_sizes, m_batch_sizes + BATCH_SIZE_BUCKETS + 1, 0);
 };
 
 void handle_queued_changes();
 
+void add_observer(ChangeObserver *);
+
+void metrics(MetricsWriter&);
+
 private:
+/** How many buckets (not counting the last, unbounded one) that the sizes of
+ * batches are sorted into */
+static const int BATCH_SIZE_BUCKETS = 5;
+
+/// The largest batch size in each bucket
+static const unsigned long BATCH_SIZE_BOUNDS[BATCH_SIZE_BUCKETS];
+
 void register_new_icon(Window, bool);
+#ifdef WITH_THUMBNAILS
+void update_thumbnail(Window);
+#endif
 Window create_placeholder(Window);
 void start_moving(Window);
 void start_resizing(Window);
@@ -60,10 +77,12 @@ void handle_client_change_from_all_desktop(Desktop * const, Desktop * const, Win
 void handle_client_change_from_icon_desktop(Desktop * const, Desktop * const, Window);
 void handle_client_change_from_moving_desktop(Desktop * const, Desktop * const, Window);
 void handle_client_change_from_resizing_desktop(Desktop * const, Desktop * const, Window);
+void handle_client_change_from_warm_desktop(Desktop * const, Desktop * const, Window);
 
-void map_all(const std::vector<Window>&);
-void unmap_unfocus_all(const std::vector<Window>&);
-void raise_family(Window);
+void map_all(ClientModel::child_range);
+void unmap_unfocus_all(ClientModel::child_range);
+void stack_family(Window, std::vector<Window>&);
+void stack_group(const std::vector<Window>&, std::vector<Window>&);
 
 /// The stream of changes to read from
 ChangeStream &m_changes;
@@ -87,6 +106,9 @@ XModel &m_xmodel;
 /// The event handler's logger
 Log &m_logger;
 
+/// Everything which sees the changes after they have been applied
+std::vector<ChangeObserver *> m_observers;
+
 /** Whether or not to relayer the visible windows - this allows this class
  * to avoid restacking windows on every `ChangeLayer`, and instead only do
  * it once at the end of `handle_queued_changes`. */
@@ -96,5 +118,23 @@ bool m_should_relayer;
  * should reposition all the icon windows at the end of `handle_queued_changes`.
  */
 bool m_should_reposition_icons;
+
+/// Where the icon row was when the icons were last positioned
+Box m_icon_row;
+
+/** Scratch space for do_relayer - these are kept between relayers, so that
+ * once they have grown to fit every visible client, relayering doesn't
+ * allocate */
+std::vector<Window> m_stack, m_raised_group, m_focused_group;
+
+/** How many non-empty batches of changes have fallen into each bucket (see
+ * BATCH_SIZE_BOUNDS) - the last bucket has the batches too big for the rest */
+unsigned long m_batch_sizes[BATCH_SIZE_BUCKETS + 1];
+
+/// How many changes have been handled, across every batch
+unsigned long long m_batch_changes;
+
+/// How many times the visible windows have been restacked
+unsigned long m_relayers;
 };
 #endif // ifndef __SMALLWM_CLIENTMODEL_EVENTS__
@@ -57,6 +57,44 @@ static std::ostream &operator<<(std::ostream &out, const Box &box) {
     return out;
 }
 
+/**
+ * The space which a dock reserves along the edges of the root window, as
+ * given by _NET_WM_STRUT_PARTIAL. The space reserved on each edge only applies
+ * to the part of that edge between its start and end coordinates.
+ */
+struct Strut {
+    Strut() :
+        left(0), right(0), top(0), bottom(0),
+        left_start_y(0), left_end_y(0), right_start_y(0), right_end_y(0),
+        top_start_x(0), top_end_x(0), bottom_start_x(0), bottom_end_x(0) {
+    }
+
+    bool operator ==(const Strut &other) const {
+        return other.left == left && other.right == right &&
+               other.top == top && other.bottom == bottom &&
+               other.left_start_y == left_start_y && other.left_end_y == left_end_y &&
+               other.right_start_y == right_start_y && other.right_end_y == right_end_y &&
+               other.top_start_x == top_start_x && other.top_end_x == top_end_x &&
+               other.bottom_start_x == bottom_start_x && other.bottom_end_x == bottom_end_x;
+    }
+
+    bool operator !=(const Strut &other) const {
+        return !(other == *this);
+    }
+
+    /// Whether or not this reserves any space at all
+    bool empty() const {
+        return left == 0 && right == 0 && top == 0 && bottom == 0;
+    }
+
+    /// The width or height reserved on each edge of the root window
+    Dimension left, right, top, bottom;
+
+    /// The range of each edge that the reservation covers (inclusive)
+    Dimension left_start_y, left_end_y, right_start_y, right_end_y,
+              top_start_x, top_end_x, bottom_start_x, bottom_end_x;
+};
+
 /**
  * Directions are used both for snapping in the configuration loader, as well
  * as for moving windows to different relative screens.
@@ -27,10 +27,33 @@ void WMConfig::reset() {
     border_width = 4;
     #endif
     show_icons = true;
+    icon_font = "sans-serif:size=9";
+    #ifdef WITH_THUMBNAILS
+    icon_thumbnails = false;
+    thumbnail_interval = 1000;
+    #endif
     log_mask = LOG_UPTO(LOG_WARNING);
     hotkey = HK_MOUSE;
     log_file = "syslog";
+    log_dedup_window = 5000;
+    log_rate_limit = 10;
+    log_rate_burst = 20;
     dump_file = "/dev/null";
+    worker_threads = 2;
+    move_step = 10;
+    latency_probe = false;
+    focus_follows_mouse = false;
+    focus_delay = 50;
+    group_actions = false;
+    event_socket = "";
+    warm_terminals = 0;
+    cgroup_root = "";
+    freeze_delay = 5000;
+    metrics_file = "";
+    metrics_interval = 15;
+    request_rate_limit = 60;
+    request_rate_burst = 30;
+    journal_file = "";
 
     key_commands.reset();
     classactions.clear();
@@ -82,6 +105,15 @@ int WMConfig::config_parser(void *user, const char *c_section,
 #undef SYSLOG_MACRO_CHECK
         } else if (name == std::string("log-file")) {
             if (value.size() > 0) self->log_file = value;
+        } else if (name == std::string("log-dedup-window")) {
+            self->log_dedup_window = try_parse_ulong(value.c_str(),
+                                                     self->log_dedup_window);
+        } else if (name == std::string("log-rate-limit")) {
+            self->log_rate_limit = try_parse_ulong(value.c_str(),
+                                                   self->log_rate_limit);
+        } else if (name == std::string("log-rate-burst")) {
+            self->log_rate_burst = try_parse_ulong_nonzero(value.c_str(),
+                                                           self->log_rate_burst);
         } else if (name == std::string("hotkey-mode")) {
             if (value == std::string("focus")) self->hotkey = HK_FOCUS;
             else if (value == std::string("mouse")) self->hotkey = HK_MOUSE;
@@ -107,8 +139,67 @@ int WMConfig::config_parser(void *user, const char *c_section,
             self->show_icons =
                 try_parse_ulong(value.c_str(),
                                 static_cast<unsigned long>(old_value)) != 0;
+        } else if (name == std::string("icon-font")) {
+            if (value.size() > 0) self->icon_font = value;
+        #ifdef WITH_THUMBNAILS
+        } else if (name == std::string("icon-thumbnails")) {
+            bool old_value = self->icon_thumbnails;
+            self->icon_thumbnails =
+                try_parse_ulong(value.c_str(),
+                                static_cast<unsigned long>(old_value)) != 0;
+        } else if (name == std::string("thumbnail-interval")) {
+            self->thumbnail_interval = try_parse_ulong(value.c_str(),
+                                                       self->thumbnail_interval);
+        #endif
         } else if (name == std::string("dump-file")) {
             if (value.size() > 0) self->dump_file = value;
+        } else if (name == std::string("worker-threads")) {
+            self->worker_threads = try_parse_ulong(value.c_str(),
+                                                   self->worker_threads);
+        } else if (name == std::string("move-step")) {
+            self->move_step = try_parse_ulong_nonzero(value.c_str(),
+                                                      self->move_step);
+        } else if (name == std::string("latency-probe")) {
+            bool old_value = self->latency_probe;
+            self->latency_probe =
+                try_parse_ulong(value.c_str(),
+                                static_cast<unsigned long>(old_value)) != 0;
+        } else if (name == std::string("focus-follows-mouse")) {
+            bool old_value = self->focus_follows_mouse;
+            self->focus_follows_mouse =
+                try_parse_ulong(value.c_str(),
+                                static_cast<unsigned long>(old_value)) != 0;
+        } else if (name == std::string("focus-delay")) {
+            self->focus_delay = try_parse_ulong(value.c_str(),
+                                                self->focus_delay);
+        } else if (name == std::string("group-actions")) {
+            bool old_value = self->group_actions;
+            self->group_actions =
+                try_parse_ulong(value.c_str(),
+                                static_cast<unsigned long>(old_value)) != 0;
+        } else if (name == std::string("event-socket")) {
+            self->event_socket = value;
+        } else if (name == std::string("warm-terminals")) {
+            self->warm_terminals = try_parse_ulong(value.c_str(),
+                                                   self->warm_terminals);
+        } else if (name == std::string("cgroup-root")) {
+            self->cgroup_root = value;
+        } else if (name == std::string("freeze-delay")) {
+            self->freeze_delay = try_parse_ulong(value.c_str(),
+                                                 self->freeze_delay);
+        } else if (name == std::string("metrics-file")) {
+            self->metrics_file = value;
+        } else if (name == std::string("metrics-interval")) {
+            self->metrics_interval = try_parse_ulong_nonzero(value.c_str(),
+                                                             self->metrics_interval);
+        } else if (name == std::string("request-rate-limit")) {
+            self->request_rate_limit = try_parse_ulong(value.c_str(),
+                                                       self->request_rate_limit);
+        } else if (name == std::string("request-rate-burst")) {
+            self->request_rate_burst = try_parse_ulong_nonzero(value.c_str(),
+                                                               self->request_rate_burst);
+        } else if (name == std::string("journal-file")) {
+            self->journal_file = value;
         }
     } else if (section == std::string("actions")) {
         ClassActions action;
@@ -181,6 +272,9 @@ int WMConfig::config_parser(void *user, const char *c_section,
                 // This looks different, because it is not an action, but a
                 // persistent setting which is respected in multiple places
                 self->no_autofocus.push_back(name);
+            } else if (!strcmp(stripped, "freeze")) {
+                // Like nofocus, this is a setting rather than an action
+                self->freeze_classes.push_back(name);
             } else if (!strncmp(stripped, "pack:", 5)) {
                 bool is_valid = true;
 
@@ -30,6 +30,8 @@ enum KeyboardAction {
     LAYER_ABOVE, LAYER_BELOW, LAYER_TOP, LAYER_BOTTOM,
     LAYER_1, LAYER_2, LAYER_3, LAYER_4, LAYER_5, LAYER_6, LAYER_7, LAYER_8, LAYER_9,
     CYCLE_FOCUS, CYCLE_FOCUS_BACK,
+    MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT,
+    GROW_WIDTH, SHRINK_WIDTH, GROW_HEIGHT, SHRINK_HEIGHT,
     EXIT_WM
 };
 
@@ -99,6 +101,14 @@ struct KeyboardConfig {
             { LAYER_9,             "layer-9",             XK_9,                     false            },
             { CYCLE_FOCUS,         "cycle-focus",         XK_Tab,                   false            },
             { CYCLE_FOCUS_BACK,    "cycle-focus-back",    XK_Tab,                   true             },
+            { MOVE_UP,             "move-up",             XK_w,                     false            },
+            { MOVE_DOWN,           "move-down",           XK_s,                     false            },
+            { MOVE_LEFT,           "move-left",           XK_a,                     false            },
+            { MOVE_RIGHT,          "move-right",          XK_d,                     false            },
+            { GROW_WIDTH,          "grow-width",          XK_d,                     true             },
+            { SHRINK_WIDTH,        "shrink-width",        XK_a,                     true             },
+            { GROW_HEIGHT,         "grow-height",         XK_s,                     true             },
+            { SHRINK_HEIGHT,       "shrink-height",       XK_w,                     true             },
             { EXIT_WM,             "exit",                XK_Escape,                false            },
         };
 
@@ -160,6 +170,15 @@ int log_mask;
 /// The filename to dump logs in, or "syslog" to use syslog
 std::string log_file;
 
+/// How long (in milliseconds) identical log messages are folded together
+unsigned long log_dedup_window;
+
+/// How many messages each logging site may write per second (0 is unlimited)
+unsigned long log_rate_limit;
+
+/// How many messages each logging site may write in a single burst
+unsigned long log_rate_burst;
+
 /// The shell to run.
 std::string shell;
 
@@ -185,12 +204,80 @@ std::map<std::string, ClassActions> classactions;
 /// All of the X11 classes which should not be focusable by default
 std::vector<std::string> no_autofocus;
 
+/// All of the X11 classes whose processes are frozen while they are hidden
+std::vector<std::string> freeze_classes;
+
 /// Whether or not to show images inside icons for hidden windows
 bool show_icons;
 
+/// The Fontconfig pattern of the font used for icon labels (with Xft)
+std::string icon_font;
+
+#ifdef WITH_THUMBNAILS
+/// Whether or not to show a thumbnail of the window inside its icon
+bool icon_thumbnails;
+
+/// The minimum time, in milliseconds, between captures of the same window
+unsigned long thumbnail_interval;
+#endif
+
 /// The filename to dump the current state to when SIGUSR1 is received
 std::string dump_file;
 
+/// How many threads to use for work which doesn't need the X connection
+unsigned long worker_threads;
+
+/** How far, in pixels, the keyboard moves or resizes a client by on each
+ * press (holding the key down accelerates this) */
+unsigned long move_step;
+
+/// Whether or not to measure the latency of input events (for the dump)
+bool latency_probe;
+
+/// Whether or not the focus follows the pointer into clients
+bool focus_follows_mouse;
+
+/** How long, in milliseconds, the pointer has to stay in a client before it
+ * is focused (when focus follows the pointer) */
+unsigned long focus_delay;
+
+/** Whether or not iconifying, sticking and moving a client between desktops
+ * applies to its whole window group */
+bool group_actions;
+
+/// The Unix socket to send model events to subscribers on (empty to disable)
+std::string event_socket;
+
+/** How many shells to start ahead of time and keep hidden, so that launching
+ * one only has to show it (0 to disable) */
+unsigned long warm_terminals;
+
+/** The cgroup (delegated to the user) to put clients' processes under, so that
+ * their CPU weights can follow the focus (empty to disable) */
+std::string cgroup_root;
+
+/** How long, in milliseconds, a client (of a class which can be frozen) has
+ * to stay hidden before its process is frozen */
+unsigned long freeze_delay;
+
+/** The file to write metrics to, for Prometheus' textfile collector (empty to
+ * disable) */
+std::string metrics_file;
+
+/// How often, in seconds, to write out the metrics
+unsigned long metrics_interval;
+
+/** How many configure, circulate and map requests each client may make per
+ * second, before the rest are merged together (0 means no limit) */
+unsigned long request_rate_limit;
+
+/// How many of those requests each client may make in a single burst
+unsigned long request_rate_burst;
+
+/** The file to journal the state of every client to, so that it can be put
+ * back after SmallWM restarts (empty to disable) */
+std::string journal_file;
+
 protected:
 virtual std::string get_config_path() const;
 
@@ -0,0 +1,220 @@
+/** @file */
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "cgroup.hpp"
+#include "cpu-weighting.hpp"
+#include "utils.hpp"
+
+/**
+ * Starts weighting clients' processes, by creating their groups under the
+ * given cgroup. The cgroup has to be delegated to the user running SmallWM
+ * (for example, by systemd with Delegate=yes), and can't have any processes
+ * of its own.
+ *
+ * @param root The path of the cgroup, under /sys/fs/cgroup.
+ * @return true if the cpu controller could be enabled for the cgroup's
+ *      children, false otherwise.
+ */
+bool CpuWeighting::enable(const std::string &root) {
+    if (!cgroup_write(root + "/cgroup.subtree_control", "+cpu")) {
+        m_logger.log(LOG_ERR) <<
+            "Could not enable the cpu controller under '" << root << "': " <<
+            std::strerror(errno) << Log::endl;
+        return false;
+    }
+
+    m_root = root;
+    return true;
+}
+
+/**
+ * Notes which processes are affected by a change, so that their weights can
+ * be recomputed at the end of the batch.
+ */
+void CpuWeighting::observe(const Change &change) {
+    if (change.is_focus_change()) {
+        const ChangeFocus &focus = dynamic_cast<const ChangeFocus&>(change);
+
+        mark_dirty(focus.prev_focus);
+        mark_dirty(focus.next_focus);
+    } else if (change.is_client_desktop_change()) {
+        const ChangeClientDesktop &desktop =
+            dynamic_cast<const ChangeClientDesktop&>(change);
+
+        // New clients don't have a previous desktop
+        if (!desktop.prev_desktop) add_client(desktop.window);
+
+        mark_dirty(desktop.window);
+    } else if (change.is_current_desktop_change()) {
+        // Changing the desktop can hide or show any client
+        m_all_dirty = true;
+    } else if (change.is_destroy_change()) {
+        const DestroyChange &destroy = dynamic_cast<const DestroyChange&>(change);
+        remove_client(destroy.window);
+    }
+}
+
+/**
+ * Writes out the new weights of every process affected by the batch.
+ */
+void CpuWeighting::end_batch() {
+    if (m_all_dirty) {
+        for (std::map<unsigned long, Group>::iterator group = m_groups.begin();
+             group != m_groups.end();
+             group++) {
+            update_weight(group->first, group->second);
+        }
+    } else {
+        for (std::set<unsigned long>::iterator pid = m_dirty.begin();
+             pid != m_dirty.end();
+             pid++) {
+            std::map<unsigned long, Group>::iterator group = m_groups.find(*pid);
+
+            if (group != m_groups.end()) update_weight(group->first, group->second);
+        }
+    }
+
+    m_dirty.clear();
+    m_all_dirty = false;
+}
+
+/**
+ * Converts the groups to a textual representation, which is written to the
+ * output stream.
+ */
+void CpuWeighting::dump(std::ostream &output) {
+    if (m_root.empty()) return;
+
+    output << "CPU Weighting\n";
+    output << "  Root: " << m_root << "\n";
+
+    for (std::map<unsigned long, Group>::iterator group = m_groups.begin();
+         group != m_groups.end();
+         group++) {
+        output << "  Process " << std::dec << group->first << ": ";
+
+        if (group->second.usable) output << "weight " << group->second.weight;
+        else output << "not in a group";
+
+        output << " clients " << group->second.clients.size() << "\n";
+    }
+}
+
+/**
+ * Starts tracking a new client, moving its process into a group if this is
+ * the first client of that process.
+ */
+void CpuWeighting::add_client(Window client) {
+    unsigned long pid = m_xmodel.find_pid(client);
+
+    if (!is_other_process(pid)) return;
+
+    m_client_pids[client] = pid;
+
+    std::map<unsigned long, Group>::iterator existing = m_groups.find(pid);
+
+    if (existing != m_groups.end()) {
+        existing->second.clients.insert(client);
+        return;
+    }
+
+    Group &group = m_groups[pid];
+    group.clients.insert(client);
+
+    if (!cgroup_join(m_root, pid)) {
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
+            "Could not move process " << pid << " into '" <<
+            cgroup_app_path(m_root, pid) << "': " <<
+            std::strerror(errno) << Log::endl;
+        return;
+    }
+
+    group.usable = true;
+}
+
+/**
+ * Stops tracking a client. Once a process has no clients left, its group is
+ * removed if the process has exited (otherwise, the group is left alone, since
+ * the process can't be moved back out of it, and is given the default weight
+ * until the process shows another client).
+ */
+void CpuWeighting::remove_client(Window client) {
+    std::map<Window, unsigned long>::iterator client_pid = m_client_pids.find(client);
+
+    if (client_pid == m_client_pids.end()) return;
+
+    unsigned long pid = client_pid->second;
+    m_client_pids.erase(client_pid);
+
+    Group &group = m_groups[pid];
+    group.clients.erase(client);
+
+    if (!group.clients.empty()) {
+        m_dirty.insert(pid);
+        return;
+    }
+
+    // A process which is still running can't leave its group, so the group
+    // stays behind - it mustn't keep the weight of the client which is gone
+    if (group.usable && rmdir(cgroup_app_path(m_root, pid).c_str()) != 0 &&
+        group.weight != VISIBLE_WEIGHT)
+        write_weight(pid, VISIBLE_WEIGHT);
+
+    m_groups.erase(pid);
+    m_dirty.erase(pid);
+}
+
+/**
+ * Marks the process of a client, if it has one, as needing a new weight.
+ */
+void CpuWeighting::mark_dirty(Window client) {
+    std::map<Window, unsigned long>::iterator client_pid = m_client_pids.find(client);
+
+    if (client_pid != m_client_pids.end()) m_dirty.insert(client_pid->second);
+}
+
+/**
+ * Works out the weight of a process from the states of its clients, and
+ * writes it out if it changed.
+ */
+void CpuWeighting::update_weight(unsigned long pid, Group &group) {
+    if (!group.usable) return;
+
+    Window focused = m_clients.get_focused();
+    unsigned long weight = HIDDEN_WEIGHT;
+
+    for (std::set<Window>::iterator client = group.clients.begin();
+         client != group.clients.end();
+         client++) {
+        if (*client == focused) {
+            weight = FOCUSED_WEIGHT;
+            break;
+        } else if (m_clients.is_visible(*client)) weight = VISIBLE_WEIGHT;
+    }
+
+    if (weight == group.weight) return;
+
+    if (write_weight(pid, weight)) group.weight = weight;
+}
+
+/**
+ * Writes the weight of a process's group.
+ * @return true if the weight was written, false otherwise (which is logged).
+ */
+bool CpuWeighting::write_weight(unsigned long pid, unsigned long weight) {
+    std::ostringstream weight_text;
+    weight_text << weight;
+
+    if (!cgroup_write(cgroup_app_path(m_root, pid) + "/cpu.weight", weight_text.str())) {
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
+            "Could not set the weight of process " << pid << ": " <<
+            std::strerror(errno) << Log::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,105 @@
+/** @file */
+#ifndef __SMALLWM_CPU_WEIGHTING__
+#define __SMALLWM_CPU_WEIGHTING__
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+
+#include "model/changes.hpp"
+#include "model/client-model.hpp"
+#include "model/x-model.hpp"
+#include "logging/logging.hpp"
+
+/**
+ * Gives the processes behind clients a share of the CPU which depends upon
+ * how the user is using them, through cgroup v2.
+ *
+ * Each process which owns a client (found by the client's _NET_WM_PID) is
+ * moved into its own group under a cgroup which the user has delegated to
+ * SmallWM, and anything it starts afterwards goes into that group along with
+ * it. The cpu.weight of the group is raised while one of its clients is
+ * focused, and lowered while all of its clients are hidden (iconified, or on
+ * another desktop), so that whatever the user is working with keeps up when
+ * the machine is busy.
+ *
+ * Weights are only recomputed for the processes touched by a batch of
+ * changes, and are only written when they actually change.
+ */
+class CpuWeighting : public ChangeObserver
+{
+public:
+CpuWeighting(Log &logger, ClientModel &clients, XModel &xmodel) :
+    m_logger(logger), m_clients(clients), m_xmodel(xmodel),
+    m_all_dirty(false) {
+};
+
+bool enable(const std::string&);
+
+void observe(const Change&);
+void end_batch();
+
+void dump(std::ostream&);
+
+private:
+/// The weight of a process with a focused client
+static const unsigned long FOCUSED_WEIGHT = 400;
+
+/// The weight of a process with a visible client (this is cgroup's default)
+static const unsigned long VISIBLE_WEIGHT = 100;
+
+/// The weight of a process whose clients are all hidden
+static const unsigned long HIDDEN_WEIGHT = 25;
+
+/**
+ * The group of a process, and the clients which it owns.
+ */
+struct Group {
+    Group() :
+        usable(false), weight(0) {
+    };
+
+    /// Whether or not the process could be moved into the group
+    bool usable;
+
+    /** The weight last written to the group, or 0 if none has been (the
+     * group may be left over from an earlier client of the process) */
+    unsigned long weight;
+
+    /// The clients which the process owns
+    std::set<Window> clients;
+};
+
+void add_client(Window);
+void remove_client(Window);
+void mark_dirty(Window);
+void update_weight(unsigned long, Group&);
+bool write_weight(unsigned long, unsigned long);
+
+/// The log, for reporting groups which can't be set up
+Log &m_logger;
+
+/// The clients, for finding out which are focused and visible
+ClientModel &m_clients;
+
+/// Where the process of each client is recorded
+XModel &m_xmodel;
+
+/// The cgroup that each process's group is created under
+std::string m_root;
+
+/// The group of each process, indexed by process ID
+std::map<unsigned long, Group> m_groups;
+
+/// The process of each client which has one
+std::map<Window, unsigned long> m_client_pids;
+
+/// The processes whose weights have to be recomputed at the end of the batch
+std::set<unsigned long> m_dirty;
+
+/// Whether every process's weight has to be recomputed
+bool m_all_dirty;
+};
+
+#endif // ifndef __SMALLWM_CPU_WEIGHTING__
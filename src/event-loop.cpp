@@ -0,0 +1,135 @@
+/** @file */
+#include <cerrno>
+
+#include "event-loop.hpp"
+#include "metrics.hpp"
+
+/**
+ * Registers a file descriptor to be waited on.
+ * @param fd The file descriptor.
+ * @param events The poll() flags to wait for (usually POLLIN).
+ * @param handler What to notify when the file descriptor is ready.
+ * @param name What the file descriptor's wakeups are counted under.
+ */
+void EventLoop::add_source(int fd, short events, LoopHandler *handler,
+                           const char *name) {
+    m_sources[fd] = Source(events, handler, &m_source_wakeups[name]);
+}
+
+/**
+ * Changes what a file descriptor is being waited on for - this is mostly
+ * useful for adding and removing POLLOUT as output is queued and drained.
+ * @param fd The file descriptor, which must already be registered.
+ * @param events The new poll() flags.
+ */
+void EventLoop::set_events(int fd, short events) {
+    std::map<int, Source>::iterator source = m_sources.find(fd);
+
+    if (source != m_sources.end()) source->second.events = events;
+}
+
+/**
+ * Stops waiting on a file descriptor. This is safe to call from within a
+ * handler.
+ * @param fd The file descriptor.
+ */
+void EventLoop::remove_source(int fd) {
+    m_sources.erase(fd);
+}
+
+/**
+ * Waits until either the X connection or some other source is ready, and
+ * runs the handlers of any other sources which are ready.
+ *
+ * Note that the caller is responsible for making sure that Xlib has nothing
+ * buffered (via XPending) before calling this, since poll() only knows about
+ * what hasn't been read from the connection yet.
+ *
+ * @param timeout The maximum time to wait in milliseconds, or -1 to wait
+ *                indefinitely.
+ * @return true if the X connection has data ready, false otherwise.
+ */
+bool EventLoop::wait(int timeout) {
+    m_pollfds.clear();
+
+    struct pollfd x_pollfd = { m_x_fd, POLLIN, 0 };
+    m_pollfds.push_back(x_pollfd);
+
+    for (std::map<int, Source>::iterator source = m_sources.begin();
+         source != m_sources.end();
+         source++) {
+        struct pollfd source_pollfd = { source->first, source->second.events, 0 };
+        m_pollfds.push_back(source_pollfd);
+    }
+
+    // This will also return early with EINTR when a signal arrives, which
+    // is what lets the SIGUSR1 dump happen without waiting for an X event
+    int ready_count = poll(&m_pollfds[0], m_pollfds.size(), timeout);
+
+    if (ready_count < 0 && errno == EINTR) {
+        m_wakeups++;
+        m_signal_wakeups++;
+    }
+
+    if (ready_count <= 0) return false;
+
+    m_wakeups++;
+
+    if (m_pollfds[0].revents != 0) m_x_wakeups++;
+
+    for (std::vector<struct pollfd>::iterator ready = m_pollfds.begin() + 1;
+         ready != m_pollfds.end();
+         ready++) {
+        if (ready->revents == 0) continue;
+
+        // An earlier handler may have removed this source, so don't use
+        // whatever was registered when the poll started
+        std::map<int, Source>::iterator source = m_sources.find(ready->fd);
+
+        if (source == m_sources.end()) continue;
+
+        (*source->second.wakeups)++;
+        source->second.handler->on_ready(ready->fd, ready->revents);
+    }
+
+    return (m_pollfds[0].revents & POLLIN) != 0;
+}
+
+/**
+ * Converts the wakeup counters to a textual representation, which is written
+ * to the output stream.
+ */
+void EventLoop::dump(std::ostream &output) {
+    output << "Wakeups\n";
+    output << "  Total: " << std::dec << m_wakeups << "\n";
+    output << "  X: " << m_x_wakeups << "\n";
+    output << "  Signal: " << m_signal_wakeups << "\n";
+
+    for (std::map<std::string, unsigned long long>::iterator source = m_source_wakeups.begin();
+         source != m_source_wakeups.end();
+         source++) {
+        output << "  Source " << source->first << ": " << source->second << "\n";
+    }
+}
+
+/**
+ * Writes out how often the loop has woken up, and what woke it up. A single
+ * wakeup can be counted against more than one source.
+ */
+void EventLoop::metrics(MetricsWriter &output) {
+    output.family("smallwm_loop_wakeups_total", "counter",
+                  "Times the event loop has woken up.");
+    output.sample("smallwm_loop_wakeups_total", m_wakeups);
+
+    output.family("smallwm_loop_wakeup_sources_total", "counter",
+                  "Times each source was ready when the event loop woke up.");
+    output.sample("smallwm_loop_wakeup_sources_total", "source", "x", m_x_wakeups);
+    output.sample("smallwm_loop_wakeup_sources_total", "source", "signal", m_signal_wakeups);
+
+    for (std::map<std::string, unsigned long long>::iterator source = m_source_wakeups.begin();
+         source != m_source_wakeups.end();
+         source++) {
+        output.sample("smallwm_loop_wakeup_sources_total", "source",
+                      source->first, source->second);
+    }
+}
@@ -0,0 +1,103 @@
+/** @file */
+#ifndef __SMALLWM_EVENT_LOOP__
+#define __SMALLWM_EVENT_LOOP__
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+class MetricsWriter;
+
+/**
+ * Something which wants to be woken up by the EventLoop when one of its file
+ * descriptors becomes ready.
+ */
+class LoopHandler
+{
+public:
+virtual ~LoopHandler() {
+};
+
+/**
+ * Called on the event loop's thread when the file descriptor is ready.
+ * @param fd The file descriptor which is ready.
+ * @param revents The poll() flags describing how it is ready.
+ */
+virtual void on_ready(int fd, short revents) = 0;
+};
+
+/**
+ * Waits on the X connection along with any other file descriptors that
+ * subsystems have registered, so that work which happens off of the X
+ * connection can wake up the window manager.
+ *
+ * Every wakeup is counted and attributed to whatever caused it, so that it's
+ * possible to check that an idle window manager stays asleep - nothing should
+ * be registered unless it has work pending.
+ */
+class EventLoop
+{
+public:
+EventLoop(int x_fd) :
+    m_x_fd(x_fd), m_wakeups(0), m_x_wakeups(0), m_signal_wakeups(0) {
+};
+
+void add_source(int, short, LoopHandler *, const char *);
+void set_events(int, short);
+void remove_source(int);
+
+bool wait(int);
+
+void dump(std::ostream&);
+void metrics(MetricsWriter&);
+
+private:
+/**
+ * A file descriptor which is being waited on, along with who is interested
+ * in it.
+ */
+struct Source {
+    Source() : events(0), handler(0), wakeups(0) {
+    };
+
+    Source(short _events, LoopHandler *_handler, unsigned long long *_wakeups) :
+        events(_events), handler(_handler), wakeups(_wakeups) {
+    };
+
+    /// The poll() flags the handler is interested in
+    short events;
+
+    /// What to call when the file descriptor is ready
+    LoopHandler *handler;
+
+    /// The wakeup counter of the source's name, in m_source_wakeups
+    unsigned long long *wakeups;
+};
+
+/// The file descriptor of the X connection
+int m_x_fd;
+
+/// All the other file descriptors, and their handlers
+std::map<int, Source> m_sources;
+
+/// The poll() array - this is kept around to avoid reallocating it
+std::vector<struct pollfd> m_pollfds;
+
+/// How many times poll() has returned
+unsigned long long m_wakeups;
+
+/// How many times the X connection was ready when poll() returned
+unsigned long long m_x_wakeups;
+
+/// How many times poll() was interrupted by a signal
+unsigned long long m_signal_wakeups;
+
+/** How many times each kind of source was ready when poll() returned, keyed
+ * by the name it was registered under */
+std::map<std::string, unsigned long long> m_source_wakeups;
+};
+
+#endif // ifndef __SMALLWM_EVENT_LOOP__
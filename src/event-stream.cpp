@@ -0,0 +1,425 @@
+/** @file */
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "event-stream.hpp"
+
+/// How many events can be queued for a subscriber before the oldest are lost
+static const size_t MAX_QUEUED_EVENTS = 256;
+
+/**
+ * Gets the name of a desktop, as it is written in events.
+ */
+static std::string desktop_name(const Desktop *desktop) {
+    if (!desktop) return "none";
+
+    if (desktop->is_user_desktop()) {
+        std::ostringstream name;
+        name << dynamic_cast<const UserDesktop*>(desktop)->desktop;
+        return name.str();
+    }
+
+    if (desktop->is_all_desktop()) return "all";
+    if (desktop->is_icon_desktop()) return "icon";
+    if (desktop->is_moving_desktop()) return "moving";
+    if (desktop->is_resizing_desktop()) return "resizing";
+    if (desktop->is_warm_desktop()) return "warm";
+
+    return "unknown";
+}
+
+/**
+ * Gets the name of a position/scale mode, as it is written in events.
+ */
+static const char *mode_name(ClientPosScale mode) {
+    switch (mode) {
+    case CPS_FLOATING: return "floating";
+    case CPS_SPLIT_LEFT: return "split-left";
+    case CPS_SPLIT_RIGHT: return "split-right";
+    case CPS_SPLIT_TOP: return "split-top";
+    case CPS_SPLIT_BOTTOM: return "split-bottom";
+    case CPS_MAX: return "max";
+    }
+
+    return "unknown";
+}
+
+/**
+ * Closes every subscriber, and removes the socket.
+ */
+EventStream::~EventStream() {
+    for (std::map<int, Subscriber>::iterator subscriber = m_subscribers.begin();
+         subscriber != m_subscribers.end();
+         subscriber++) {
+        m_loop.remove_source(subscriber->first);
+        close(subscriber->first);
+    }
+
+    if (m_listener != -1) {
+        m_loop.remove_source(m_listener);
+        close(m_listener);
+        unlink(m_path.c_str());
+    }
+}
+
+/**
+ * Checks whether something is still accepting connections on a Unix socket.
+ */
+static bool socket_in_use(const struct sockaddr_un &address) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (probe == -1) return false;
+
+    bool in_use = connect(probe, reinterpret_cast<const struct sockaddr*>(&address),
+                          sizeof(address)) == 0;
+    close(probe);
+    return in_use;
+}
+
+/**
+ * Starts accepting subscribers on a Unix socket.
+ * @param path Where to create the socket - a stale socket (one which nothing
+ *        is listening on) is replaced, but nothing else is.
+ * @return true if the socket is listening, false otherwise.
+ */
+bool EventStream::listen(const std::string &path) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path)) {
+        m_logger.log(LOG_ERR) <<
+            "Event socket path '" << path << "' is too long" << Log::endl;
+        return false;
+    }
+
+    std::strcpy(address.sun_path, path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (listener == -1) {
+        m_logger.log(LOG_ERR) <<
+            "Could not create event socket: " << std::strerror(errno) << Log::endl;
+        return false;
+    }
+
+    struct stat existing;
+
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode) || socket_in_use(address)) {
+            m_logger.log(LOG_ERR) <<
+                "Event socket path '" << path << "' is already in use" << Log::endl;
+
+            close(listener);
+            return false;
+        }
+
+        unlink(path.c_str());
+    }
+
+    // The socket has to be private from the moment it exists, or another user
+    // could connect before its permissions were narrowed
+    mode_t old_umask = umask(S_IRWXG | S_IRWXO);
+    int bound = bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+    umask(old_umask);
+
+    if (bound == -1 || ::listen(listener, 8) == -1) {
+        m_logger.log(LOG_ERR) <<
+            "Could not listen on event socket '" << path << "': " <<
+            std::strerror(errno) << Log::endl;
+
+        close(listener);
+        return false;
+    }
+
+    m_path = path;
+    m_listener = listener;
+    m_loop.add_source(m_listener, POLLIN, this, "event-stream");
+    return true;
+}
+
+/**
+ * Accepts new subscribers, or writes to (or drops) an existing subscriber.
+ */
+void EventStream::on_ready(int fd, short revents) {
+    if (fd == m_listener) {
+        accept_subscribers();
+        return;
+    }
+
+    if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        drop(fd);
+        return;
+    }
+
+    if (revents & POLLIN) {
+        // Subscribers don't have anything to say, so anything they send is
+        // thrown away - the only thing that matters is when they hang up
+        char buffer[256];
+        ssize_t amount;
+
+        while ((amount = recv(fd, buffer, sizeof(buffer), 0)) > 0);
+
+        if (amount == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            drop(fd);
+            return;
+        }
+    }
+
+    if (revents & POLLOUT) {
+        std::map<int, Subscriber>::iterator subscriber = m_subscribers.find(fd);
+
+        if (subscriber != m_subscribers.end()) flush(fd, subscriber->second);
+    }
+}
+
+/**
+ * Accepts every subscriber which is waiting to connect.
+ */
+void EventStream::accept_subscribers() {
+    int fd;
+
+    while ((fd = accept4(m_listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        m_subscribers[fd] = Subscriber();
+        m_loop.add_source(fd, POLLIN, this, "event-stream");
+
+        m_logger.log(LOG_INFO) <<
+            "Event subscriber " << fd << " connected" << Log::endl;
+    }
+}
+
+/**
+ * Disconnects a subscriber.
+ */
+void EventStream::drop(int fd) {
+    m_loop.remove_source(fd);
+    close(fd);
+    m_subscribers.erase(fd);
+
+    m_logger.log(LOG_INFO) <<
+        "Event subscriber " << fd << " disconnected" << Log::endl;
+}
+
+/**
+ * Writes as many of a subscriber's events as it will take without blocking.
+ */
+void EventStream::flush(int fd, Subscriber &subscriber) {
+    while (true) {
+        if (!subscriber.writing) {
+            if (subscriber.queue.empty()) break;
+
+            subscriber.writing = subscriber.pop();
+            subscriber.written = 0;
+        }
+
+        const std::string &line = *subscriber.writing;
+        ssize_t written = send(fd, line.data() + subscriber.written,
+                               line.size() - subscriber.written, MSG_NOSIGNAL);
+
+        if (written == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+            drop(fd);
+            return;
+        }
+
+        subscriber.written += written;
+        if (subscriber.written == line.size()) subscriber.writing.reset();
+    }
+
+    bool pending = subscriber.writing || !subscriber.queue.empty();
+    m_loop.set_events(fd, POLLIN | (pending ? POLLOUT : 0));
+}
+
+/**
+ * Queues an event, replacing the queued event with the same key if there is
+ * one. If the queue is full, the oldest event is thrown away to make room.
+ */
+void EventStream::Subscriber::enqueue(const Event &event) {
+    std::map<std::string, unsigned long long>::iterator queued =
+        queued_keys.find(event.key);
+
+    if (queued != queued_keys.end()) {
+        queue[queued->second - front_seq] = event.line;
+        coalesced++;
+        return;
+    }
+
+    if (queue.size() >= MAX_QUEUED_EVENTS) {
+        pop();
+        dropped++;
+    }
+
+    queued_keys[event.key] = front_seq + queue.size();
+    queue.push_back(event.line);
+    keys.push_back(event.key);
+}
+
+/**
+ * Removes the oldest queued event.
+ */
+EventStream::Line EventStream::Subscriber::pop() {
+    Line line = queue.front();
+
+    queued_keys.erase(keys.front());
+    queue.pop_front();
+    keys.pop_front();
+    front_seq++;
+
+    return line;
+}
+
+/**
+ * Adds an event to the current batch, replacing an earlier event in the
+ * batch with the same key.
+ */
+void EventStream::add_event(const std::string &key, const std::string &text) {
+    Line line = std::make_shared<const std::string>(text + "\n");
+
+    std::map<std::string, size_t>::iterator existing = m_batch_keys.find(key);
+
+    if (existing != m_batch_keys.end()) {
+        m_batch[existing->second].line = line;
+    } else {
+        m_batch_keys[key] = m_batch.size();
+        m_batch.push_back(Event(key, line));
+    }
+}
+
+/**
+ * Converts a change into an event for the current batch.
+ */
+void EventStream::observe(const Change &change) {
+    if (m_subscribers.empty()) return;
+
+    std::ostringstream key, text;
+    key << std::hex;
+    text << std::hex;
+
+    if (change.is_focus_change()) {
+        const ChangeFocus &focus = dynamic_cast<const ChangeFocus&>(change);
+
+        key << "focus";
+        text << "focus ";
+
+        if (focus.next_focus == None) text << "none";
+        else text << focus.next_focus;
+    } else if (change.is_current_desktop_change()) {
+        const ChangeCurrentDesktop &desktop =
+            dynamic_cast<const ChangeCurrentDesktop&>(change);
+
+        key << "desktop";
+        text << "desktop " << desktop_name(desktop.next_desktop);
+    } else if (change.is_client_desktop_change()) {
+        const ChangeClientDesktop &desktop =
+            dynamic_cast<const ChangeClientDesktop&>(change);
+
+        key << "client-desktop " << desktop.window;
+        text << "client-desktop " << desktop.window << " " <<
+            desktop_name(desktop.next_desktop);
+    } else if (change.is_layer_change()) {
+        const ChangeLayer &layer = dynamic_cast<const ChangeLayer&>(change);
+
+        key << "layer " << layer.window;
+        text << "layer " << layer.window << " " <<
+            std::dec << static_cast<int>(layer.layer);
+    } else if (change.is_screen_change()) {
+        const ChangeScreen &screen = dynamic_cast<const ChangeScreen&>(change);
+
+        key << "screen " << screen.window;
+        text << "screen " << screen.window << std::dec << " " <<
+            screen.bounds.x << " " << screen.bounds.y << " " <<
+            screen.bounds.width << " " << screen.bounds.height;
+    } else if (change.is_mode_change()) {
+        const ChangeCPSMode &mode = dynamic_cast<const ChangeCPSMode&>(change);
+
+        key << "mode " << mode.window;
+        text << "mode " << mode.window << " " << mode_name(mode.mode);
+    } else if (change.is_location_change()) {
+        const ChangeLocation &location = dynamic_cast<const ChangeLocation&>(change);
+
+        key << "location " << location.window;
+        text << "location " << location.window << std::dec << " " <<
+            location.x << " " << location.y;
+    } else if (change.is_size_change()) {
+        const ChangeSize &size = dynamic_cast<const ChangeSize&>(change);
+
+        key << "size " << size.window;
+        text << "size " << size.window << std::dec << " " <<
+            size.w << " " << size.h;
+    } else if (change.is_destroy_change()) {
+        const DestroyChange &destroy = dynamic_cast<const DestroyChange&>(change);
+
+        key << "destroy " << destroy.window;
+        text << "destroy " << destroy.window;
+    } else if (change.is_unmap_change()) {
+        const UnmapChange &unmap = dynamic_cast<const UnmapChange&>(change);
+
+        key << "unmap " << unmap.window;
+        text << "unmap " << unmap.window;
+    } else {
+        return;
+    }
+
+    add_event(key.str(), text.str());
+}
+
+/**
+ * Hands the current batch to every subscriber, and writes out whatever each
+ * of them will take right now.
+ */
+void EventStream::end_batch() {
+    if (m_batch.empty()) return;
+
+    // Collect these first, since flushing can drop subscribers
+    std::vector<int> fds;
+
+    for (std::map<int, Subscriber>::iterator subscriber = m_subscribers.begin();
+         subscriber != m_subscribers.end();
+         subscriber++) {
+        for (std::vector<Event>::iterator event = m_batch.begin();
+             event != m_batch.end();
+             event++) {
+            subscriber->second.enqueue(*event);
+        }
+
+        fds.push_back(subscriber->first);
+    }
+
+    m_batch.clear();
+    m_batch_keys.clear();
+
+    for (std::vector<int>::iterator fd = fds.begin(); fd != fds.end(); fd++) {
+        std::map<int, Subscriber>::iterator subscriber = m_subscribers.find(*fd);
+
+        if (subscriber != m_subscribers.end()) flush(*fd, subscriber->second);
+    }
+}
+
+/**
+ * Converts the state of the subscribers to a textual representation, which
+ * is written to an output stream.
+ */
+void EventStream::dump(std::ostream &output) {
+    if (m_listener == -1) return;
+
+    output << "Event stream\n";
+    output << "  Socket: " << m_path << "\n";
+    output << "  Subscribers: " << std::dec << m_subscribers.size() << "\n";
+
+    for (std::map<int, Subscriber>::iterator subscriber = m_subscribers.begin();
+         subscriber != m_subscribers.end();
+         subscriber++) {
+        output << "  Subscriber: " << subscriber->first << "\n";
+        output << "    Queued: " << subscriber->second.queue.size() << "\n";
+        output << "    Coalesced: " << subscriber->second.coalesced << "\n";
+        output << "    Dropped: " << subscriber->second.dropped << "\n";
+    }
+}
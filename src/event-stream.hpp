@@ -0,0 +1,128 @@
+/** @file */
+#ifndef __SMALLWM_EVENT_STREAM__
+#define __SMALLWM_EVENT_STREAM__
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "model/changes.hpp"
+#include "logging/logging.hpp"
+#include "event-loop.hpp"
+
+/**
+ * Sends a stream of model events to subscribers on a local Unix socket.
+ *
+ * Each event is a single line of text, which is built once per batch and
+ * shared by every subscriber. Every event also has a key naming the state it
+ * describes (the focus, the current desktop, a window's location, etc.) - when
+ * a subscriber falls behind, a newer event replaces any queued event with the
+ * same key, so that a slow subscriber sees the latest state rather than every
+ * step along the way. Each subscriber's queue is bounded as well, so a stuck
+ * subscriber can never hold up the window manager.
+ */
+class EventStream : public LoopHandler, public ChangeObserver
+{
+public:
+EventStream(Log &logger, EventLoop &loop) :
+    m_logger(logger), m_loop(loop), m_listener(-1) {
+};
+
+~EventStream();
+
+bool listen(const std::string&);
+
+void on_ready(int, short);
+
+void observe(const Change&);
+void end_batch();
+
+void dump(std::ostream&);
+
+private:
+/// A serialized event, which is shared between every subscriber
+typedef std::shared_ptr<const std::string> Line;
+
+/**
+ * An event from the current batch, along with the state it describes.
+ */
+struct Event {
+    Event(const std::string &_key, const Line &_line) :
+        key(_key), line(_line) {
+    };
+
+    /// The state the event describes - newer events replace older ones
+    std::string key;
+
+    /// The text sent to subscribers
+    Line line;
+};
+
+/**
+ * A connected subscriber, and the events it hasn't read yet.
+ */
+struct Subscriber {
+    Subscriber() :
+        front_seq(0), written(0), coalesced(0), dropped(0) {
+    };
+
+    void enqueue(const Event&);
+    Line pop();
+
+    /// Events which haven't been written yet, oldest first
+    std::deque<Line> queue;
+
+    /// The sequence number of the first event in the queue
+    unsigned long long front_seq;
+
+    /// The sequence number of the queued event for each key
+    std::map<std::string, unsigned long long> queued_keys;
+
+    /// The keys of each queued event, in the same order as the queue
+    std::deque<std::string> keys;
+
+    /// An event which has only been partly written, if there is one
+    Line writing;
+
+    /// How much of the partly written event has been written
+    size_t written;
+
+    /// How many events were replaced by newer ones
+    unsigned long coalesced;
+
+    /// How many events were thrown away because the queue was full
+    unsigned long dropped;
+};
+
+void accept_subscribers();
+void flush(int, Subscriber&);
+void drop(int);
+
+void add_event(const std::string&, const std::string&);
+
+/// Where to report subscribers coming and going
+Log &m_logger;
+
+/// The loop which wakes us up when a socket is ready
+EventLoop &m_loop;
+
+/// The path of the listening socket
+std::string m_path;
+
+/// The listening socket, or -1 if there isn't one
+int m_listener;
+
+/// The connected subscribers, keyed by their sockets
+std::map<int, Subscriber> m_subscribers;
+
+/// The events from the current batch, with repeated keys already coalesced
+std::vector<Event> m_batch;
+
+/// Where each key in the current batch is in m_batch
+std::map<std::string, size_t> m_batch_keys;
+};
+
+#endif // ifndef __SMALLWM_EVENT_STREAM__
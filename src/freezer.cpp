@@ -0,0 +1,310 @@
+/** @file */
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include "cgroup.hpp"
+#include "freezer.hpp"
+#include "utils.hpp"
+
+/**
+ * Thaws every frozen process, so that nothing is left frozen once SmallWM
+ * is no longer around to thaw it.
+ */
+Freezer::~Freezer() {
+    for (std::map<unsigned long, Process>::iterator process = m_processes.begin();
+         process != m_processes.end();
+         process++) {
+        if (process->second.frozen) thaw(process->first, process->second);
+    }
+}
+
+/**
+ * Freezes processes with the cgroup v2 freezer, rather than with SIGSTOP.
+ * Processes which can't be moved into their groups are still stopped with
+ * SIGSTOP.
+ *
+ * @param root The cgroup (delegated to the user) to create the groups under.
+ */
+void Freezer::use_cgroup(const std::string &root) {
+    m_root = root;
+}
+
+/**
+ * Thaws any process which the change is about to show a client of.
+ */
+void Freezer::prepare(const Change &change) {
+    if (change.is_client_desktop_change()) {
+        const ChangeClientDesktop &desktop =
+            dynamic_cast<const ChangeClientDesktop&>(change);
+
+        if (desktop.next_desktop && m_clients.is_visible_desktop(desktop.next_desktop))
+            thaw_client(desktop.window);
+    } else if (change.is_current_desktop_change()) {
+        const ChangeCurrentDesktop &desktop =
+            dynamic_cast<const ChangeCurrentDesktop&>(change);
+
+        for (std::map<Window, unsigned long>::iterator client = m_client_pids.begin();
+             client != m_client_pids.end();
+             client++) {
+            if (m_clients.find_desktop(client->first) == desktop.next_desktop)
+                thaw_client(client->first);
+        }
+    } else if (change.is_focus_change()) {
+        const ChangeFocus &focus = dynamic_cast<const ChangeFocus&>(change);
+        thaw_client(focus.next_focus);
+    }
+}
+
+/**
+ * Notes which processes may have been hidden or shown by a change, so that
+ * they can be checked at the end of the batch.
+ */
+void Freezer::observe(const Change &change) {
+    if (change.is_client_desktop_change()) {
+        const ChangeClientDesktop &desktop =
+            dynamic_cast<const ChangeClientDesktop&>(change);
+
+        // New clients don't have a previous desktop
+        if (!desktop.prev_desktop) add_client(desktop.window);
+
+        mark_dirty(desktop.window);
+    } else if (change.is_current_desktop_change()) {
+        m_all_dirty = true;
+    } else if (change.is_destroy_change()) {
+        const DestroyChange &destroy = dynamic_cast<const DestroyChange&>(change);
+        remove_client(destroy.window);
+    }
+}
+
+/**
+ * Starts the delay for every process whose clients have all become hidden,
+ * and stops it for those which have a visible client again.
+ */
+void Freezer::end_batch() {
+    if (!m_all_dirty && m_dirty.empty()) return;
+
+    unsigned long long now = monotonic_usec();
+
+    for (std::map<unsigned long, Process>::iterator process = m_processes.begin();
+         process != m_processes.end();
+         process++) {
+        if (!m_all_dirty && m_dirty.count(process->first) == 0) continue;
+
+        if (!is_hidden(process->second)) {
+            // This shouldn't happen, since processes are thawed before their
+            // clients are shown, but nothing visible may stay frozen
+            if (process->second.frozen) thaw(process->first, process->second);
+
+            process->second.hidden_since = 0;
+        } else if (process->second.hidden_since == 0) process->second.hidden_since = now;
+    }
+
+    m_dirty.clear();
+    m_all_dirty = false;
+
+    schedule();
+}
+
+/**
+ * Freezes every process which has been hidden for long enough.
+ */
+void Freezer::timer_expired(Timer *timer) {
+    unsigned long long now = monotonic_usec();
+    unsigned long long delay_usec = m_delay * 1000ULL;
+
+    for (std::map<unsigned long, Process>::iterator process = m_processes.begin();
+         process != m_processes.end();
+         process++) {
+        Process &state = process->second;
+
+        if (!state.frozen && state.hidden_since != 0 &&
+            now - state.hidden_since >= delay_usec)
+            freeze(process->first, state);
+    }
+
+    schedule();
+}
+
+/**
+ * Converts the frozen processes to a textual representation, which is
+ * written to the output stream.
+ */
+void Freezer::dump(std::ostream &output) {
+    output << "Freezer\n";
+    output << "  Freezes: " << std::dec << m_freezes << " thaws " << m_thaws << "\n";
+
+    for (std::map<unsigned long, Process>::iterator process = m_processes.begin();
+         process != m_processes.end();
+         process++) {
+        output << "  Process " << process->first << ": ";
+
+        if (!process->second.frozen) output << "running";
+        else if (process->second.by_signal) output << "stopped";
+        else output << "frozen";
+
+        output << " clients " << process->second.clients.size() << "\n";
+    }
+}
+
+/**
+ * Starts tracking a new client, if its process may be frozen.
+ */
+void Freezer::add_client(Window client) {
+    if (!m_xmodel.is_freezable(client)) return;
+
+    unsigned long pid = m_xmodel.find_pid(client);
+
+    if (!is_other_process(pid)) return;
+
+    m_client_pids[client] = pid;
+    m_processes[pid].clients.insert(client);
+}
+
+/**
+ * Stops tracking a client. Once a process has no clients left, it is thawed
+ * (so that it can exit) and forgotten about.
+ */
+void Freezer::remove_client(Window client) {
+    std::map<Window, unsigned long>::iterator client_pid = m_client_pids.find(client);
+
+    if (client_pid == m_client_pids.end()) return;
+
+    unsigned long pid = client_pid->second;
+    m_client_pids.erase(client_pid);
+
+    Process &process = m_processes[pid];
+    process.clients.erase(client);
+
+    if (!process.clients.empty()) {
+        m_dirty.insert(pid);
+        return;
+    }
+
+    if (process.frozen) thaw(pid, process);
+
+    m_processes.erase(pid);
+    m_dirty.erase(pid);
+}
+
+/**
+ * Marks the process of a client, if it may be frozen, as needing to be
+ * checked at the end of the batch.
+ */
+void Freezer::mark_dirty(Window client) {
+    std::map<Window, unsigned long>::iterator client_pid = m_client_pids.find(client);
+
+    if (client_pid != m_client_pids.end()) m_dirty.insert(client_pid->second);
+}
+
+/**
+ * Thaws the process of a client, if it is frozen.
+ */
+void Freezer::thaw_client(Window client) {
+    std::map<Window, unsigned long>::iterator client_pid = m_client_pids.find(client);
+
+    if (client_pid == m_client_pids.end()) return;
+
+    Process &process = m_processes[client_pid->second];
+
+    if (process.frozen) thaw(client_pid->second, process);
+
+    process.hidden_since = 0;
+    m_dirty.insert(client_pid->second);
+}
+
+/**
+ * Checks whether every client of a process is hidden.
+ */
+bool Freezer::is_hidden(const Process &process) {
+    for (std::set<Window>::const_iterator client = process.clients.begin();
+         client != process.clients.end();
+         client++) {
+        if (m_clients.is_visible(*client)) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Freezes a process, through its cgroup if possible and with SIGSTOP
+ * otherwise.
+ */
+void Freezer::freeze(unsigned long pid, Process &process) {
+    // Stopping init or SmallWM itself could never be undone
+    if (!is_other_process(pid)) return;
+
+    if (!m_root.empty() && !process.in_group) process.in_group = cgroup_join(m_root, pid);
+
+    if (process.in_group &&
+        cgroup_write(cgroup_app_path(m_root, pid) + "/cgroup.freeze", "1")) {
+        process.by_signal = false;
+    } else if (kill(pid, SIGSTOP) == 0) {
+        process.by_signal = true;
+    } else {
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
+            "Could not freeze process " << pid << ": " <<
+            std::strerror(errno) << Log::endl;
+
+        // Don't keep trying until it is hidden again
+        process.hidden_since = 0;
+        return;
+    }
+
+    process.frozen = true;
+    m_freezes++;
+}
+
+/**
+ * Thaws a frozen process, in the same way it was frozen.
+ */
+void Freezer::thaw(unsigned long pid, Process &process) {
+    bool thawed;
+
+    if (process.by_signal) thawed = kill(pid, SIGCONT) == 0;
+    else thawed = cgroup_write(cgroup_app_path(m_root, pid) + "/cgroup.freeze", "0");
+
+    // Whether or not this worked, there's nothing more that can be done -
+    // usually, it fails because the process has already exited
+    if (!thawed && errno != ESRCH && errno != ENOENT)
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
+            "Could not thaw process " << pid << ": " <<
+            std::strerror(errno) << Log::endl;
+
+    process.frozen = false;
+    m_thaws++;
+}
+
+/**
+ * Arms the timer for the next hidden process which is due to be frozen, or
+ * disarms it if there is nothing to freeze.
+ */
+void Freezer::schedule() {
+    unsigned long long earliest = 0;
+
+    for (std::map<unsigned long, Process>::iterator process = m_processes.begin();
+         process != m_processes.end();
+         process++) {
+        const Process &state = process->second;
+
+        if (state.frozen || state.hidden_since == 0) continue;
+
+        if (earliest == 0 || state.hidden_since < earliest) earliest = state.hidden_since;
+    }
+
+    if (earliest == 0) {
+        m_timer.disarm();
+        return;
+    }
+
+    unsigned long long due = earliest + m_delay * 1000ULL;
+    unsigned long long now = monotonic_usec();
+
+    // The timer can't be armed for 0 milliseconds, since that disarms it
+    unsigned long wait = 1;
+
+    if (due > now) wait = std::max(1ULL, (due - now) / 1000);
+
+    m_timer.arm(wait);
+}
@@ -0,0 +1,127 @@
+/** @file */
+#ifndef __SMALLWM_FREEZER__
+#define __SMALLWM_FREEZER__
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+
+#include "model/changes.hpp"
+#include "model/client-model.hpp"
+#include "model/x-model.hpp"
+#include "logging/logging.hpp"
+#include "event-loop.hpp"
+#include "timer.hpp"
+
+/**
+ * Freezes the processes of hidden clients, so that applications which keep
+ * redrawing or polling while nobody can see them stop using the CPU.
+ *
+ * Only clients of the classes given the 'freeze' setting are frozen. Once
+ * every client of such a process has stayed hidden (iconified, or on a
+ * desktop which isn't visible) for the configured delay, the process is
+ * frozen with the cgroup v2 freezer, or with SIGSTOP if it can't be put into
+ * a cgroup.
+ *
+ * Processes are thawed while a change is being prepared (see
+ * ChangeObserver::prepare), before the change maps any of their clients, so
+ * that a frozen client is never shown. Thawing through the freezer or with
+ * SIGCONT is done by the time the write or kill() returns.
+ */
+class Freezer : public ChangeObserver, public TimerListener
+{
+public:
+Freezer(Log &logger, ClientModel &clients, XModel &xmodel, EventLoop &loop,
+        unsigned long delay) :
+    m_logger(logger), m_clients(clients), m_xmodel(xmodel),
+    m_timer(loop, this, "freezer"), m_delay(delay), m_all_dirty(false), m_freezes(0),
+    m_thaws(0) {
+};
+
+~Freezer();
+
+void use_cgroup(const std::string&);
+
+void prepare(const Change&);
+void observe(const Change&);
+void end_batch();
+
+void timer_expired(Timer *);
+
+void dump(std::ostream&);
+
+private:
+/**
+ * A process whose clients may be frozen, and what has been done to it.
+ */
+struct Process {
+    Process() :
+        frozen(false), by_signal(false), in_group(false), hidden_since(0) {
+    };
+
+    /// Whether or not the process is frozen
+    bool frozen;
+
+    /// Whether the process was frozen with SIGSTOP, rather than its cgroup
+    bool by_signal;
+
+    /// Whether or not the process has been moved into its cgroup
+    bool in_group;
+
+    /** When every client of the process became hidden (from
+     * monotonic_usec()), or 0 if any client is visible */
+    unsigned long long hidden_since;
+
+    /// The clients which the process owns
+    std::set<Window> clients;
+};
+
+void add_client(Window);
+void remove_client(Window);
+void mark_dirty(Window);
+void thaw_client(Window);
+
+bool is_hidden(const Process&);
+void freeze(unsigned long, Process&);
+void thaw(unsigned long, Process&);
+void schedule();
+
+/// The log, for reporting processes which can't be frozen
+Log &m_logger;
+
+/// The clients, for finding out which are visible
+ClientModel &m_clients;
+
+/// Where the process of each client is recorded
+XModel &m_xmodel;
+
+/// Expires when the next hidden process is due to be frozen
+Timer m_timer;
+
+/// How long, in milliseconds, a process has to stay hidden to be frozen
+unsigned long m_delay;
+
+/// The cgroup that each process's group is created under, or empty
+std::string m_root;
+
+/// The processes which may be frozen, indexed by process ID
+std::map<unsigned long, Process> m_processes;
+
+/// The process of each client which may be frozen
+std::map<Window, unsigned long> m_client_pids;
+
+/// The processes whose clients may have been hidden or shown in this batch
+std::set<unsigned long> m_dirty;
+
+/// Whether every process may have been hidden or shown in this batch
+bool m_all_dirty;
+
+/// How many times a process has been frozen
+unsigned long m_freezes;
+
+/// How many times a process has been thawed
+unsigned long m_thaws;
+};
+
+#endif // ifndef __SMALLWM_FREEZER__
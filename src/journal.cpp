@@ -0,0 +1,466 @@
+/** @file */
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "journal.hpp"
+
+ModelJournal::~ModelJournal() {
+    if (m_map) munmap(m_map, JOURNAL_SIZE);
+
+    if (m_fd != -1) close(m_fd);
+}
+
+/**
+ * Opens the journal (creating it if it doesn't exist), and reads back the
+ * state that the snapshot and the journal recorded. Nothing is done with
+ * that state until restore() is called.
+ *
+ * @param path The journal file - the snapshot goes next to it, with
+ *        .snapshot appended.
+ * @param session The session of the X server (see XData::get_server_session),
+ *        which anything that is read back has to have been written under.
+ * @return true if the journal could be opened, false otherwise.
+ */
+bool ModelJournal::open(const std::string &path, unsigned long long session) {
+    m_path = path;
+    m_session = session;
+
+    // The snapshot goes first, since it decides which journal is current
+    std::ifstream snapshot_file((path + ".snapshot").c_str(), std::ifstream::binary);
+    std::vector<char> snapshot((std::istreambuf_iterator<char>(snapshot_file)),
+                               std::istreambuf_iterator<char>());
+
+    Header header;
+
+    if (snapshot.size() >= sizeof(header)) {
+        std::memcpy(&header, &snapshot[0], sizeof(header));
+
+        if (header.magic == SNAPSHOT_MAGIC && header.record_size == sizeof(Record) &&
+            header.session == m_session) {
+            m_generation = header.generation;
+
+            std::vector<Record> records((snapshot.size() - sizeof(header)) / sizeof(Record));
+
+            if (!records.empty()) {
+                std::memcpy(&records[0], &snapshot[sizeof(header)],
+                            records.size() * sizeof(Record));
+                replay(&records[0], records.size());
+            }
+        }
+    }
+
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+    if (m_fd == -1 || ftruncate(m_fd, JOURNAL_SIZE) == -1) {
+        m_logger.log(LOG_ERR) <<
+            "Could not open the journal '" << path << "': " <<
+            std::strerror(errno) << Log::endl;
+        return false;
+    }
+
+    void *map = mmap(NULL, JOURNAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+
+    if (map == MAP_FAILED) {
+        m_logger.log(LOG_ERR) <<
+            "Could not map the journal '" << path << "': " <<
+            std::strerror(errno) << Log::endl;
+        return false;
+    }
+
+    m_map = static_cast<char *>(map);
+    std::memcpy(&header, m_map, sizeof(header));
+
+    // New records go after the last complete batch - anything after that was
+    // cut off, and is cleared so that it can't be mistaken for part of the
+    // next batch. A journal that doesn't follow on from the snapshot is
+    // started over, so that it never has to be written to without a header.
+    if (header.magic == JOURNAL_MAGIC && header.record_size == sizeof(Record) &&
+        header.session == m_session && header.generation == m_generation) {
+        size_t committed = replay(reinterpret_cast<const Record *>(m_map + sizeof(header)),
+                                  (JOURNAL_SIZE - sizeof(header)) / sizeof(Record));
+
+        m_offset = sizeof(header) + committed * sizeof(Record);
+        std::memset(m_map + m_offset, 0, JOURNAL_SIZE - m_offset);
+    } else start_over();
+
+    return true;
+}
+
+/**
+ * Puts every client that was recorded back where it was, and goes back to
+ * the desktop that was current. This has to be called after the windows
+ * that already exist have been adopted - windows which have disappeared
+ * since the journal was written aren't clients, and so are skipped.
+ *
+ * Afterwards, the journal is compacted, so that it only holds the clients
+ * which are still around.
+ */
+void ModelJournal::restore() {
+    if (!m_map) return;
+
+    std::map<Window, Record> recovered;
+    recovered.swap(m_entries);
+
+    for (std::map<Window, Record>::iterator entry = recovered.begin();
+         entry != recovered.end();
+         entry++) {
+        if (!m_clients.is_client(entry->first)) continue;
+
+        apply(entry->first, entry->second);
+        m_recovered++;
+    }
+
+    if (m_current_desktop >= 0 &&
+        m_current_desktop < static_cast<int32_t>(m_clients.USER_DESKTOPS.size()))
+        m_clients.go_to_desktop(m_current_desktop);
+    else m_current_desktop = 0;
+
+    Desktop *desktops[] = { m_clients.ALL_DESKTOPS, m_clients.ICON_DESKTOP };
+    std::vector<Desktop *> recorded(desktops, desktops + 2);
+    recorded.insert(recorded.end(), m_clients.USER_DESKTOPS.begin(),
+                    m_clients.USER_DESKTOPS.end());
+
+    for (std::vector<Desktop *>::iterator desktop = recorded.begin();
+         desktop != recorded.end();
+         desktop++) {
+        ClientModel::client_range clients = m_clients.clients_of(*desktop);
+
+        for (ClientModel::client_iter client = clients.begin();
+             client != clients.end();
+             client++) {
+            Record record;
+
+            if (capture(*client, record)) m_entries[*client] = record;
+        }
+    }
+
+    // Without a snapshot of the clients that are still around, the journal
+    // would go on from the old one, and restore clients that have since gone
+    if (!compact()) {
+        m_logger.log(LOG_ERR) <<
+            "Journalling to '" << m_path << "' has stopped" << Log::endl;
+
+        munmap(m_map, JOURNAL_SIZE);
+        m_map = NULL;
+
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+/**
+ * Notes which clients have been changed by a change, so that their new state
+ * can be recorded at the end of the batch.
+ */
+void ModelJournal::observe(const Change &change) {
+    if (change.is_client_desktop_change()) {
+        m_dirty.insert(dynamic_cast<const ChangeClientDesktop&>(change).window);
+    } else if (change.is_layer_change()) {
+        m_dirty.insert(dynamic_cast<const ChangeLayer&>(change).window);
+    } else if (change.is_mode_change()) {
+        m_dirty.insert(dynamic_cast<const ChangeCPSMode&>(change).window);
+    } else if (change.is_location_change()) {
+        m_dirty.insert(dynamic_cast<const ChangeLocation&>(change).window);
+    } else if (change.is_size_change()) {
+        m_dirty.insert(dynamic_cast<const ChangeSize&>(change).window);
+    } else if (change.is_current_desktop_change()) {
+        const ChangeCurrentDesktop &desktop =
+            dynamic_cast<const ChangeCurrentDesktop&>(change);
+
+        m_current_desktop = dynamic_cast<UserDesktop *>(desktop.next_desktop)->desktop;
+        m_desktop_dirty = true;
+    } else if (change.is_destroy_change()) {
+        Window window = dynamic_cast<const DestroyChange&>(change).window;
+
+        m_dirty.erase(window);
+        m_forgotten.insert(window);
+    }
+}
+
+/**
+ * Appends the state of every client changed by the batch to the journal,
+ * followed by a commit record. If the journal is full, it is compacted
+ * instead.
+ */
+void ModelJournal::end_batch() {
+    if (!m_map) return;
+
+    if (m_dirty.empty() && m_forgotten.empty() && !m_desktop_dirty) return;
+
+    m_batch.clear();
+
+    for (std::set<Window>::iterator window = m_forgotten.begin();
+         window != m_forgotten.end();
+         window++) {
+        if (m_entries.erase(*window) == 0) continue;
+
+        Record record = {};
+        record.type = REC_FORGET;
+        record.window = *window;
+        m_batch.push_back(record);
+    }
+
+    for (std::set<Window>::iterator window = m_dirty.begin();
+         window != m_dirty.end();
+         window++) {
+        Record record;
+
+        // Clients being moved or resized are recorded once they stop
+        if (!m_clients.is_client(*window) || !capture(*window, record)) continue;
+
+        m_entries[*window] = record;
+        m_batch.push_back(record);
+    }
+
+    if (m_desktop_dirty) {
+        Record record = {};
+        record.type = REC_CURRENT_DESKTOP;
+        record.desktop = m_current_desktop;
+        m_batch.push_back(record);
+    }
+
+    m_dirty.clear();
+    m_forgotten.clear();
+    m_desktop_dirty = false;
+
+    if (m_batch.empty()) return;
+
+    // The snapshot is written from m_entries, which already has this batch
+    if (m_offset + (m_batch.size() + 1) * sizeof(Record) > JOURNAL_SIZE) {
+        compact();
+        return;
+    }
+
+    std::memcpy(m_map + m_offset, &m_batch[0], m_batch.size() * sizeof(Record));
+    m_offset += m_batch.size() * sizeof(Record);
+
+    // The batch has to land before its commit record does, or a crash in
+    // between could leave a commit for records that were never written
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+
+    Record commit = {};
+    commit.type = REC_COMMIT;
+    std::memcpy(m_map + m_offset, &commit, sizeof(commit));
+    m_offset += sizeof(commit);
+}
+
+/**
+ * Converts the state of the journal to a textual representation, which is
+ * written to the output stream.
+ */
+void ModelJournal::dump(std::ostream &output) {
+    if (!m_map) return;
+
+    output << "Journal\n";
+    output << "  File: " << m_path << "\n";
+    output << "  Session: " << std::hex << m_session << "\n";
+    output << "  Generation: " << std::dec << m_generation << "\n";
+    output << "  Used: " << m_offset << " of " << JOURNAL_SIZE << "\n";
+    output << "  Clients: " << m_entries.size() << "\n";
+    output << "  Recovered: " << m_recovered << "\n";
+    output << "  Compactions: " << m_compactions << "\n";
+}
+
+/**
+ * Gets the state of a client, for recording.
+ * @return true if the client's state can be recorded, false if it is in the
+ *         middle of something (moving, resizing or waiting as a warm shell).
+ */
+bool ModelJournal::capture(Window window, Record &record) {
+    Desktop *desktop = m_clients.find_desktop(window);
+
+    std::memset(&record, 0, sizeof(record));
+    record.type = REC_CLIENT;
+    record.window = window;
+
+    if (desktop->is_user_desktop())
+        record.desktop = dynamic_cast<UserDesktop *>(desktop)->desktop;
+    else if (desktop->is_all_desktop()) record.desktop = STICKY_DESKTOP;
+    else if (desktop->is_icon_desktop()) record.desktop = ICON_DESKTOP;
+    else return false;
+
+    const Dimension2D &location = m_clients.get_location(window);
+    const Dimension2D &size = m_clients.get_size(window);
+
+    record.layer = m_clients.find_layer(window);
+    record.mode = m_clients.get_mode(window);
+    record.x = location.first;
+    record.y = location.second;
+    record.width = size.first;
+    record.height = size.second;
+    return true;
+}
+
+/**
+ * Puts a newly adopted client back into the state it was recorded in.
+ */
+void ModelJournal::apply(Window window, const Record &record) {
+    // This has to happen while the client is still on the current desktop,
+    // since only visible clients can be iconified or stuck
+    if (record.desktop == ICON_DESKTOP) m_clients.iconify(window);
+    else {
+        m_clients.deiconify(window);
+
+        bool stuck = m_clients.find_desktop(window)->is_all_desktop();
+
+        if ((record.desktop == STICKY_DESKTOP) != stuck) m_clients.toggle_stick(window);
+
+        if (record.desktop >= 0) m_clients.client_to_desktop(window, record.desktop);
+    }
+
+    m_clients.set_layer(window, record.layer);
+
+    // Packed clients are laid out by their corner, which their class action
+    // has already put them back into
+    if (m_clients.is_packed_client(window) || record.mode < CPS_FLOATING ||
+        record.mode > CPS_MAX) return;
+
+    ClientPosScale mode = static_cast<ClientPosScale>(record.mode);
+    m_clients.change_mode(window, mode);
+
+    if (mode == CPS_FLOATING) {
+        m_clients.change_location(window, record.x, record.y);
+        m_clients.change_size(window, record.width, record.height);
+    }
+}
+
+/**
+ * Applies the records of every complete batch to the recovered state. A
+ * batch which was cut off (by SmallWM crashing in the middle of writing it)
+ * is ignored, along with anything after the first record that doesn't make
+ * sense.
+ *
+ * @return How many records were in complete batches.
+ */
+size_t ModelJournal::replay(const Record *records, size_t count) {
+    size_t committed = 0;
+
+    for (size_t index = 0; index < count; index++) {
+        if (records[index].type == REC_COMMIT) committed = index + 1;
+        else if (records[index].type == REC_END || records[index].type > REC_COMMIT) break;
+    }
+
+    for (size_t index = 0; index < committed; index++) {
+        const Record &record = records[index];
+
+        switch (record.type) {
+        case REC_CLIENT:
+            m_entries[record.window] = record;
+            break;
+        case REC_FORGET:
+            m_entries.erase(record.window);
+            break;
+        case REC_CURRENT_DESKTOP:
+            m_current_desktop = record.desktop;
+            break;
+        }
+    }
+
+    return committed;
+}
+
+/**
+ * Writes out a new snapshot of every client, and then starts the journal
+ * over. The old journal only stops counting once the new snapshot is in
+ * place, so a crash at any point leaves a usable snapshot and journal behind.
+ *
+ * @return true if the journal was compacted, false if the snapshot couldn't
+ *         be written (and the journal is left as it was).
+ */
+bool ModelJournal::compact() {
+    m_generation++;
+
+    if (!write_snapshot()) {
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
+            "Could not write the snapshot of '" << m_path << "': " <<
+            std::strerror(errno) << Log::endl;
+
+        m_generation--;
+        return false;
+    }
+
+    start_over();
+    m_compactions++;
+    return true;
+}
+
+/**
+ * Empties the journal, and gives it a header saying that it follows on from
+ * the current snapshot.
+ */
+void ModelJournal::start_over() {
+    // The old records have to be gone before the header says that the
+    // journal follows on from the current snapshot
+    std::memset(m_map + sizeof(Header), 0, JOURNAL_SIZE - sizeof(Header));
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+
+    Header header = {};
+    header.magic = JOURNAL_MAGIC;
+    header.record_size = sizeof(Record);
+    header.generation = m_generation;
+    header.session = m_session;
+    std::memcpy(m_map, &header, sizeof(header));
+
+    m_offset = sizeof(header);
+}
+
+/**
+ * Writes the state of every client to a temporary file, and renames it over
+ * the snapshot.
+ * @return true if the snapshot was written, false otherwise.
+ */
+bool ModelJournal::write_snapshot() {
+    std::vector<Record> records;
+
+    for (std::map<Window, Record>::iterator entry = m_entries.begin();
+         entry != m_entries.end();
+         entry++) {
+        records.push_back(entry->second);
+    }
+
+    Record record = {};
+    record.type = REC_CURRENT_DESKTOP;
+    record.desktop = m_current_desktop;
+    records.push_back(record);
+
+    record.type = REC_COMMIT;
+    records.push_back(record);
+
+    Header header = {};
+    header.magic = SNAPSHOT_MAGIC;
+    header.record_size = sizeof(Record);
+    header.generation = m_generation;
+    header.session = m_session;
+
+    std::string snapshot = m_path + ".snapshot";
+    std::string temporary = snapshot + ".tmp";
+
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+    if (fd == -1) return false;
+
+    size_t records_size = records.size() * sizeof(Record);
+    bool written =
+        write(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)) &&
+        write(fd, &records[0], records_size) == static_cast<ssize_t>(records_size);
+
+    int saved_errno = errno;
+    close(fd);
+
+    if (!written) {
+        unlink(temporary.c_str());
+        errno = saved_errno;
+        return false;
+    }
+
+    return std::rename(temporary.c_str(), snapshot.c_str()) == 0;
+}
@@ -0,0 +1,191 @@
+/** @file */
+#ifndef __SMALLWM_JOURNAL__
+#define __SMALLWM_JOURNAL__
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "model/changes.hpp"
+#include "model/client-model.hpp"
+#include "logging/logging.hpp"
+
+/**
+ * Keeps a record of where every client is - its desktop, layer, mode and
+ * geometry - so that a restarted SmallWM can put the clients back where they
+ * were, rather than dumping all of them onto the current desktop.
+ *
+ * The record is kept in two files:
+ *
+ *  - The journal, which is memory-mapped and only ever appended to. At the
+ *    end of each batch of changes, the new state of every client that the
+ *    batch touched is copied into it, followed by a commit record. Nothing is
+ *    flushed to disk, since the pages belong to the kernel once they are
+ *    written and survive SmallWM crashing.
+ *  - The snapshot, which holds the state of every client at once. Whenever
+ *    the journal fills up, it is compacted by writing a new snapshot and
+ *    starting the journal over.
+ *
+ * Both files carry a generation number, so that a journal left over from
+ * before the last snapshot (if SmallWM crashed while compacting) is ignored.
+ * They also carry the session of the X server that wrote them, since window
+ * IDs are reused by every new server - a journal from another session
+ * describes windows which no longer exist, whatever their IDs.
+ */
+class ModelJournal : public ChangeObserver
+{
+public:
+ModelJournal(Log &logger, ClientModel &clients) :
+    m_logger(logger), m_clients(clients), m_fd(-1), m_map(0),
+    m_offset(0), m_generation(0), m_session(0), m_current_desktop(NO_DESKTOP),
+    m_desktop_dirty(false), m_recovered(0), m_compactions(0) {
+};
+
+~ModelJournal();
+
+bool open(const std::string&, unsigned long long);
+void restore();
+
+void observe(const Change&);
+void end_batch();
+
+void dump(std::ostream&);
+
+private:
+/// The size of the journal file, in bytes
+static const size_t JOURNAL_SIZE = 256 * 1024;
+
+/// Identifies a journal file
+static const uint32_t JOURNAL_MAGIC = 0x4a4d5753;
+
+/// Identifies a snapshot file
+static const uint32_t SNAPSHOT_MAGIC = 0x534d5753;
+
+/// The desktop of an iconified client
+static const int32_t ICON_DESKTOP = -1;
+
+/// The desktop of a client which is stuck to every desktop
+static const int32_t STICKY_DESKTOP = -2;
+
+/// The current desktop, before one has been recorded
+static const int32_t NO_DESKTOP = -3;
+
+/**
+ * What each record in the journal and the snapshot holds. A zeroed record
+ * marks the end of the journal.
+ */
+enum RecordType {
+    REC_END = 0,
+    REC_CLIENT,
+    REC_FORGET,
+    REC_CURRENT_DESKTOP,
+    REC_COMMIT,
+};
+
+/**
+ * The first thing in each file.
+ */
+struct Header {
+    /// Either JOURNAL_MAGIC or SNAPSHOT_MAGIC
+    uint32_t magic;
+
+    /// The size of a Record, in case the format ever changes
+    uint32_t record_size;
+
+    /// Which snapshot the journal follows on from
+    uint64_t generation;
+
+    /// The X server session which wrote the file
+    uint64_t session;
+};
+
+/**
+ * A single entry in the journal or the snapshot.
+ */
+struct Record {
+    /// What the record holds (a RecordType)
+    uint32_t type;
+
+    /** The desktop of the client (or the current desktop), which is either
+     * the index of a user desktop or ICON_DESKTOP or STICKY_DESKTOP */
+    int32_t desktop;
+
+    /// The client which the record describes
+    uint64_t window;
+
+    /// The client's layer
+    int32_t layer;
+
+    /// The client's mode (a ClientPosScale)
+    int32_t mode;
+
+    /// The client's location
+    int32_t x, y;
+
+    /// The client's size
+    int32_t width, height;
+};
+
+bool capture(Window, Record&);
+void apply(Window, const Record&);
+size_t replay(const Record *, size_t);
+bool compact();
+void start_over();
+bool write_snapshot();
+
+/// The log, for reporting journals which can't be used
+Log &m_logger;
+
+/// The clients, whose state is recorded and restored
+ClientModel &m_clients;
+
+/// The path to the journal - the snapshot is next to it
+std::string m_path;
+
+/// The journal file
+int m_fd;
+
+/// Where the journal is mapped into memory
+char *m_map;
+
+/// Where the next record goes in the journal
+size_t m_offset;
+
+/// The generation of the snapshot that the journal follows on from
+uint64_t m_generation;
+
+/// The X server session, which only journals from the same session match
+uint64_t m_session;
+
+/** The state of every client that has been recorded, which is what the
+ * snapshot is written from. After open(), until restore(), this is the state
+ * that was recovered. */
+std::map<Window, Record> m_entries;
+
+/// The current desktop, as last recorded
+int32_t m_current_desktop;
+
+/// The clients which have changed in this batch
+std::set<Window> m_dirty;
+
+/// The clients which have been destroyed in this batch
+std::set<Window> m_forgotten;
+
+/// Whether the current desktop has changed in this batch
+bool m_desktop_dirty;
+
+/// The records of the batch, which are copied into the journal all at once
+std::vector<Record> m_batch;
+
+/// How many clients were put back where they were by restore()
+unsigned long m_recovered;
+
+/// How many times the journal has been compacted
+unsigned long m_compactions;
+};
+
+#endif // ifndef __SMALLWM_JOURNAL__
@@ -0,0 +1,149 @@
+/** @file */
+#include <algorithm>
+
+#include "latency-probe.hpp"
+#include "utils.hpp"
+
+/// How many latencies are kept for each kind of input
+static const size_t MAX_SAMPLES = 1024;
+
+/**
+ * Creates the marker window, if latencies are being measured.
+ * @param xdata Used to create and change the marker window.
+ * @param keys Used to name the keyboard actions.
+ * @param enabled Whether or not to measure latencies at all.
+ */
+LatencyProbe::LatencyProbe(XData &xdata, const KeyboardConfig &keys,
+                           bool enabled) :
+    m_xdata(xdata), m_marker(None), m_sequence(0) {
+    if (!enabled) return;
+
+    for (std::map<std::string, KeyboardAction>::const_iterator name = keys.action_names.begin();
+         name != keys.action_names.end();
+         name++) {
+        m_action_names[name->second] = name->first.c_str();
+    }
+
+    m_marker = m_xdata.create_window(true);
+    m_xdata.select_input(m_marker, PropertyChangeMask);
+}
+
+/**
+ * Starts measuring an input event. Only the first input of a batch is
+ * measured, since the rest of the batch is what delays it.
+ * @param name What kind of input this is - this must be a static string.
+ * @param server_time The X server's timestamp of the input event.
+ */
+void LatencyProbe::begin(const char *name, Time server_time) {
+    if (!enabled() || m_open.name) return;
+
+    m_open.name = name;
+    m_open.server_time = server_time;
+    m_open.received_at = monotonic_usec();
+}
+
+/**
+ * Starts measuring a keyboard shortcut.
+ * @param action The action the shortcut is bound to.
+ * @param server_time The X server's timestamp of the KeyPress.
+ */
+void LatencyProbe::begin_action(KeyboardAction action, Time server_time) {
+    if (!enabled()) return;
+
+    std::map<KeyboardAction, const char *>::iterator name = m_action_names.find(action);
+
+    if (name != m_action_names.end()) begin(name->second, server_time);
+}
+
+/**
+ * Called after a batch of changes has been applied. If the batch was started
+ * by an input event, the marker is changed so that the server tells us when
+ * it has caught up.
+ */
+void LatencyProbe::end_batch() {
+    if (!m_open.name) return;
+
+    m_sequence++;
+    m_xdata.change_property(m_marker, "_SMALLWM_LATENCY_MARKER", XA_CARDINAL,
+                            reinterpret_cast<const unsigned char *>(&m_sequence), 1);
+
+    m_in_flight.push_back(m_open);
+    m_open = Probe();
+}
+
+/**
+ * Records the latency of the oldest batch, once the PropertyNotify for its
+ * marker arrives.
+ * @param server_time The X server's timestamp of the PropertyNotify.
+ */
+void LatencyProbe::complete(Time server_time) {
+    if (m_in_flight.empty()) return;
+
+    Probe &probe = m_in_flight.front();
+
+    // Server timestamps wrap around every 49 days or so, which the unsigned
+    // subtraction handles
+    unsigned long server_msec = static_cast<unsigned long>(
+        static_cast<unsigned int>(server_time - probe.server_time));
+
+    m_samples[probe.name].add(monotonic_usec() - probe.received_at, server_msec);
+    m_in_flight.pop_front();
+}
+
+/**
+ * Records a single latency, replacing the oldest once the buffers are full.
+ */
+void LatencyProbe::Samples::add(unsigned long wm, unsigned long server) {
+    count++;
+
+    if (wm_usec.size() < MAX_SAMPLES) {
+        wm_usec.push_back(wm);
+        server_msec.push_back(server);
+    } else {
+        wm_usec[next] = wm;
+        server_msec[next] = server;
+        next = (next + 1) % MAX_SAMPLES;
+    }
+}
+
+/**
+ * Writes the percentiles of a set of latencies.
+ * @param output Where to write the percentiles.
+ * @param label What the latencies are.
+ * @param samples The latencies - this is a copy, since it gets sorted.
+ * @param unit The unit of the latencies.
+ */
+void LatencyProbe::dump_percentiles(std::ostream &output, const char *label,
+                                    std::vector<unsigned long> samples,
+                                    const char *unit) {
+    std::sort(samples.begin(), samples.end());
+
+    size_t last = samples.size() - 1;
+
+    output << "    " << label << ": " <<
+        "p50 " << samples[last * 50 / 100] << unit << " " <<
+        "p90 " << samples[last * 90 / 100] << unit << " " <<
+        "p99 " << samples[last * 99 / 100] << unit << " " <<
+        "max " << samples[last] << unit << "\n";
+}
+
+/**
+ * Converts the recorded latencies to a textual representation, which is
+ * written to an output stream.
+ */
+void LatencyProbe::dump(std::ostream &output) {
+    if (!enabled()) return;
+
+    output << "Latency\n";
+    output << "  In flight: " << std::dec << m_in_flight.size() << "\n";
+
+    for (std::map<std::string, Samples>::iterator samples = m_samples.begin();
+         samples != m_samples.end();
+         samples++) {
+        output << "  Input: " << samples->first << "\n";
+        output << "    Count: " << samples->second.count << "\n";
+
+        dump_percentiles(output, "WM", samples->second.wm_usec, "us");
+        dump_percentiles(output, "Server", samples->second.server_msec, "ms");
+    }
+}
@@ -0,0 +1,118 @@
+/** @file */
+#ifndef __SMALLWM_LATENCY_PROBE__
+#define __SMALLWM_LATENCY_PROBE__
+
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "configparse.hpp"
+#include "xdata.hpp"
+
+/**
+ * Measures how long it takes from an input event reaching the window manager
+ * to the X server having processed everything the window manager did in
+ * response to it.
+ *
+ * When an input event starts a batch, the time it was received (and its X
+ * server timestamp) are recorded. Once the batch's changes have been applied,
+ * a property is changed on a hidden marker window. Since the server handles
+ * requests in order, the PropertyNotify for the marker arrives only after
+ * every request in the batch has been processed - and unlike XSync, nothing
+ * has to wait for it.
+ */
+class LatencyProbe
+{
+public:
+LatencyProbe(XData &xdata, const KeyboardConfig &keys, bool enabled);
+
+/// Whether or not latencies are being measured
+bool enabled() const {
+    return m_marker != None;
+};
+
+/// Whether or not the window is the marker window
+bool is_marker(Window window) const {
+    return window != None && window == m_marker;
+};
+
+void begin(const char *, Time);
+void begin_action(KeyboardAction, Time);
+void end_batch();
+void complete(Time);
+
+void dump(std::ostream&);
+
+private:
+/**
+ * An input event whose effects haven't been processed by the server yet.
+ */
+struct Probe {
+    Probe() :
+        name(0), server_time(0), received_at(0) {
+    };
+
+    /// What kind of input this was
+    const char *name;
+
+    /// The X server's timestamp of the input event
+    Time server_time;
+
+    /// When the input event was received, in microseconds
+    unsigned long long received_at;
+};
+
+/**
+ * The most recent latencies of one kind of input.
+ */
+struct Samples {
+    Samples() :
+        count(0), next(0) {
+    };
+
+    void add(unsigned long, unsigned long);
+
+    /// How many latencies have been recorded in total
+    unsigned long count;
+
+    /// Where the next latency goes, once the buffers are full
+    size_t next;
+
+    /// Time from receiving the input to seeing the marker, in microseconds
+    std::vector<unsigned long> wm_usec;
+
+    /** Time from the input to the marker by the server's clock, in
+     * milliseconds (this includes the time the input spent queued before
+     * the window manager read it) */
+    std::vector<unsigned long> server_msec;
+};
+
+void dump_percentiles(std::ostream&, const char *, std::vector<unsigned long>,
+                      const char *);
+
+/// Used to change the marker's property
+XData &m_xdata;
+
+/// The hidden window whose property marks the end of a batch
+Window m_marker;
+
+/// The configuration names of each keyboard action
+std::map<KeyboardAction, const char *> m_action_names;
+
+/// The input which started the current batch, if any
+Probe m_open;
+
+/// Batches whose markers haven't come back yet, oldest first
+std::deque<Probe> m_in_flight;
+
+/// The value written to the marker, which changes each time
+unsigned long m_sequence;
+
+/// The recorded latencies, keyed by the name of the input
+std::map<std::string, Samples> m_samples;
+};
+
+#endif // ifndef __SMALLWM_LATENCY_PROBE__
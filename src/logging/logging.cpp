@@ -1,6 +1,16 @@
 /** @file */
 #include "logging.hpp"
 
+/**
+ * Starts building up a log message which comes from a known location. Loggers
+ * which don't care where messages come from just ignore the location.
+ * @param priority The priority of the message.
+ * @param site Where the message came from - this should be LOG_SITE.
+ */
+Log &Log::log(int priority, const char *site) {
+    return log(priority);
+}
+
 /**
  * Does special processing for Log::endl.
  * @param manipulator This should only ever by Log::endl.
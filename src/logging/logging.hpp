@@ -9,6 +9,15 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#define __SMALLWM_LOG_STRINGIFY(x) #x
+#define __SMALLWM_LOG_TOSTRING(x) __SMALLWM_LOG_STRINGIFY(x)
+
+/**
+ * Identifies the place where a message is logged from. Passing this to
+ * Log::log allows loggers to rate limit each call site independently.
+ */
+#define LOG_SITE __FILE__ ":" __SMALLWM_LOG_TOSTRING(__LINE__)
+
 /**
  * A basic logging API, which can be used to define the various kinds of
  * loggers.
@@ -16,14 +25,24 @@
 class Log
 {
 public:
+Log() : m_discarding(false) {
+}
+
+virtual ~Log() {
+}
+
 virtual void stop() = 0;
 
 virtual Log &log(int) = 0;
+virtual Log &log(int, const char *);
 virtual void write(std::string&) = 0;
 virtual void flush() = 0;
 
 template<typename T>
 Log &operator<<(T value) {
+    // Don't bother formatting anything which will be thrown away
+    if (m_discarding) return *this;
+
     m_formatter.str("");
     m_formatter << value;
 
@@ -39,6 +58,10 @@ static Log &endl(Log &stream);
 protected:
 // A utility object, used to input things via <<
 std::ostringstream m_formatter;
+
+// Whether the current message is going to be dropped - set by loggers which
+// know this in advance, so that the message is never formatted
+bool m_discarding;
 };
 
 /// The type of Log::endl
@@ -0,0 +1,190 @@
+/** @file */
+#include "throttle.hpp"
+#include "../utils.hpp"
+
+/**
+ * The sites used for messages which don't give one - these are grouped by
+ * their priority, so that a storm of anonymous warnings can't drown out errors.
+ */
+static const char *PRIORITY_SITES[] = {
+    "<emerg>", "<alert>", "<crit>", "<err>",
+    "<warning>", "<notice>", "<info>", "<debug>"
+};
+
+ThrottledLog::~ThrottledLog() {
+    delete m_repeat_timer;
+}
+
+/**
+ * Uses the given loop to write out repeat summaries when the dedup window
+ * runs out, rather than waiting for the next different message.
+ */
+void ThrottledLog::use_loop(EventLoop &loop) {
+    if (!m_repeat_timer) m_repeat_timer = new Timer(loop, this, "log-repeats");
+}
+
+/**
+ * Writes out any pending repeat summary, and stops the underlying log.
+ */
+void ThrottledLog::stop() {
+    flush_repeats();
+    m_target.stop();
+}
+
+/**
+ * Starts building up a message which doesn't identify where it came from.
+ */
+Log &ThrottledLog::log(int priority) {
+    return log(priority, PRIORITY_SITES[LOG_PRI(priority)]);
+}
+
+/**
+ * Starts building up a message from the given site. If the site is over its
+ * rate limit, then the message is discarded without being formatted.
+ *
+ * The exception is the site of the last message, whose messages have to be
+ * formatted to find out whether they are duplicates - those are only charged
+ * once they turn out not to be.
+ */
+Log &ThrottledLog::log(int priority, const char *site) {
+    m_priority = priority;
+    m_site = site;
+    m_message.str("");
+    m_deferred = site == m_last_site;
+    m_discarding = !m_deferred && !take_token(site);
+    return *this;
+}
+
+/**
+ * Adds a new fragment to the current message.
+ */
+void ThrottledLog::write(std::string &str) {
+    m_message << str;
+}
+
+/**
+ * Completes the current message, and passes it on to the target log unless it
+ * is a duplicate of the previous message.
+ */
+void ThrottledLog::flush() {
+    if (m_discarding) {
+        m_discarding = false;
+        m_rate_limited++;
+        return;
+    }
+
+    AccountedString<MEM_LOGGING> message = m_message.str();
+    m_message.str("");
+
+    unsigned long long now = monotonic_usec();
+
+    if (m_priority == m_last_priority &&
+        message == m_last_message &&
+        now - m_last_time < m_dedup_window) {
+        // The summary is due when the window runs out, whether or not
+        // anything else gets logged by then
+        if (m_repeats == 0 && m_repeat_timer)
+            m_repeat_timer->arm((m_last_time + m_dedup_window - now) / 1000 + 1);
+
+        m_repeats++;
+        m_deduplicated++;
+        return;
+    }
+
+    if (m_deferred && !take_token(m_site)) {
+        m_rate_limited++;
+        return;
+    }
+
+    flush_repeats();
+
+    SiteBucket &bucket = m_sites[m_site];
+
+    if (bucket.suppressed > 0) {
+        m_target.log(m_priority) <<
+            bucket.suppressed << " messages from " << m_site <<
+            " were suppressed" << Log::endl;
+        bucket.suppressed = 0;
+    }
+
+    m_target.log(m_priority) << message << Log::endl;
+    m_written++;
+
+    m_last_message = message;
+    m_last_site = m_site;
+    m_last_priority = m_priority;
+    m_last_time = now;
+}
+
+/**
+ * Converts the suppression counters to a textual representation, which is
+ * written to an output stream.
+ */
+void ThrottledLog::dump(std::ostream &output) {
+    output << "Logging\n";
+    output << "  Written: " << std::dec << m_written << "\n";
+    output << "  Deduplicated: " << m_deduplicated << "\n";
+    output << "  Rate limited: " << m_rate_limited << "\n";
+
+    for (AccountedMap<const char *, SiteBucket, MEM_LOGGING>::iterator site = m_sites.begin();
+         site != m_sites.end();
+         site++) {
+        if (site->second.total_suppressed == 0) continue;
+
+        output << "  Site " << site->first << ": " <<
+            site->second.total_suppressed << " suppressed\n";
+    }
+}
+
+/**
+ * Writes out the repeat summary of the last message, once its dedup window
+ * has run out.
+ */
+void ThrottledLog::timer_expired(Timer *timer) {
+    flush_repeats();
+}
+
+/**
+ * Takes a token from the bucket of the given site, refilling the bucket
+ * according to how long it has been since the site last logged.
+ *
+ * @return true if the site may log, false if it has exceeded its rate.
+ */
+bool ThrottledLog::take_token(const char *site) {
+    if (m_rate == 0) return true;
+
+    SiteBucket &bucket = m_sites[site];
+    unsigned long long now = monotonic_usec();
+
+    if (bucket.last_refill == 0) bucket.tokens = m_burst;
+    else {
+        bucket.tokens += (now - bucket.last_refill) * m_rate / 1000000.0;
+
+        if (bucket.tokens > m_burst) bucket.tokens = m_burst;
+    }
+
+    bucket.last_refill = now;
+
+    if (bucket.tokens >= 1.0) {
+        bucket.tokens -= 1.0;
+        return true;
+    }
+
+    bucket.suppressed++;
+    bucket.total_suppressed++;
+    return false;
+}
+
+/**
+ * Writes out how many times the last message was repeated, if it was
+ * repeated at all.
+ */
+void ThrottledLog::flush_repeats() {
+    if (m_repeats == 0) return;
+
+    if (m_repeat_timer) m_repeat_timer->disarm();
+
+    m_target.log(m_last_priority) <<
+        "last message repeated " << m_repeats << " times" << Log::endl;
+    m_repeats = 0;
+}
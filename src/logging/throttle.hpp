@@ -0,0 +1,146 @@
+/** @file */
+#ifndef __SMALLWM_LOGGING_THROTTLE__
+#define __SMALLWM_LOGGING_THROTTLE__
+
+#include "logging.hpp"
+#include "../event-loop.hpp"
+#include "../memory.hpp"
+#include "../timer.hpp"
+
+#include <map>
+#include <ostream>
+
+/**
+ * A Log which sits in front of another Log, and keeps a misbehaving client
+ * from flooding it. This is done in two ways:
+ *
+ *  - Messages identical to the previous one are counted rather than written,
+ *    and replaced by a "last message repeated N times" summary, which is
+ *    written once the dedup window runs out (if a loop has been given to
+ *    time it) or the next different message comes along.
+ *  - Each call site (see LOG_SITE) gets a token bucket, and messages from a
+ *    site which has exhausted its bucket are dropped before being formatted.
+ */
+class ThrottledLog : public Log, public TimerListener
+{
+public:
+ThrottledLog(Log &target, unsigned long dedup_window_ms,
+             unsigned long rate, unsigned long burst) :
+    m_target(target),
+    m_dedup_window(dedup_window_ms * 1000ULL),
+    m_rate(rate),
+    m_burst(burst),
+    m_priority(LOG_INFO),
+    m_site(NULL),
+    m_deferred(false),
+    m_last_site(NULL),
+    m_last_priority(LOG_INFO),
+    m_last_time(0),
+    m_repeats(0),
+    m_written(0),
+    m_deduplicated(0),
+    m_rate_limited(0),
+    m_repeat_timer(NULL) {
+}
+
+~ThrottledLog();
+
+void use_loop(EventLoop&);
+void stop();
+
+Log &log(int);
+Log &log(int, const char *);
+void write(std::string&);
+void flush();
+
+void dump(std::ostream&);
+
+void timer_expired(Timer *);
+
+/// The number of messages which were passed along to the target.
+unsigned long written() const {
+    return m_written;
+}
+
+/// The number of messages which were dropped for any reason.
+unsigned long dropped() const {
+    return m_deduplicated + m_rate_limited;
+}
+
+private:
+/**
+ * The rate limiting state of a single call site.
+ */
+struct SiteBucket {
+    SiteBucket() : tokens(0), last_refill(0), suppressed(0), total_suppressed(0) {
+    }
+
+    /// How many messages the site can log right now
+    double tokens;
+
+    /// When the tokens were last refilled, in microseconds
+    unsigned long long last_refill;
+
+    /// How many messages have been dropped since the last one got through
+    unsigned long suppressed;
+
+    /// How many messages have been dropped over the life of the log
+    unsigned long total_suppressed;
+};
+
+bool take_token(const char *);
+void flush_repeats();
+
+/// The log which receives the messages that get through
+Log &m_target;
+
+/// How long, in microseconds, identical messages are folded together
+unsigned long long m_dedup_window;
+
+/// How many messages each site may write per second (0 means no limit)
+unsigned long m_rate;
+
+/// How many messages each site may write in a burst
+unsigned long m_burst;
+
+/// The priority of the message being built
+int m_priority;
+
+/// The site of the message being built
+const char *m_site;
+
+/** Whether the message being built is from the same site as the last one,
+ * in which case it isn't charged against the site's rate limit until it is
+ * known not to be a duplicate */
+bool m_deferred;
+
+/// The contents of the message being built
+AccountedStringStream<MEM_LOGGING> m_message;
+
+/// The last message which was passed to the target
+AccountedString<MEM_LOGGING> m_last_message;
+
+/// The site of the last message which was passed to the target
+const char *m_last_site;
+
+/// The priority of the last message which was passed to the target
+int m_last_priority;
+
+/// When the last message was passed to the target
+unsigned long long m_last_time;
+
+/// How many times the last message has been repeated since it was written
+unsigned long m_repeats;
+
+/// The rate limiting state of every site, keyed by LOG_SITE
+AccountedMap<const char *, SiteBucket, MEM_LOGGING> m_sites;
+
+/// Counters for the dump
+unsigned long m_written, m_deduplicated, m_rate_limited;
+
+/** Expires when the dedup window of the last message runs out, so that its
+ * repeat summary is written - only armed while there are repeats */
+Timer *m_repeat_timer;
+};
+
+#endif // ifndef __SMALLWM_LOGGING_THROTTLE__
@@ -0,0 +1,70 @@
+/** @file */
+#include "memory.hpp"
+
+/// The names of each subsystem, as they appear in the dump
+static const char *SUBSYSTEM_NAMES[] = {
+    "Client model", "Changes", "X model", "Logging"
+};
+
+/// The names of each subsystem, as they appear in metrics
+static const char *SUBSYSTEM_LABELS[] = {
+    "client_model", "changes", "x_model", "logging"
+};
+
+/**
+ * Records that a subsystem has allocated some memory.
+ */
+void MemoryAccount::allocated(size_t bytes) {
+    size_t live = m_live.fetch_add(bytes) + bytes;
+    size_t peak = m_peak.load();
+
+    while (live > peak && !m_peak.compare_exchange_weak(peak, live)) ;
+
+    m_allocations++;
+}
+
+/**
+ * Records that a subsystem has freed some memory.
+ */
+void MemoryAccount::freed(size_t bytes) {
+    m_live.fetch_sub(bytes);
+}
+
+/**
+ * Writes out the counters of a single subsystem.
+ */
+void MemoryAccount::dump(std::ostream &output) const {
+    output << std::dec << "live " << m_live.load() << " peak " << m_peak.load() <<
+        " allocations " << m_allocations.load();
+}
+
+/**
+ * Gets the account which a subsystem's allocations are charged to.
+ */
+MemoryAccount &memory_account(MemorySubsystem subsystem) {
+    // This is a function-local static, so that it exists before any other
+    // static object can allocate memory from it
+    static MemoryAccount accounts[MEM_SUBSYSTEMS];
+    return accounts[subsystem];
+}
+
+/**
+ * Gets the name that a subsystem is labelled with in metrics.
+ */
+const char *memory_subsystem_label(MemorySubsystem subsystem) {
+    return SUBSYSTEM_LABELS[subsystem];
+}
+
+/**
+ * Converts the memory use of every subsystem to a textual representation,
+ * which is written to the output stream.
+ */
+void dump_memory(std::ostream &output) {
+    output << "Memory\n";
+
+    for (int subsystem = 0; subsystem < MEM_SUBSYSTEMS; subsystem++) {
+        output << "  " << SUBSYSTEM_NAMES[subsystem] << ": ";
+        memory_account(static_cast<MemorySubsystem>(subsystem)).dump(output);
+        output << "\n";
+    }
+}
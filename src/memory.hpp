@@ -0,0 +1,141 @@
+/** @file */
+#ifndef __SMALLWM_MEMORY__
+#define __SMALLWM_MEMORY__
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+
+/**
+ * The parts of SmallWM whose memory use is accounted for separately.
+ */
+enum MemorySubsystem {
+    MEM_CLIENT_MODEL = 0,
+    MEM_CHANGES,
+    MEM_X_MODEL,
+    MEM_LOGGING,
+    MEM_SUBSYSTEMS,
+};
+
+/**
+ * How much memory a subsystem is using, and how much it has used. This is
+ * updated from whatever thread does the allocation, so every counter is
+ * atomic.
+ */
+class MemoryAccount
+{
+public:
+MemoryAccount() :
+    m_live(0), m_peak(0), m_allocations(0) {
+};
+
+void allocated(size_t);
+void freed(size_t);
+
+void dump(std::ostream&) const;
+
+/// How many bytes are currently allocated.
+size_t live() const {
+    return m_live.load();
+}
+
+/// The most bytes that have been allocated at once.
+size_t peak() const {
+    return m_peak.load();
+}
+
+/// How many allocations have been made.
+unsigned long allocations() const {
+    return m_allocations.load();
+}
+
+private:
+/// How many bytes are currently allocated
+std::atomic<size_t> m_live;
+
+/// The most bytes that have been allocated at once
+std::atomic<size_t> m_peak;
+
+/// How many allocations have been made
+std::atomic<unsigned long> m_allocations;
+};
+
+MemoryAccount &memory_account(MemorySubsystem);
+const char *memory_subsystem_label(MemorySubsystem);
+void dump_memory(std::ostream&);
+
+/**
+ * An allocator which charges everything it allocates to a subsystem, and
+ * otherwise behaves like std::allocator.
+ */
+template <typename T, MemorySubsystem subsystem>
+class CountingAllocator
+{
+public:
+typedef T value_type;
+
+template <typename U>
+struct rebind {
+    typedef CountingAllocator<U, subsystem> other;
+};
+
+CountingAllocator() {
+};
+
+template <typename U>
+CountingAllocator(const CountingAllocator<U, subsystem>&) {
+};
+
+T *allocate(size_t count) {
+    T *memory = std::allocator<T>().allocate(count);
+    memory_account(subsystem).allocated(count * sizeof(T));
+    return memory;
+}
+
+void deallocate(T *memory, size_t count) {
+    memory_account(subsystem).freed(count * sizeof(T));
+    std::allocator<T>().deallocate(memory, count);
+}
+};
+
+template <typename T, typename U, MemorySubsystem subsystem>
+bool operator==(const CountingAllocator<T, subsystem>&,
+                const CountingAllocator<U, subsystem>&) {
+    return true;
+}
+
+template <typename T, typename U, MemorySubsystem subsystem>
+bool operator!=(const CountingAllocator<T, subsystem>&,
+                const CountingAllocator<U, subsystem>&) {
+    return false;
+}
+
+/// A std::map which is accounted to a subsystem
+template <typename K, typename V, MemorySubsystem subsystem,
+          typename Compare = std::less<K> >
+using AccountedMap = std::map<K, V, Compare,
+                              CountingAllocator<std::pair<const K, V>, subsystem> >;
+
+/// A std::set which is accounted to a subsystem
+template <typename T, MemorySubsystem subsystem>
+using AccountedSet = std::set<T, std::less<T>, CountingAllocator<T, subsystem> >;
+
+/// A std::string which is accounted to a subsystem
+template <MemorySubsystem subsystem>
+using AccountedString = std::basic_string<char, std::char_traits<char>,
+                                          CountingAllocator<char, subsystem> >;
+
+/// A std::ostringstream whose buffer is accounted to a subsystem
+template <MemorySubsystem subsystem>
+using AccountedStringStream =
+    std::basic_ostringstream<char, std::char_traits<char>,
+                             CountingAllocator<char, subsystem> >;
+
+#endif // ifndef __SMALLWM_MEMORY__
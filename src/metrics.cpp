@@ -0,0 +1,137 @@
+/** @file */
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "metrics.hpp"
+
+/**
+ * Writes out the formatted metrics to a temporary file, and then renames it
+ * over the metrics file.
+ */
+struct MetricsWriteTask : public WorkerTask {
+    MetricsWriteTask(MetricsExporter &_exporter, const std::string &_filename,
+                     const std::string &_contents) :
+        WorkerTask("metrics-write"), exporter(_exporter), filename(_filename),
+        contents(_contents), succeeded(false) {
+    };
+
+    void run() {
+        // The collector only reads files ending in .prom, so this is never
+        // picked up by accident
+        std::string temporary = filename + ".tmp";
+        std::ofstream metrics_file(temporary.c_str(),
+                                   std::ofstream::out | std::ofstream::trunc);
+
+        if (!metrics_file) return;
+
+        metrics_file << contents;
+        metrics_file.close();
+
+        if (metrics_file.fail()) {
+            std::remove(temporary.c_str());
+            return;
+        }
+
+        succeeded = std::rename(temporary.c_str(), filename.c_str()) == 0;
+    };
+
+    void complete() {
+        exporter.write_finished(succeeded);
+    };
+
+    /// The exporter which submitted the write
+    MetricsExporter &exporter;
+
+    /// The file to replace with the metrics
+    std::string filename;
+
+    /// The formatted metrics
+    std::string contents;
+
+    /// Whether or not the metrics were written out
+    bool succeeded;
+};
+
+/**
+ * Starts a new metric.
+ * @param name The name of the metric, which should start with smallwm_.
+ * @param type The type of the metric - counter or gauge.
+ * @param help A description of the metric.
+ */
+void MetricsWriter::family(const char *name, const char *type, const char *help) {
+    m_output << "# HELP " << name << " " << help << "\n";
+    m_output << "# TYPE " << name << " " << type << "\n";
+}
+
+/**
+ * Writes out a sample of a metric without any labels.
+ */
+void MetricsWriter::sample(const char *name, unsigned long long value) {
+    m_output << name << " " << std::dec << value << "\n";
+}
+
+/**
+ * Writes out a sample of a metric, with a single label.
+ */
+void MetricsWriter::sample(const char *name, const char *label,
+                           const std::string &label_value, unsigned long long value) {
+    m_output << name << "{" << label << "=\"";
+
+    for (std::string::const_iterator character = label_value.begin();
+         character != label_value.end();
+         character++) {
+        if (*character == '\\') m_output << "\\\\";
+        else if (*character == '"') m_output << "\\\"";
+        else if (*character == '\n') m_output << "\\n";
+        else m_output << *character;
+    }
+
+    m_output << "\"} " << std::dec << value << "\n";
+}
+
+/**
+ * Starts writing out the metrics periodically.
+ * @param filename The file to write to, which should end in .prom.
+ * @param interval How often, in seconds, to write out the metrics.
+ */
+void MetricsExporter::start(const std::string &filename, unsigned long interval) {
+    m_filename = filename;
+    m_timer.arm(interval * 1000, interval * 1000);
+}
+
+/**
+ * Collects the metrics and hands them to a worker to be written out.
+ */
+void MetricsExporter::timer_expired(Timer *timer) {
+    if (m_writing) {
+        m_skipped++;
+        return;
+    }
+
+    std::ostringstream contents;
+    MetricsWriter writer(contents);
+    m_source.metrics(writer);
+
+    m_writing = true;
+    m_workers.submit(new MetricsWriteTask(*this, m_filename, contents.str()));
+}
+
+/**
+ * Reports the result of a write, once the worker has finished it.
+ */
+void MetricsExporter::write_finished(bool succeeded) {
+    m_writing = false;
+
+    if (!succeeded) {
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
+            "Could not write metrics to '" << m_filename << "'" << Log::endl;
+    }
+
+    if (m_skipped > 0) {
+        m_logger.log(LOG_WARNING, LOG_SITE) <<
+            "Skipped " << m_skipped << " metrics writes while waiting for '" <<
+            m_filename << "'" << Log::endl;
+        m_skipped = 0;
+    }
+}
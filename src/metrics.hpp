@@ -0,0 +1,99 @@
+/** @file */
+#ifndef __SMALLWM_METRICS__
+#define __SMALLWM_METRICS__
+
+#include <ostream>
+#include <string>
+
+#include "logging/logging.hpp"
+#include "event-loop.hpp"
+#include "timer.hpp"
+#include "worker-pool.hpp"
+
+/**
+ * Writes out metrics in the Prometheus text format. Each metric is introduced
+ * by family(), which is followed by that metric's samples.
+ */
+class MetricsWriter
+{
+public:
+MetricsWriter(std::ostream &output) :
+    m_output(output) {
+};
+
+void family(const char *, const char *, const char *);
+void sample(const char *, unsigned long long);
+void sample(const char *, const char *, const std::string&, unsigned long long);
+
+private:
+/// Where the metrics are written to
+std::ostream &m_output;
+};
+
+/**
+ * Something which can report its metrics - this is called on the X thread,
+ * so it can look at any of the models.
+ */
+class MetricsSource
+{
+public:
+virtual ~MetricsSource() {
+};
+
+/**
+ * Writes out all of the metrics.
+ */
+virtual void metrics(MetricsWriter&) = 0;
+};
+
+/**
+ * Writes the metrics of a MetricsSource to a file every few seconds, in the
+ * format expected by node-exporter's textfile collector.
+ *
+ * The metrics are collected on the X thread, but written out by a worker.
+ * Each write goes to a temporary file which is then renamed over the real one,
+ * so that the collector never reads a partially-written file.
+ *
+ * This is the only timer which runs while SmallWM is otherwise idle, which is
+ * why it is only armed when a metrics file has been configured.
+ */
+class MetricsExporter : public TimerListener
+{
+public:
+MetricsExporter(Log &logger, EventLoop &loop, WorkerPool &workers,
+                MetricsSource &source) :
+    m_logger(logger), m_workers(workers), m_source(source),
+    m_timer(loop, this, "metrics"), m_writing(false), m_skipped(0) {
+};
+
+void start(const std::string&, unsigned long);
+
+void timer_expired(Timer *);
+
+void write_finished(bool);
+
+private:
+/// The log, for reporting metrics which can't be written
+Log &m_logger;
+
+/// The workers which write out the metrics
+WorkerPool &m_workers;
+
+/// Where the metrics come from
+MetricsSource &m_source;
+
+/// Expires whenever the metrics are due to be written
+Timer m_timer;
+
+/// The file that the metrics are written to
+std::string m_filename;
+
+/** Whether a write is still running - if the file is on a slow filesystem,
+ * writes are skipped rather than being queued up behind it */
+bool m_writing;
+
+/// How many writes have been skipped since the last one finished
+unsigned long m_skipped;
+};
+
+#endif // ifndef __SMALLWM_METRICS__
@@ -1,5 +1,34 @@
 /** @file */
 #include "changes.hpp"
+#include "../object-pool.hpp"
+
+/**
+ * Gets the pools which changes are allocated from. Every change is small, so
+ * only a few size classes are needed.
+ */
+static SizedPools &change_pools() {
+    static SizedPools pools("Change", 64);
+    return pools;
+}
+
+/**
+ * Allocates a change from the change pools, charging it to the change queue's
+ * memory account.
+ */
+void *Change::operator new(size_t size) {
+    void *memory = change_pools().allocate(size);
+    memory_account(MEM_CHANGES).allocated(size);
+    return memory;
+}
+
+/**
+ * Frees a change. Since the destructor is virtual, the size is that of the
+ * whole change, and not just the base.
+ */
+void Change::operator delete(void *memory, size_t size) {
+    memory_account(MEM_CHANGES).freed(size);
+    change_pools().release(memory, size);
+}
 
 /**
  * Returns true if there are changes to be processed, or  false otherwise.
@@ -2,12 +2,14 @@
 #ifndef __SMALLWM_MODEL_CHANGE__
 #define __SMALLWM_MODEL_CHANGE__
 
+#include <deque>
 #include <memory>
 #include <ostream>
 #include <queue>
 #include <vector>
 
 #include "../common.hpp"
+#include "../memory.hpp"
 #include "desktop-type.hpp"
 
 /**
@@ -22,6 +24,9 @@ struct Change {
     virtual ~Change() {
     };
 
+    static void *operator new(size_t);
+    static void operator delete(void *, size_t);
+
     virtual bool is_layer_change() const {
         return false;
     }
@@ -452,6 +457,30 @@ static std::ostream &operator<<(std::ostream &out, const ChildRemoveChange &chan
     return out;
 }
 
+/**
+ * Something which wants to see every change after it has been applied, such
+ * as something which reports changes outside of SmallWM.
+ */
+class ChangeObserver
+{
+public:
+virtual ~ChangeObserver() {
+};
+
+/**
+ * Called with each change, before it has been applied - this is the last
+ * chance to do anything before the change reaches the X server.
+ */
+virtual void prepare(const Change&) {
+};
+
+/// Called with each change, after it has been applied.
+virtual void observe(const Change&) = 0;
+
+/// Called after every change in a batch has been applied.
+virtual void end_batch() = 0;
+};
+
 /**
  * Contains a series of changes. Changes can be pushed to the ChangeStream, and
  * then retrieved later.
@@ -469,7 +498,8 @@ void push(change_ptr);
 void flush();
 
 private:
-std::queue<change_ptr> m_changes;
+std::queue<change_ptr,
+           std::deque<change_ptr, CountingAllocator<change_ptr, MEM_CHANGES> > > m_changes;
 };
 
 #endif // ifndef __SMALLWM_MODEL_CHANGE__
@@ -72,11 +72,35 @@ void ClientModel::get_visible_clients(std::vector<Window> &return_clients) {
  * top.
  */
 void ClientModel::get_visible_in_layer_order(std::vector<Window> &return_clients) {
-    get_visible_clients(return_clients);
+    layer_order_range visible = visible_in_layer_order();
+    return_clients.insert(return_clients.end(), visible.begin(), visible.end());
+}
+
+/**
+ * Gets a view of the clients on a desktop. This is invalidated when any client
+ * is added to or removed from that desktop.
+ */
+ClientModel::client_range ClientModel::clients_of(Desktop *desktop) {
+    return client_range(m_desktops.get_members_of_begin(desktop),
+                        m_desktops.get_members_of_end(desktop));
+}
+
+/**
+ * Gets how many clients are on a desktop.
+ */
+size_t ClientModel::count_clients_of(Desktop *desktop) {
+    return m_desktops.count_members_of(desktop);
+}
 
-    UniqueMultimapSorter<Layer, Window> layer_sorter(m_layers);
-    std::sort(return_clients.begin(), return_clients.end(),
-              layer_sorter);
+/**
+ * Gets a view of the visible clients, from the bottom layer to the top. This
+ * is invalidated when any client changes layers, or is added or removed, and
+ * it becomes inaccurate when the visible desktop changes or a client moves
+ * between desktops.
+ */
+ClientModel::layer_order_range ClientModel::visible_in_layer_order() {
+    return layer_order_range(LayerOrderIterator(this, MIN_LAYER),
+                             LayerOrderIterator(this, MAX_LAYER + 1));
 }
 
 /**
@@ -93,13 +117,155 @@ Window ClientModel::get_parent_of(Window child) {
  */
 void ClientModel::get_children_of(Window               client,
                                   std::vector<Window> &return_children) {
-    if (!is_client(client)) return;
+    child_range children = children_of(client);
+    return_children.insert(return_children.end(), children.begin(), children.end());
+}
 
-    for (std::set<Window>::iterator child = m_children[client]->begin();
-         child != m_children[client]->end();
-         child++) {
-        return_children.push_back(*child);
+/**
+ * Gets a view of the children of a client, which is empty if the window isn't
+ * a client. This is invalidated when a child is added to or removed from the
+ * client, or the client is removed.
+ */
+ClientModel::child_range ClientModel::children_of(Window client) {
+    static const WindowSet no_children;
+
+    ModelMap<Window, WindowSet>::const_iterator children = m_children.find(client);
+
+    if (children == m_children.end())
+        return child_range(no_children.begin(), no_children.end());
+
+    return child_range(children->second.begin(), children->second.end());
+}
+
+/// The most places along each axis that find_free_space tries
+static const size_t MAX_FREE_SPACE_EDGES = 16;
+
+/**
+ * Sorts a list of edges and removes the duplicates. If that leaves too many,
+ * only an evenly spread selection of them is kept, including the first and
+ * the last.
+ */
+static void thin_edges(std::vector<Dimension> &edges) {
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    if (edges.size() <= MAX_FREE_SPACE_EDGES) return;
+
+    size_t last = edges.size() - 1;
+
+    for (size_t kept = 0; kept < MAX_FREE_SPACE_EDGES; kept++)
+        edges[kept] = edges[kept * last / (MAX_FREE_SPACE_EDGES - 1)];
+
+    edges.resize(MAX_FREE_SPACE_EDGES);
+}
+
+/**
+ * Finds where a new client would cover as little of the visible clients as
+ * possible, inside the work area of the screen containing a location. The
+ * places tried are the corners of the work area, and the right and bottom
+ * edges of the visible clients which overlap the work area (or some of them,
+ * when there are a lot).
+ *
+ * @param location Where the client is now, which picks the screen.
+ * @param size The size of the client, not counting its border.
+ * @return The least covered place, or the given location if the client
+ * doesn't fit inside the work area.
+ */
+Dimension2D ClientModel::find_free_space(Dimension2D location, Dimension2D size) {
+    Crt *screen = m_crt_manager.screen_of_coord(DIM2D_X(location), DIM2D_Y(location));
+
+    if (!screen) screen = m_crt_manager.root();
+
+    const Box &area = m_crt_manager.work_area_of_screen(screen);
+    Dimension area_right = area.x + area.width;
+    Dimension area_bottom = area.y + area.height;
+
+    Dimension width = DIM2D_WIDTH(size), height = DIM2D_HEIGHT(size);
+
+    #ifdef WITH_BORDERS
+    width += m_border_width * 2;
+    height += m_border_width * 2;
+    #endif
+
+    if (width > area.width || height > area.height) return location;
+
+    const BoxSet &boxes = visible_boxes();
+    std::vector<size_t> overlapping;
+    boxes.find_intersecting(area, overlapping);
+
+    std::vector<Dimension> xs, ys;
+    xs.push_back(area.x);
+    xs.push_back(area_right - width);
+    ys.push_back(area.y);
+    ys.push_back(area_bottom - height);
+
+    for (std::vector<size_t>::iterator index = overlapping.begin();
+         index != overlapping.end();
+         index++) {
+        Box box = boxes.get(*index);
+
+        if (box.x + box.width + width <= area_right) xs.push_back(box.x + box.width);
+
+        if (box.y + box.height + height <= area_bottom) ys.push_back(box.y + box.height);
     }
+
+    thin_edges(xs);
+    thin_edges(ys);
+
+    // Prefer places nearer the top, and then nearer the left, among those
+    // which are equally covered
+    Dimension2D best = location;
+    bool found = false;
+    unsigned long best_covered = 0;
+
+    for (std::vector<Dimension>::iterator y = ys.begin(); y != ys.end(); y++) {
+        for (std::vector<Dimension>::iterator x = xs.begin(); x != xs.end(); x++) {
+            unsigned long covered = boxes.covered_area(Box(*x, *y, width, height));
+
+            if (!found || covered < best_covered) {
+                best = Dimension2D(*x, *y);
+                best_covered = covered;
+                found = true;
+            }
+
+            if (best_covered == 0) return best;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Gets the boxes of the visible clients, including their borders, in no
+ * particular order. They are rebuilt here only if a visible client has changed
+ * since they were last used.
+ */
+const BoxSet &ClientModel::visible_boxes() {
+    if (!m_visible_boxes_stale) return m_visible_boxes;
+
+    m_visible_boxes.clear();
+
+    Desktop *visible_desktops[] = { m_current_desktop, ALL_DESKTOPS };
+
+    for (size_t desktop = 0; desktop < 2; desktop++) {
+        client_range clients = clients_of(visible_desktops[desktop]);
+
+        for (client_iter client = clients.begin(); client != clients.end(); client++) {
+            const Dimension2D &location = m_location[*client];
+            const Dimension2D &size = m_size[*client];
+            Dimension width = DIM2D_WIDTH(size), height = DIM2D_HEIGHT(size);
+
+            #ifdef WITH_BORDERS
+            width += m_border_width * 2;
+            height += m_border_width * 2;
+            #endif
+
+            m_visible_boxes.add(Box(DIM2D_X(location), DIM2D_Y(location), width, height));
+        }
+    }
+
+    m_visible_boxes_stale = false;
+    return m_visible_boxes;
 }
 
 /**
@@ -122,6 +288,11 @@ void ClientModel::add_client(Window client, InitialState state,
             m_desktops.add_member(ICON_DESKTOP, client);
             m_changes.push(new ChangeClientDesktop(client, 0, ICON_DESKTOP));
             break;
+
+        case IS_WARM:
+            m_desktops.add_member(WARM_DESKTOP, client);
+            m_changes.push(new ChangeClientDesktop(client, 0, WARM_DESKTOP));
+            break;
     }
 
     m_layers.add_member(DEF_LAYER, client);
@@ -132,6 +303,7 @@ void ClientModel::add_client(Window client, InitialState state,
     m_location[client] = location;
     m_size[client] = size;
     m_cps_mode[client] = CPS_FLOATING;
+    m_visible_boxes_stale = true;
 
     Crt *current_screen = m_crt_manager.screen_of_coord(DIM2D_X(location), DIM2D_Y(location));
 
@@ -144,14 +316,17 @@ void ClientModel::add_client(Window client, InitialState state,
         m_screen.insert(std::pair<Window, const Box>(client, screen_box));
     }
 
-    if (autofocus) {
+    // Warm clients aren't focusable until they are revealed, which puts them
+    // into the focus cycle if they can be autofocused
+    if (state == IS_WARM) set_autofocus(client, autofocus);
+    else if (autofocus) {
         m_current_desktop->focus_cycle.add(client);
 
         set_autofocus(client, true);
         focus(client);
     } else set_autofocus(client, false);
 
-    m_children[client] = new std::set<Window>();
+    m_children[client] = WindowSet();
 }
 
 /**
@@ -183,9 +358,9 @@ void ClientModel::remove_client(Window client) {
 
     // Make sure to remove the child before removing any other parent state - the
     // child removal procedure depends upon knowing the parent's desktop
-    std::set<Window> children(*m_children[client]);
+    WindowSet children(m_children[client]);
 
-    for (std::set<Window>::iterator child = children.begin();
+    for (WindowSet::iterator child = children.begin();
          child != children.end();
          child++) {
         remove_child(*child, false);
@@ -195,13 +370,14 @@ void ClientModel::remove_client(Window client) {
     m_layers.remove_member(client);
     m_location.erase(client);
     m_size.erase(client);
+    m_visible_boxes_stale = true;
     m_cps_mode.erase(client);
     m_screen.erase(client);
     m_autofocus.erase(client);
     m_pack_corners.erase(client);
     m_pack_priority.erase(client);
+    leave_group(client);
 
-    delete m_children[client];
     m_children.erase(client);
 
     m_changes.push(new DestroyChange(client, desktop, layer));
@@ -213,8 +389,7 @@ void ClientModel::remove_client(Window client) {
 void ClientModel::remap_client(Window client) {
     if (!is_client(client)) return;
 
-    std::vector<Window> children;
-    get_children_of(client, children);
+    child_range children = children_of(client);
 
     Desktop *desktop = find_desktop(client);
 
@@ -222,7 +397,7 @@ void ClientModel::remap_client(Window client) {
         UserDesktop *user_desktop = dynamic_cast<UserDesktop *>(desktop);
         user_desktop->focus_cycle.add(client);
 
-        for (std::vector<Window>::iterator child = children.begin();
+        for (child_iter child = children.begin();
              child != children.end();
              child++) {
             user_desktop->focus_cycle.add(*child);
@@ -233,7 +408,7 @@ void ClientModel::remap_client(Window client) {
         AllDesktops *all_desktop = dynamic_cast<AllDesktops *>(ALL_DESKTOPS);
         all_desktop->focus_cycle.add(client);
 
-        for (std::vector<Window>::iterator child = children.begin();
+        for (child_iter child = children.begin();
              child != children.end();
              child++) {
             all_desktop->focus_cycle.add(*child);
@@ -255,15 +430,14 @@ void ClientModel::remap_client(Window client) {
 void ClientModel::unmap_client(Window client) {
     if (!is_client(client)) return;
 
-    std::vector<Window> children;
-    get_children_of(client, children);
+    child_range children = children_of(client);
 
     Desktop *desktop = find_desktop(client);
 
     if (desktop->is_user_desktop()) {
         UserDesktop *user_desktop = dynamic_cast<UserDesktop *>(desktop);
 
-        for (std::vector<Window>::iterator child = children.begin();
+        for (child_iter child = children.begin();
              child != children.end();
              child++) {
             user_desktop->focus_cycle.remove(*child, false);
@@ -274,7 +448,7 @@ void ClientModel::unmap_client(Window client) {
     } else if (desktop->is_all_desktop()) {
         AllDesktops *all_desktop = dynamic_cast<AllDesktops *>(ALL_DESKTOPS);
 
-        for (std::vector<Window>::iterator child = children.begin();
+        for (child_iter child = children.begin();
              child != children.end();
              child++) {
             all_desktop->focus_cycle.remove(*child, false);
@@ -295,7 +469,7 @@ void ClientModel::add_child(Window client, Window child) {
 
     if (is_child(child)) return;
 
-    m_children[client]->insert(child);
+    m_children[client].insert(child);
     m_parents[child] = client;
 
     m_changes.push(new ChildAddChange(client, child));
@@ -313,7 +487,7 @@ void ClientModel::remove_child(Window child, bool focus_parent) {
     if (!is_child(child)) return;
 
     Window parent = m_parents[child];
-    m_children[parent]->erase(child);
+    m_children[parent].erase(child);
     m_parents.erase(child);
 
     if (m_focused == child) {
@@ -331,6 +505,66 @@ void ClientModel::remove_child(Window child, bool focus_parent) {
     m_changes.push(new ChildRemoveChange(parent, child));
 }
 
+/**
+ * Puts a client into a window group, taking it out of any group it was in
+ * before.
+ * @param client The client.
+ * @param leader The group's leader, or None to leave the client ungrouped.
+ */
+void ClientModel::set_group(Window client, Window leader) {
+    if (!is_client(client) || get_group(client) == leader) return;
+
+    leave_group(client);
+
+    if (leader == None) return;
+
+    m_group_of[client] = leader;
+    m_groups[leader].insert(client);
+}
+
+/**
+ * Gets the leader of a client's window group, or None if it isn't in one.
+ */
+Window ClientModel::get_group(Window client) {
+    ModelMap<Window, Window>::iterator leader = m_group_of.find(client);
+
+    if (leader == m_group_of.end()) return None;
+
+    return leader->second;
+}
+
+/**
+ * Gets every client in the same window group as a client (including the
+ * client itself). A client which isn't in a group is its own group.
+ */
+void ClientModel::get_group_members(Window client, std::vector<Window> &members) {
+    Window leader = get_group(client);
+
+    if (leader == None) {
+        members.push_back(client);
+        return;
+    }
+
+    WindowSet &group = m_groups[leader];
+    members.insert(members.end(), group.begin(), group.end());
+}
+
+/**
+ * Takes a client out of its window group, if it is in one.
+ */
+void ClientModel::leave_group(Window client) {
+    ModelMap<Window, Window>::iterator leader = m_group_of.find(client);
+
+    if (leader == m_group_of.end()) return;
+
+    WindowSet &group = m_groups[leader->second];
+    group.erase(client);
+
+    if (group.empty()) m_groups.erase(leader->second);
+
+    m_group_of.erase(leader);
+}
+
 /**
  * Configures the client for packing.
  */
@@ -369,7 +603,7 @@ void ClientModel::repack_corner(PackCorner corner) {
     // the window from the current coordinate
     bool subtract_width_first, subtract_height_first;
 
-    const Box &screen = get_root_screen();
+    const Box &screen = get_root_work_area();
 
     switch (corner) {
         case PACK_NORTHWEST:
@@ -384,7 +618,7 @@ void ClientModel::repack_corner(PackCorner corner) {
             x_incr_sign = -1;
             subtract_width_first = true;
             subtract_height_first = false;
-            x_coord = screen.width;
+            x_coord = screen.x + screen.width;
             y_coord = screen.y;
             break;
 
@@ -392,16 +626,16 @@ void ClientModel::repack_corner(PackCorner corner) {
             x_incr_sign = 1;
             subtract_width_first = false;
             subtract_height_first = true;
-            x_coord = 0;
-            y_coord = screen.height;
+            x_coord = screen.x;
+            y_coord = screen.y + screen.height;
             break;
 
         case PACK_SOUTHEAST:
             x_incr_sign = -1;
             subtract_width_first = true;
             subtract_height_first = true;
-            x_coord = screen.width;
-            y_coord = screen.height;
+            x_coord = screen.x + screen.width;
+            y_coord = screen.y + screen.height;
             break;
     }
 
@@ -410,13 +644,14 @@ void ClientModel::repack_corner(PackCorner corner) {
     // away)
     std::vector<Window> windows_on_this_corner;
 
-    for (std::map<Window, PackCorner>::iterator iter = m_pack_corners.begin();
+    for (ModelMap<Window, PackCorner>::iterator iter = m_pack_corners.begin();
          iter != m_pack_corners.end();
          iter++) {
         if (iter->second == corner) windows_on_this_corner.push_back(iter->first);
     }
 
-    MapSorter<Window, unsigned long> sorter(m_pack_priority);
+    MapSorter<Window, unsigned long, ModelMap<Window, unsigned long> >
+        sorter(m_pack_priority);
 
     std::sort(windows_on_this_corner.begin(),
               windows_on_this_corner.end(),
@@ -514,6 +749,7 @@ void ClientModel::change_location(Window client, Dimension x, Dimension y) {
     const Box &new_desktop = m_crt_manager.box_of_screen(new_screen);
 
     m_location[client] = Dimension2D(x, y);
+    m_visible_boxes_stale = true;
     m_changes.push(new ChangeLocation(client, x, y));
 
     if (old_desktop != new_desktop) to_screen_box(client, new_desktop);
@@ -529,6 +765,31 @@ void ClientModel::change_size(Window client, Dimension width, Dimension height)
     }
 }
 
+/**
+ * Gets the most recently known location of a client.
+ */
+const Dimension2D &ClientModel::get_location(Window client) {
+    return m_location[client];
+}
+
+/**
+ * Gets the most recently known size of a client.
+ */
+const Dimension2D &ClientModel::get_size(Window client) {
+    return m_size[client];
+}
+
+/**
+ * Updates the location of a client without causing a change.
+ *
+ * Like update_size, this is for the client moving itself - note that this
+ * doesn't move the client between screens.
+ */
+void ClientModel::update_location(Window client, Dimension x, Dimension y) {
+    m_location[client] = Dimension2D(x, y);
+    m_visible_boxes_stale = true;
+}
+
 /**
  * Updates the size of a client without causing a change.
  *
@@ -536,7 +797,10 @@ void ClientModel::change_size(Window client, Dimension width, Dimension height)
  * client doing things on its own, and not because of us.
  */
 void ClientModel::update_size(Window client, Dimension width, Dimension height) {
-    if (width > 0 && height > 0) m_size[client] = Dimension2D(width, height);
+    if (width > 0 && height > 0) {
+        m_size[client] = Dimension2D(width, height);
+        m_visible_boxes_stale = true;
+    }
 }
 
 /**
@@ -770,34 +1034,104 @@ void ClientModel::client_prev_desktop(Window client) {
 }
 
 /**
- * Changes the current desktop to the desktop after the current.
+ * Moves a client onto a particular desktop.
+ * @param desktop_index The index of the desktop, starting from 0.
  */
-void ClientModel::next_desktop() {
-    unsigned long long desktop_index =
-        (m_current_desktop->desktop + 1) % m_max_desktops;
+void ClientModel::client_to_desktop(Window client, unsigned long long desktop_index) {
+    Desktop *old_desktop = m_desktops.get_category_of(client);
 
-    // We can't change while a window is being moved or resized
-    if (m_desktops.count_members_of(MOVING_DESKTOP) > 0 ||
-        m_desktops.count_members_of(RESIZING_DESKTOP) > 0) return;
+    if (!old_desktop->is_user_desktop() || desktop_index >= m_max_desktops) return;
 
-    UserDesktop *old_desktop = m_current_desktop;
+    move_to_desktop(client, USER_DESKTOPS[desktop_index], true);
+}
 
-    m_current_desktop = USER_DESKTOPS[desktop_index];
+/**
+ * Iconifies every visible client in a client's window group. Since all the
+ * changes go out in the same batch, the group costs a single restack rather
+ * than one per window.
+ */
+void ClientModel::iconify_group(Window client) {
+    std::vector<Window> members;
+    get_group_members(client, members);
+
+    for (std::vector<Window>::iterator member = members.begin();
+         member != members.end();
+         member++) {
+        iconify(*member);
+    }
+}
 
-    Window old_focus = m_focused;
+/**
+ * Sticks or unsticks every visible client in a client's window group. The
+ * whole group follows the given client, so that a group which is partly
+ * stuck ends up entirely stuck (or entirely unstuck).
+ */
+void ClientModel::toggle_stick_group(Window client) {
+    if (!is_visible(client)) return;
 
-    if (m_focused != None) {
-        if (is_child(m_focused) && !is_visible(get_parent_of(m_focused))) unfocus(false);
+    Desktop *target = ALL_DESKTOPS;
 
-        if (is_client(m_focused) && !is_visible(m_focused)) unfocus(false);
+    if (!m_desktops.get_category_of(client)->is_user_desktop()) target = m_current_desktop;
+
+    std::vector<Window> members;
+    get_group_members(client, members);
+
+    for (std::vector<Window>::iterator member = members.begin();
+         member != members.end();
+         member++) {
+        if (is_visible(*member)) move_to_desktop(*member, target, false);
     }
+}
 
-    m_changes.push(new ChangeCurrentDesktop(old_desktop, m_current_desktop));
+/**
+ * Moves a client's window group onto the desktop after the client's.
+ */
+void ClientModel::client_next_desktop_group(Window client) {
+    Desktop *old_desktop = m_desktops.get_category_of(client);
 
-    // If we can still focus the window we were focused on before, then do so
-    // Otherwise, figure out the next logical window in the focus cycle
-    if (m_focused != None && m_focused == old_focus) m_current_desktop->focus_cycle.set(m_focused);
-    else sync_focus_to_cycle();
+    if (!old_desktop->is_user_desktop()) return;
+
+    unsigned long long desktop_index = dynamic_cast<UserDesktop *>(old_desktop)->desktop;
+
+    desktop_index = (desktop_index + 1) % m_max_desktops;
+    move_group_to_desktop(client, USER_DESKTOPS[desktop_index]);
+}
+
+/**
+ * Moves a client's window group onto the desktop before the client's.
+ */
+void ClientModel::client_prev_desktop_group(Window client) {
+    Desktop *old_desktop = m_desktops.get_category_of(client);
+
+    if (!old_desktop->is_user_desktop()) return;
+
+    unsigned long long desktop_index = dynamic_cast<UserDesktop *>(old_desktop)->desktop;
+
+    desktop_index = (desktop_index - 1 + m_max_desktops) % m_max_desktops;
+    move_group_to_desktop(client, USER_DESKTOPS[desktop_index]);
+}
+
+/**
+ * Moves the members of a client's window group which are on user desktops
+ * onto another user desktop. Stuck, iconified and moving members stay put.
+ */
+void ClientModel::move_group_to_desktop(Window client, Desktop *new_desktop) {
+    std::vector<Window> members;
+    get_group_members(client, members);
+
+    for (std::vector<Window>::iterator member = members.begin();
+         member != members.end();
+         member++) {
+        if (m_desktops.get_category_of(*member)->is_user_desktop())
+            move_to_desktop(*member, new_desktop, true);
+    }
+}
+
+/**
+ * Changes the current desktop to the desktop after the current.
+ */
+void ClientModel::next_desktop() {
+    go_to_desktop((m_current_desktop->desktop + 1) % m_max_desktops);
 }
 
 /**
@@ -806,9 +1140,17 @@ void ClientModel::next_desktop() {
 void ClientModel::prev_desktop() {
     // We have to add the maximum desktops back in, since C++ doesn't
     // guarantee what will happen with a negative modulus
-    unsigned long long desktop_index =
-        (m_current_desktop->desktop - 1 + m_max_desktops)
-        % m_max_desktops;
+    go_to_desktop((m_current_desktop->desktop - 1 + m_max_desktops)
+                  % m_max_desktops);
+}
+
+/**
+ * Changes the current desktop to a particular desktop.
+ * @param desktop_index The index of the desktop, starting from 0.
+ */
+void ClientModel::go_to_desktop(unsigned long long desktop_index) {
+    if (desktop_index >= m_max_desktops || desktop_index == m_current_desktop->desktop)
+        return;
 
     // We can't change while a window is being moved or resized
     if (m_desktops.count_members_of(MOVING_DESKTOP) > 0 ||
@@ -817,6 +1159,7 @@ void ClientModel::prev_desktop() {
     UserDesktop *old_desktop = m_current_desktop;
 
     m_current_desktop = USER_DESKTOPS[desktop_index];
+    m_visible_boxes_stale = true;
 
     Window old_focus = m_focused;
 
@@ -864,6 +1207,23 @@ void ClientModel::deiconify(Window client) {
     focus(client);
 }
 
+/**
+ * Shows one of the clients which was started ahead of time, moving it onto
+ * the current desktop and focusing it.
+ *
+ * @return The revealed client, or None if there are no warm clients.
+ */
+Window ClientModel::reveal_warm_client() {
+    client_range warm = clients_of(WARM_DESKTOP);
+
+    if (warm.empty()) return None;
+
+    Window client = *warm.begin();
+    move_to_desktop(client, m_current_desktop, false);
+    focus(client);
+    return client;
+}
+
 /**
  * Starts moving a window.
  */
@@ -944,6 +1304,66 @@ const Box &ClientModel::get_screen(Window client) const {
     return m_screen.find(client)->second;
 }
 
+/**
+ * Gets the part of the root screen that isn't reserved by docks or icons.
+ */
+const Box &ClientModel::get_root_work_area() const {
+    return m_crt_manager.work_area_of_screen(m_crt_manager.root());
+}
+
+/**
+ * Gets the part of the client's screen that isn't reserved by docks or icons,
+ * which is where snapped and maximized clients go.
+ */
+const Box &ClientModel::get_work_area(Window client) const {
+    const Box &screen = get_screen(client);
+    Crt *crt = m_crt_manager.screen_of_box(screen);
+
+    if (!crt) return screen;
+
+    return m_crt_manager.work_area_of_screen(crt);
+}
+
+/**
+ * Gets the space which is reserved for icons.
+ */
+const Box &ClientModel::get_icon_row() const {
+    return m_crt_manager.icon_row();
+}
+
+/**
+ * Changes the space a dock reserves, moving any clients whose layout depends
+ * upon it.
+ */
+void ClientModel::set_strut(Window window, const Strut &strut) {
+    if (m_crt_manager.set_strut(window, strut)) relayout_work_areas();
+}
+
+/**
+ * Releases the space a dock reserves, moving any clients whose layout depends
+ * upon it.
+ */
+void ClientModel::remove_strut(Window window) {
+    if (m_crt_manager.remove_strut(window)) relayout_work_areas();
+}
+
+/**
+ * Lays out snapped, maximized and packed clients again after the work areas
+ * have changed.
+ */
+void ClientModel::relayout_work_areas() {
+    for (ModelMap<Window, ClientPosScale>::iterator mode = m_cps_mode.begin();
+         mode != m_cps_mode.end();
+         mode++) {
+        if (mode->second != CPS_FLOATING) m_changes.push(new ChangeCPSMode(mode->first, mode->second));
+    }
+
+    repack_corner(PACK_NORTHEAST);
+    repack_corner(PACK_NORTHWEST);
+    repack_corner(PACK_SOUTHEAST);
+    repack_corner(PACK_SOUTHWEST);
+}
+
 /**
  * Change the relative screen of a window to a neighboring screen.
  * Does nothing if no such neighboring screen exists.
@@ -1014,26 +1434,37 @@ void ClientModel::to_screen_crt(Window client, Crt *screen) {
 void ClientModel::update_screens(std::vector<Box> &bounds) {
     m_crt_manager.rebuild_graph(bounds);
 
-    // Now, translate the location of every client back into its updated screen
-    for (std::map<Window, Dimension2D>::iterator client_location = m_location.begin();
+    // Now, translate the location of every client back into its updated
+    // screen - the screens are found for every client at once
+    std::vector<Window> moved_clients;
+    std::vector<Dimension> xs, ys;
+
+    for (ModelMap<Window, Dimension2D>::iterator client_location = m_location.begin();
          client_location != m_location.end();
          client_location++) {
         Window client = client_location->first;
-        Dimension2D &location = client_location->second;
 
         // Although this technically *should* occur, the way that this is handled would
         // cause the client to be moved outside of our control, and we don't want that
         if (is_packed_client(client)) continue;
 
+        moved_clients.push_back(client);
+        xs.push_back(DIM2D_X(client_location->second));
+        ys.push_back(DIM2D_Y(client_location->second));
+    }
+
+    std::vector<Crt *> new_screens;
+    m_crt_manager.screens_of_coords(xs, ys, new_screens);
+
+    for (size_t index = 0; index < moved_clients.size(); index++) {
+        Window client = moved_clients[index];
+
         // Keep the old screen - if the new screen is the same, we don't want
         // to send out a change notification
         const Box &old_box = m_screen[client];
         Box new_box(-1, -1, 0, 0);
 
-        Crt *new_screen = m_crt_manager.screen_of_coord(
-            DIM2D_X(location), DIM2D_Y(location));
-
-        if (new_screen) new_box = m_crt_manager.box_of_screen(new_screen);
+        if (new_screens[index]) new_box = m_crt_manager.box_of_screen(new_screens[index]);
 
         if (new_box != old_box) {
             m_screen.erase(client);
@@ -1065,65 +1496,40 @@ void ClientModel::dump(std::ostream &output) {
 
     output << "Current Focus: " << std::hex << m_focused << "\n";
 
-    std::vector<Window> windows;
     output << "Icon Desktop\n";
-    get_clients_of(ICON_DESKTOP, windows);
-
-    for (std::vector<Window>::iterator winiter = windows.begin();
-         winiter != windows.end();
-         winiter++) {
-        dump_client_info(*winiter, output);
-    }
-
-    windows.clear();
+    dump_clients_of(ICON_DESKTOP, output);
 
     output << "Moving Desktop\n";
-    get_clients_of(MOVING_DESKTOP, windows);
-
-    for (std::vector<Window>::iterator winiter = windows.begin();
-         winiter != windows.end();
-         winiter++) {
-        dump_client_info(*winiter, output);
-    }
-
-    windows.clear();
+    dump_clients_of(MOVING_DESKTOP, output);
 
     output << "Resizing Desktop\n";
-    get_clients_of(RESIZING_DESKTOP, windows);
-
-    for (std::vector<Window>::iterator winiter = windows.begin();
-         winiter != windows.end();
-         winiter++) {
-        dump_client_info(*winiter, output);
-    }
+    dump_clients_of(RESIZING_DESKTOP, output);
 
-    windows.clear();
+    output << "Warm Desktop\n";
+    dump_clients_of(WARM_DESKTOP, output);
 
     for (int desktop = 0; desktop < USER_DESKTOPS.size(); desktop++) {
         output << "User Desktop " << desktop << "\n";
-        get_clients_of(USER_DESKTOPS[desktop], windows);
-
-        for (std::vector<Window>::iterator winiter = windows.begin();
-             winiter != windows.end();
-             winiter++) {
-            dump_client_info(*winiter, output);
-        }
-
-        windows.clear();
+        dump_clients_of(USER_DESKTOPS[desktop], output);
 
         USER_DESKTOPS[desktop]->focus_cycle.dump(output, 0);
     }
 
     output << "All Desktop\n";
-    get_clients_of(ALL_DESKTOPS, windows);
+    dump_clients_of(ALL_DESKTOPS, output);
+}
+
+/**
+ * Dumps every client on a desktop.
+ */
+void ClientModel::dump_clients_of(Desktop *desktop, std::ostream &output) {
+    client_range clients = clients_of(desktop);
 
-    for (std::vector<Window>::iterator winiter = windows.begin();
-         winiter != windows.end();
+    for (client_iter winiter = clients.begin();
+         winiter != clients.end();
          winiter++) {
         dump_client_info(*winiter, output);
     }
-
-    windows.clear();
 }
 
 /**
@@ -1137,21 +1543,22 @@ void ClientModel::move_to_desktop(Window client, Desktop *new_desktop, bool shou
     bool can_focus = m_autofocus[client];
 
     m_desktops.move_member(client, new_desktop);
+    m_visible_boxes_stale = true;
 
     if (can_focus && old_desktop->is_user_desktop()) {
         UserDesktop *user_desktop = dynamic_cast<UserDesktop *>(old_desktop);
         user_desktop->focus_cycle.remove(client, false);
 
-        for (std::set<Window>::iterator child = m_children[client]->begin();
-             child != m_children[client]->end();
+        for (WindowSet::iterator child = m_children[client].begin();
+             child != m_children[client].end();
              child++) {
             user_desktop->focus_cycle.remove(*child, false);
         }
     } else if (can_focus && old_desktop->is_all_desktop()) {
         dynamic_cast<AllDesktops *>(ALL_DESKTOPS)->focus_cycle.remove(client, false);
 
-        for (std::set<Window>::iterator child = m_children[client]->begin();
-             child != m_children[client]->end();
+        for (WindowSet::iterator child = m_children[client].begin();
+             child != m_children[client].end();
              child++) {
             dynamic_cast<AllDesktops *>(ALL_DESKTOPS)->focus_cycle.remove(*child, false);
         }
@@ -1161,16 +1568,16 @@ void ClientModel::move_to_desktop(Window client, Desktop *new_desktop, bool shou
         UserDesktop *user_desktop = dynamic_cast<UserDesktop *>(new_desktop);
         user_desktop->focus_cycle.add(client);
 
-        for (std::set<Window>::iterator child = m_children[client]->begin();
-             child != m_children[client]->end();
+        for (WindowSet::iterator child = m_children[client].begin();
+             child != m_children[client].end();
              child++) {
             user_desktop->focus_cycle.add_after(*child, client);
         }
     } else if (can_focus && new_desktop->is_all_desktop()) {
         dynamic_cast<AllDesktops *>(ALL_DESKTOPS)->focus_cycle.add(client);
 
-        for (std::set<Window>::iterator child = m_children[client]->begin();
-             child != m_children[client]->end();
+        for (WindowSet::iterator child = m_children[client].begin();
+             child != m_children[client].end();
              child++) {
             dynamic_cast<AllDesktops *>(ALL_DESKTOPS)->focus_cycle.add_after(*child, client);
         }
@@ -1242,6 +1649,10 @@ void ClientModel::dump_client_info(Window client, std::ostream &output) {
     output << "    Can autofocus? " <<
         (m_autofocus[client] ? "yes" : "no") << "\n";
 
+    Window leader = get_group(client);
+
+    if (leader != None) output << "    Group: " << std::hex << leader << std::dec << "\n";
+
     output << "    Packing info: ";
 
     if (m_pack_corners.count(client) == 0) {
@@ -1271,11 +1682,10 @@ void ClientModel::dump_client_info(Window client, std::ostream &output) {
 
     output << "\n";
 
-    std::vector<Window> children;
+    child_range children = children_of(client);
     output << "    Children\n";
-    get_children_of(client, children);
 
-    for (std::vector<Window>::iterator childiter = children.begin();
+    for (child_iter childiter = children.begin();
          childiter != children.end();
          childiter++) {
         output << "      " << std::hex << *childiter << "\n";
@@ -4,12 +4,16 @@
 
 #include "changes.hpp"
 #include "../common.hpp"
+#include "../memory.hpp"
 #include "desktop-type.hpp"
+#include "range.hpp"
 #include "screen.hpp"
 #include "unique-multimap.hpp"
 
 #include <algorithm>
+#include <cstddef>
 #include <ios>
+#include <iterator>
 #include <map>
 #include <set>
 #include <utility>
@@ -18,6 +22,7 @@
 enum InitialState {
     IS_VISIBLE,
     IS_HIDDEN,
+    IS_WARM,
 };
 
 /**
@@ -31,14 +36,109 @@ class ClientModel
 private:
 typedef Change const *change_ptr;
 
+/// Allocates the model's containers, so that their memory is accounted to it
+template <typename T>
+using ModelAllocator = CountingAllocator<T, MEM_CLIENT_MODEL>;
+
+/// A map whose memory is accounted to the model
+template <typename K, typename V>
+using ModelMap = AccountedMap<K, V, MEM_CLIENT_MODEL>;
+
+/// A set of windows whose memory is accounted to the model
+typedef AccountedSet<Window, MEM_CLIENT_MODEL> WindowSet;
+
 public:
 Desktop *ALL_DESKTOPS;
 Desktop *ICON_DESKTOP;
 Desktop *MOVING_DESKTOP;
 Desktop *RESIZING_DESKTOP;
+Desktop *WARM_DESKTOP;
 std::vector<UserDesktop *> USER_DESKTOPS;
 
-typedef UniqueMultimap<Desktop *, Window>::member_iter client_iter;
+typedef UniqueMultimap<Desktop *, Window, PointerLess<Desktop>,
+                       ModelAllocator>::member_iter client_iter;
+typedef Range<client_iter> client_range;
+
+typedef WindowSet::const_iterator child_iter;
+typedef Range<child_iter> child_range;
+
+/**
+ * Walks the visible clients from the bottom layer to the top, without
+ * sorting (or copying) anything - the clients on each layer are visited in
+ * the order they were put there.
+ */
+class LayerOrderIterator
+{
+public:
+typedef std::forward_iterator_tag iterator_category;
+typedef Window value_type;
+typedef std::ptrdiff_t difference_type;
+typedef const Window *pointer;
+typedef const Window &reference;
+
+LayerOrderIterator(ClientModel *model, Layer layer) :
+    m_model(model), m_layer(layer) {
+    if (m_layer <= MAX_LAYER) {
+        enter_layer();
+        skip_hidden();
+    }
+};
+
+reference operator*() const {
+    return *m_member;
+};
+
+LayerOrderIterator &operator++() {
+    m_member++;
+    skip_hidden();
+    return *this;
+};
+
+LayerOrderIterator operator++(int) {
+    LayerOrderIterator old = *this;
+    ++*this;
+    return old;
+};
+
+bool operator==(const LayerOrderIterator &other) const {
+    if (m_layer != other.m_layer) return false;
+
+    return m_layer > MAX_LAYER || m_member == other.m_member;
+};
+
+bool operator!=(const LayerOrderIterator &other) const {
+    return !(*this == other);
+};
+
+private:
+/// Starts walking the clients on the current layer
+void enter_layer() {
+    m_member = m_model->m_layers.get_members_of_begin(m_layer);
+    m_layer_end = m_model->m_layers.get_members_of_end(m_layer);
+};
+
+/// Moves forward until the iterator is on a visible client, or at the end
+void skip_hidden() {
+    while (m_layer <= MAX_LAYER) {
+        for (; m_member != m_layer_end; m_member++) {
+            if (m_model->is_visible(*m_member)) return;
+        }
+
+        if (++m_layer <= MAX_LAYER) enter_layer();
+    }
+};
+
+/// The model being walked
+ClientModel *m_model;
+
+/// The layer being walked, which is past MAX_LAYER at the end
+Layer m_layer;
+
+/// The current client, and the end of the current layer
+client_iter m_member, m_layer_end;
+};
+
+typedef Range<LayerOrderIterator> layer_order_range;
 
 /**
  * Initializes all of the categories in the maps
@@ -57,11 +157,13 @@ ClientModel(ChangeStream &     changes,
     ALL_DESKTOPS(new AllDesktops()),
     ICON_DESKTOP(new IconDesktop()),
     MOVING_DESKTOP(new MovingDesktop()),
-    RESIZING_DESKTOP(new ResizingDesktop()) {
+    RESIZING_DESKTOP(new ResizingDesktop()),
+    WARM_DESKTOP(new WarmDesktop()) {
     m_desktops.add_category(ALL_DESKTOPS);
     m_desktops.add_category(ICON_DESKTOP);
     m_desktops.add_category(MOVING_DESKTOP);
     m_desktops.add_category(RESIZING_DESKTOP);
+    m_desktops.add_category(WARM_DESKTOP);
 #else
 ClientModel(ChangeStream &     changes,
             CrtManager &       crt_manager,
@@ -74,11 +176,13 @@ ClientModel(ChangeStream &     changes,
     ALL_DESKTOPS(new AllDesktops()),
     ICON_DESKTOP(new IconDesktop()),
     MOVING_DESKTOP(new MovingDesktop()),
-    RESIZING_DESKTOP(new ResizingDesktop()) {
+    RESIZING_DESKTOP(new ResizingDesktop()),
+    WARM_DESKTOP(new WarmDesktop()) {
     m_desktops.add_category(ALL_DESKTOPS);
     m_desktops.add_category(ICON_DESKTOP);
     m_desktops.add_category(MOVING_DESKTOP);
     m_desktops.add_category(RESIZING_DESKTOP);
+    m_desktops.add_category(WARM_DESKTOP);
 #endif // ifdef WITH_BORDERS
 
     FocusCycle &all_cycle = dynamic_cast<AllDesktops *>(ALL_DESKTOPS)->focus_cycle;
@@ -95,6 +199,7 @@ ClientModel(ChangeStream &     changes,
     }
 
     m_current_desktop = USER_DESKTOPS[0];
+    m_visible_boxes_stale = true;
 }
 
 ~ClientModel() {
@@ -112,6 +217,13 @@ void get_visible_in_layer_order(std::vector<Window>&);
 Window get_parent_of(Window);
 void get_children_of(Window, std::vector<Window>&);
 
+client_range clients_of(Desktop *);
+size_t count_clients_of(Desktop *);
+layer_order_range visible_in_layer_order();
+child_range children_of(Window);
+
+Dimension2D find_free_space(Dimension2D, Dimension2D);
+
 void add_client(Window, InitialState, Dimension2D, Dimension2D, bool);
 void remove_client(Window);
 void remap_client(Window);
@@ -120,6 +232,10 @@ void unmap_client(Window);
 void add_child(Window, Window);
 void remove_child(Window, bool);
 
+void set_group(Window, Window);
+Window get_group(Window);
+void get_group_members(Window, std::vector<Window>&);
+
 void pack_client(Window, PackCorner, unsigned long);
 bool is_packed_client(Window);
 PackCorner get_pack_corner(Window);
@@ -131,8 +247,11 @@ void cycle_focus_backward();
 ClientPosScale get_mode(Window);
 void change_mode(Window, ClientPosScale);
 
+const Dimension2D &get_location(Window);
+const Dimension2D &get_size(Window);
 void change_location(Window, Dimension, Dimension);
 void change_size(Window, Dimension, Dimension);
+void update_location(Window, Dimension, Dimension);
 void update_size(Window, Dimension, Dimension);
 
 Window get_focused();
@@ -155,12 +274,21 @@ void toggle_stick(Window);
 void client_reset_desktop(Window);
 void client_next_desktop(Window);
 void client_prev_desktop(Window);
+void client_to_desktop(Window, unsigned long long);
+
+void iconify_group(Window);
+void toggle_stick_group(Window);
+void client_next_desktop_group(Window);
+void client_prev_desktop_group(Window);
 void next_desktop();
 void prev_desktop();
+void go_to_desktop(unsigned long long);
 
 void iconify(Window);
 void deiconify(Window);
 
+Window reveal_warm_client();
+
 void start_moving(Window);
 void stop_moving(Window, Dimension2D);
 void start_resizing(Window);
@@ -168,6 +296,11 @@ void stop_resizing(Window, Dimension2D);
 
 const Box &get_root_screen() const;
 const Box &get_screen(Window) const;
+const Box &get_root_work_area() const;
+const Box &get_work_area(Window) const;
+const Box &get_icon_row() const;
+void set_strut(Window, const Strut&);
+void remove_strut(Window);
 void to_relative_screen(Window, Direction);
 void to_screen_box(Window, Box);
 
@@ -176,16 +309,22 @@ void update_screens(std::vector<Box>&);
 void dump(std::ostream&);
 
 protected:
+void relayout_work_areas();
 void unfocus(bool);
 
 void move_to_desktop(Window, Desktop *, bool);
+void move_group_to_desktop(Window, Desktop *);
+void leave_group(Window);
 
 void to_screen_crt(Window, Crt *);
 
 void sync_focus_to_cycle();
 
+void dump_clients_of(Desktop *, std::ostream&);
 void dump_client_info(Window, std::ostream&);
 
+const BoxSet &visible_boxes();
+
 private:
 // The screen manager, used to map positions to screens
 CrtManager &m_crt_manager;
@@ -203,51 +342,69 @@ Dimension m_border_width;
 
 /// A mapping between clients and their desktops
 UniqueMultimap<Desktop *, Window,
-               PointerLess<Desktop> > m_desktops;
+               PointerLess<Desktop>, ModelAllocator> m_desktops;
 /// A mapping between clients and the layers they inhabit
-UniqueMultimap<Layer, Window> m_layers;
+UniqueMultimap<Layer, Window, std::less<Layer>, ModelAllocator> m_layers;
 /// A mapping between clients and their locations
-std::map<Window, Dimension2D> m_location;
+ModelMap<Window, Dimension2D> m_location;
 /// A mapping between clients and their sizes
-std::map<Window, Dimension2D> m_size;
+ModelMap<Window, Dimension2D> m_size;
 /// A mapping between clients and their position/scale modes
-std::map<Window, ClientPosScale> m_cps_mode;
+ModelMap<Window, ClientPosScale> m_cps_mode;
 /// A mapping between clients and their screens
-std::map<Window, const Box> m_screen;
+ModelMap<Window, const Box> m_screen;
 
 /// Which clients may be auto-focused, and which may not
-std::map<Window, bool> m_autofocus;
+ModelMap<Window, bool> m_autofocus;
 
 /** A mapping between clients that are iconified, or being moved/resized,
     and whether or not they were stuck before they were moved/resized or
     iconfied. */
-std::map<Window, bool> m_was_stuck;
+ModelMap<Window, bool> m_was_stuck;
 
 /**
  * A mapping between clients and their packing corner.
  */
-std::map<Window, PackCorner> m_pack_corners;
+ModelMap<Window, PackCorner> m_pack_corners;
 
 /**
  * A mapping between clients and their packing priorities.
  */
-std::map<Window, unsigned long> m_pack_priority;
+ModelMap<Window, unsigned long> m_pack_priority;
 
 /**
  * This maps between clients and their child windows.
  */
-std::map<Window, std::set<Window> *> m_children;
+ModelMap<Window, WindowSet> m_children;
 
 /**
  * A mapping between child windows and their parents.
  */
-std::map<Window, Window> m_parents;
+ModelMap<Window, Window> m_parents;
+
+/**
+ * A mapping between clients and the leaders of their window groups (from
+ * WM_HINTS), for the clients which are in a group.
+ */
+ModelMap<Window, Window> m_group_of;
+
+/**
+ * This maps between group leaders and the clients in their groups. Note that
+ * the leader is often a hidden window which isn't a client itself.
+ */
+ModelMap<Window, WindowSet> m_groups;
 
 /// The currently visible desktop
 UserDesktop *m_current_desktop;
 
 /// The currently focused client
 Window m_focused;
+
+/** The boxes of the visible clients, including their borders, which are
+ * rebuilt only when they are searched after a visible client has moved,
+ * resized, appeared or disappeared */
+BoxSet m_visible_boxes;
+bool m_visible_boxes_stale;
 };
 
 #endif // ifndef __SMALLWM_CLIENT_MODEL__
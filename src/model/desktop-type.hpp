@@ -17,7 +17,8 @@ const unsigned long long DESKTOP_SORT_KEY = 1,
                          ICON_DESKTOP_SORT_KEY = 3,
                          MOVING_DESKTOP_SORT_KEY = 4,
                          RESIZING_DESKTOP_SORT_KEY = 5,
-                         USER_DESKTOP_SORT_KEY = 6;
+                         WARM_DESKTOP_SORT_KEY = 6,
+                         USER_DESKTOP_SORT_KEY = 7;
 
 /**
  * This describes both 'real' desktops that the user interacts with, and
@@ -58,6 +59,10 @@ struct Desktop {
         return false;
     }
 
+    virtual bool is_warm_desktop() const {
+        return false;
+    }
+
     bool operator<(const Desktop &other) const {
         return sort_key < other.sort_key;
     }
@@ -165,12 +170,31 @@ static std::ostream &operator<<(std::ostream &out, const ResizingDesktop &deskto
     return out;
 }
 
+/**
+ * A virtual desktop for windows which were started ahead of time, and are
+ * kept hidden until they are needed.
+ */
+struct WarmDesktop : public Desktop {
+    WarmDesktop() : Desktop(WARM_DESKTOP_SORT_KEY) {
+    };
+
+    bool is_warm_desktop() const {
+        return true;
+    }
+};
+
+static std::ostream &operator<<(std::ostream &out, const WarmDesktop &desktop) {
+    out << "[Warm Desktop]";
+    return out;
+}
+
 static std::ostream &operator<<(std::ostream &out, const Desktop &desktop) {
     if (desktop.is_user_desktop()) out << dynamic_cast<const UserDesktop&>(desktop);
     else if (desktop.is_all_desktop()) out << dynamic_cast<const AllDesktops&>(desktop);
     else if (desktop.is_icon_desktop()) out << dynamic_cast<const IconDesktop&>(desktop);
     else if (desktop.is_moving_desktop()) out << dynamic_cast<const MovingDesktop&>(desktop);
     else if (desktop.is_resizing_desktop()) out << dynamic_cast<const ResizingDesktop&>(desktop);
+    else if (desktop.is_warm_desktop()) out << dynamic_cast<const WarmDesktop&>(desktop);
     else out << "[Desktop]";
 
     return out;
@@ -0,0 +1,264 @@
+/** @file */
+#include "geometry.hpp"
+
+#include <algorithm>
+
+// The searches are written in terms of a handful of operations on lanes of
+// 32-bit integers, which map onto whichever vector instructions the compiler
+// is targeting. When there are none, only the scalar loops (which also
+// handle whatever is left over after the last full group of lanes) are used.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HAVE_LANES
+
+typedef __m256i Lanes;
+static const size_t LANES = 8;
+
+static inline Lanes load(const Dimension *values) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values));
+}
+
+static inline Lanes splat(Dimension value) {
+    return _mm256_set1_epi32(value);
+}
+
+static inline Lanes greater(Lanes a, Lanes b) {
+    return _mm256_cmpgt_epi32(a, b);
+}
+
+static inline Lanes both(Lanes a, Lanes b) {
+    return _mm256_and_si256(a, b);
+}
+
+static inline Lanes but_not(Lanes a, Lanes b) {
+    return _mm256_andnot_si256(b, a);
+}
+
+static inline unsigned lane_mask(Lanes a) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(a));
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_LANES
+
+typedef __m128i Lanes;
+static const size_t LANES = 4;
+
+static inline Lanes load(const Dimension *values) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(values));
+}
+
+static inline Lanes splat(Dimension value) {
+    return _mm_set1_epi32(value);
+}
+
+static inline Lanes greater(Lanes a, Lanes b) {
+    return _mm_cmpgt_epi32(a, b);
+}
+
+static inline Lanes both(Lanes a, Lanes b) {
+    return _mm_and_si128(a, b);
+}
+
+static inline Lanes but_not(Lanes a, Lanes b) {
+    return _mm_andnot_si128(b, a);
+}
+
+static inline unsigned lane_mask(Lanes a) {
+    return _mm_movemask_ps(_mm_castsi128_ps(a));
+}
+#endif
+
+const size_t BoxSet::NOT_FOUND;
+
+/**
+ * Removes every box from the set.
+ */
+void BoxSet::clear() {
+    m_left.clear();
+    m_top.clear();
+    m_right.clear();
+    m_bottom.clear();
+}
+
+/**
+ * Adds a box to the end of the set.
+ */
+void BoxSet::add(const Box &box) {
+    m_left.push_back(box.x);
+    m_top.push_back(box.y);
+    m_right.push_back(box.x + box.width);
+    m_bottom.push_back(box.y + box.height);
+}
+
+/**
+ * Finds the first box which contains a point.
+ * @return The index of the box, or NOT_FOUND if no box contains the point.
+ */
+size_t BoxSet::find_containing(Dimension x, Dimension y) const {
+    size_t box = 0;
+
+    #ifdef HAVE_LANES
+    Lanes xs = splat(x), ys = splat(y);
+
+    for (; box + LANES <= size(); box += LANES) {
+        Lanes inside = both(greater(load(&m_right[box]), xs),
+                            greater(load(&m_bottom[box]), ys));
+        inside = but_not(inside, greater(load(&m_left[box]), xs));
+        inside = but_not(inside, greater(load(&m_top[box]), ys));
+
+        unsigned mask = lane_mask(inside);
+
+        if (mask) return box + __builtin_ctz(mask);
+    }
+    #endif
+
+    for (; box < size(); box++) {
+        if (IN_BOUNDS(x, m_left[box], m_right[box]) &&
+            IN_BOUNDS(y, m_top[box], m_bottom[box])) return box;
+    }
+
+    return NOT_FOUND;
+}
+
+/**
+ * Finds the first box containing each of a list of points. This is
+ * quicker than calling find_containing for each point when there are many
+ * more points than boxes, since each box is checked against several points
+ * at once.
+ *
+ * @param xs The horizontal coordinates of the points.
+ * @param ys The vertical coordinates of the points, in the same order.
+ * @param[out] boxes The index of the box containing each point, or NOT_FOUND.
+ */
+void BoxSet::locate_points(const std::vector<Dimension> &xs,
+                           const std::vector<Dimension> &ys,
+                           std::vector<size_t> &boxes) const {
+    size_t points = xs.size();
+    size_t unlocated = points;
+
+    boxes.assign(points, NOT_FOUND);
+
+    for (size_t box = 0; box < size() && unlocated > 0; box++) {
+        size_t point = 0;
+
+        #ifdef HAVE_LANES
+        Lanes lefts = splat(m_left[box]), tops = splat(m_top[box]),
+              rights = splat(m_right[box]), bottoms = splat(m_bottom[box]);
+
+        for (; point + LANES <= points; point += LANES) {
+            Lanes point_xs = load(&xs[point]), point_ys = load(&ys[point]);
+
+            Lanes inside = both(greater(rights, point_xs), greater(bottoms, point_ys));
+            inside = but_not(inside, greater(lefts, point_xs));
+            inside = but_not(inside, greater(tops, point_ys));
+
+            for (unsigned mask = lane_mask(inside); mask; mask &= mask - 1) {
+                size_t located = point + __builtin_ctz(mask);
+
+                if (boxes[located] == NOT_FOUND) {
+                    boxes[located] = box;
+                    unlocated--;
+                }
+            }
+        }
+        #endif
+
+        for (; point < points; point++) {
+            if (boxes[point] == NOT_FOUND &&
+                IN_BOUNDS(xs[point], m_left[box], m_right[box]) &&
+                IN_BOUNDS(ys[point], m_top[box], m_bottom[box])) {
+                boxes[point] = box;
+                unlocated--;
+            }
+        }
+    }
+}
+
+/**
+ * Calls a visitor with the index of each box which overlaps an area, in
+ * order. Boxes which only touch the edge of the area don't overlap it.
+ */
+template <typename Visitor>
+void BoxSet::each_intersecting(const Box &area, Visitor &visit) const {
+    Dimension area_right = area.x + area.width;
+    Dimension area_bottom = area.y + area.height;
+    size_t box = 0;
+
+    #ifdef HAVE_LANES
+    Lanes lefts = splat(area.x), tops = splat(area.y),
+          rights = splat(area_right), bottoms = splat(area_bottom);
+
+    for (; box + LANES <= size(); box += LANES) {
+        Lanes overlaps = both(greater(rights, load(&m_left[box])),
+                              greater(load(&m_right[box]), lefts));
+        overlaps = both(overlaps, greater(bottoms, load(&m_top[box])));
+        overlaps = both(overlaps, greater(load(&m_bottom[box]), tops));
+
+        for (unsigned mask = lane_mask(overlaps); mask; mask &= mask - 1)
+            visit(box + __builtin_ctz(mask));
+    }
+    #endif
+
+    for (; box < size(); box++) {
+        if (m_left[box] < area_right && m_right[box] > area.x &&
+            m_top[box] < area_bottom && m_bottom[box] > area.y) visit(box);
+    }
+}
+
+/// Collects the boxes that each_intersecting visits
+struct CollectBoxes {
+    CollectBoxes(std::vector<size_t> &_boxes) : boxes(_boxes) {
+    }
+
+    void operator ()(size_t box) {
+        boxes.push_back(box);
+    }
+
+    std::vector<size_t> &boxes;
+};
+
+/// Adds up how much of an area each box that each_intersecting visits covers
+struct SumCoverage {
+    SumCoverage(const Box &_area,
+                const std::vector<Dimension> &_left, const std::vector<Dimension> &_top,
+                const std::vector<Dimension> &_right, const std::vector<Dimension> &_bottom) :
+        area(_area), left(_left), top(_top), right(_right), bottom(_bottom),
+        covered(0) {
+    }
+
+    void operator ()(size_t box) {
+        Dimension width = std::min(right[box], area.x + area.width) -
+                          std::max(left[box], area.x);
+        Dimension height = std::min(bottom[box], area.y + area.height) -
+                           std::max(top[box], area.y);
+
+        covered += static_cast<unsigned long>(width) * height;
+    }
+
+    const Box &area;
+    const std::vector<Dimension> &left, &top, &right, &bottom;
+    unsigned long covered;
+};
+
+/**
+ * Finds every box which overlaps an area.
+ * @param area The area to check.
+ * @param[out] boxes The indexes of the overlapping boxes, in order, which are
+ * added to the end of the list.
+ */
+void BoxSet::find_intersecting(const Box &area, std::vector<size_t> &boxes) const {
+    CollectBoxes collect(boxes);
+    each_intersecting(area, collect);
+}
+
+/**
+ * Works out how much of an area the boxes cover. Where boxes overlap each
+ * other, the part they share is counted once for each of them, so this is 0
+ * only when the area is entirely free.
+ */
+unsigned long BoxSet::covered_area(const Box &area) const {
+    SumCoverage sum(area, m_left, m_top, m_right, m_bottom);
+    each_intersecting(area, sum);
+    return sum.covered;
+}
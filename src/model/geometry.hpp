@@ -0,0 +1,60 @@
+/** @file */
+#ifndef __SMALLWM_GEOMETRY__
+#define __SMALLWM_GEOMETRY__
+
+#include <cstddef>
+#include <vector>
+
+#include "../common.hpp"
+
+/**
+ * A list of boxes, which is searched for the boxes containing points or
+ * overlapping other boxes.
+ *
+ * The edges of the boxes are kept in separate arrays (rather than as an array
+ * of Box), so that the searches can check several boxes at once with SSE2 or
+ * AVX2, when the compiler targets them. Otherwise, the searches fall back to
+ * checking one box at a time.
+ *
+ * Boxes are identified by the order they were added in, starting at 0 - the
+ * owner of the set keeps whatever the boxes stand for in the same order.
+ */
+class BoxSet
+{
+public:
+/// What the searches return when no box matches
+static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+void clear();
+void add(const Box&);
+
+/// How many boxes are in the set
+size_t size() const {
+    return m_left.size();
+};
+
+/// Gets one of the boxes in the set
+Box get(size_t box) const {
+    return Box(m_left[box], m_top[box],
+               m_right[box] - m_left[box], m_bottom[box] - m_top[box]);
+};
+
+size_t find_containing(Dimension, Dimension) const;
+void locate_points(const std::vector<Dimension>&,
+                   const std::vector<Dimension>&,
+                   std::vector<size_t>&) const;
+void find_intersecting(const Box&, std::vector<size_t>&) const;
+unsigned long covered_area(const Box&) const;
+
+private:
+template <typename Visitor>
+void each_intersecting(const Box&, Visitor&) const;
+
+/// The left and top edges of each box, which are inside the box
+std::vector<Dimension> m_left, m_top;
+
+/// The right and bottom edges of each box, which are just outside the box
+std::vector<Dimension> m_right, m_bottom;
+};
+
+#endif // ifndef __SMALLWM_GEOMETRY__
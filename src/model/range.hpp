@@ -0,0 +1,43 @@
+/** @file */
+#ifndef __SMALLWM_RANGE__
+#define __SMALLWM_RANGE__
+
+/**
+ * A view of part of a model's storage, which is iterated in place rather than
+ * copied out.
+ *
+ * A range borrows the storage it looks at, so it is only valid until that
+ * storage changes - each function which returns a range documents what
+ * invalidates it. Don't hold onto ranges across calls which change the model.
+ */
+template <typename Iterator>
+class Range
+{
+public:
+typedef Iterator iterator;
+
+Range(Iterator begin, Iterator end) :
+    m_begin(begin), m_end(end) {
+};
+
+/// The first element of the range
+Iterator begin() const {
+    return m_begin;
+};
+
+/// One past the last element of the range
+Iterator end() const {
+    return m_end;
+};
+
+/// Whether or not there is anything in the range
+bool empty() const {
+    return m_begin == m_end;
+};
+
+private:
+/// Where the range starts and ends
+Iterator m_begin, m_end;
+};
+
+#endif // ifndef __SMALLWM_RANGE__
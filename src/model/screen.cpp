@@ -1,20 +1,46 @@
 /** @file */
+#include <algorithm>
+
 #include "screen.hpp"
 
+/**
+ * Checks whether the range [start, end) overlaps the inclusive range
+ * [strut_start, strut_end] given by a strut.
+ */
+static bool strut_overlaps(int start, int end, int strut_start, int strut_end) {
+    return strut_start < end && strut_end >= start;
+}
+
 /**
  * Finds out which screen a particular coordinate inhabits.
  */
 Crt * CrtManager::screen_of_coord(Dimension x, Dimension y) const {
-    for (std::map<Crt *, Box>::const_iterator iter = m_boxes.cbegin();
-         iter != m_boxes.cend();
-         iter++) {
-        const Box &value = iter->second;
+    size_t box = m_box_set.find_containing(x, y);
 
-        if (IN_BOUNDS(x, value.x, value.x + value.width) &&
-            IN_BOUNDS(y, value.y, value.y + value.height)) return iter->first;
-    }
+    if (box == BoxSet::NOT_FOUND) return NULL;
 
-    return NULL;
+    return m_box_set_screens[box];
+}
+
+/**
+ * Finds out which screen each of a list of coordinates inhabits, which is
+ * quicker than calling screen_of_coord for each of them.
+ * @param xs The horizontal coordinates.
+ * @param ys The vertical coordinates, in the same order.
+ * @param[out] screens The screen of each coordinate, or NULL.
+ */
+void CrtManager::screens_of_coords(const std::vector<Dimension> &xs,
+                                   const std::vector<Dimension> &ys,
+                                   std::vector<Crt *> &screens) const {
+    std::vector<size_t> boxes;
+    m_box_set.locate_points(xs, ys, boxes);
+
+    screens.resize(boxes.size());
+
+    for (size_t point = 0; point < boxes.size(); point++) {
+        if (boxes[point] == BoxSet::NOT_FOUND) screens[point] = NULL;
+        else screens[point] = m_box_set_screens[boxes[point]];
+    }
 }
 
 /**
@@ -41,6 +67,114 @@ Crt * CrtManager::screen_of_box(const Box &box) {
     return NULL;
 }
 
+/**
+ * Finds the part of a screen which windows can be laid out in, without
+ * covering docks or icons.
+ */
+const Box &CrtManager::work_area_of_screen(Crt *screen) const {
+    std::map<Crt *, Box>::const_iterator area = m_work_areas.find(screen);
+
+    if (area == m_work_areas.end()) return box_of_screen(screen);
+
+    return area->second;
+}
+
+/**
+ * Changes how much space is reserved for the icon row on the root screen.
+ */
+void CrtManager::set_icon_row_height(Dimension height) {
+    m_icon_row_height = height;
+    update_work_areas();
+}
+
+/**
+ * Changes the space reserved by a dock.
+ * @return true if the reservation changed, false otherwise.
+ */
+bool CrtManager::set_strut(Window window, const Strut &strut) {
+    if (strut.empty()) return remove_strut(window);
+
+    std::map<Window, Strut>::iterator existing = m_struts.find(window);
+
+    if (existing != m_struts.end() && existing->second == strut) return false;
+
+    m_struts[window] = strut;
+    update_work_areas();
+    return true;
+}
+
+/**
+ * Releases the space reserved by a dock.
+ * @return true if the dock had reserved any space, false otherwise.
+ */
+bool CrtManager::remove_strut(Window window) {
+    if (m_struts.erase(window) == 0) return false;
+
+    update_work_areas();
+    return true;
+}
+
+/**
+ * Recomputes the work area of every screen. Struts are given relative to the
+ * edges of the root window (which covers every screen), and only shrink the
+ * screens that they actually reach.
+ */
+void CrtManager::update_work_areas() {
+    m_work_areas.clear();
+
+    int root_right = 0, root_bottom = 0;
+
+    for (std::map<Crt *, Box>::iterator iter = m_boxes.begin();
+         iter != m_boxes.end();
+         iter++) {
+        root_right = std::max(root_right, iter->second.x + iter->second.width);
+        root_bottom = std::max(root_bottom, iter->second.y + iter->second.height);
+    }
+
+    for (std::map<Crt *, Box>::iterator iter = m_boxes.begin();
+         iter != m_boxes.end();
+         iter++) {
+        const Box &box = iter->second;
+
+        int left = box.x, right = box.x + box.width;
+        int top = box.y, bottom = box.y + box.height;
+
+        for (std::map<Window, Strut>::iterator strut_iter = m_struts.begin();
+             strut_iter != m_struts.end();
+             strut_iter++) {
+            const Strut &strut = strut_iter->second;
+
+            if (strut.left > box.x &&
+                strut_overlaps(box.y, box.y + box.height, strut.left_start_y, strut.left_end_y))
+                left = std::max(left, strut.left);
+
+            if (root_right - strut.right < box.x + box.width &&
+                strut_overlaps(box.y, box.y + box.height, strut.right_start_y, strut.right_end_y))
+                right = std::min(right, root_right - strut.right);
+
+            if (strut.top > box.y &&
+                strut_overlaps(box.x, box.x + box.width, strut.top_start_x, strut.top_end_x))
+                top = std::max(top, strut.top);
+
+            if (root_bottom - strut.bottom < box.y + box.height &&
+                strut_overlaps(box.x, box.x + box.width, strut.bottom_start_x, strut.bottom_end_x))
+                bottom = std::min(bottom, root_bottom - strut.bottom);
+        }
+
+        // The icons go along the top of whatever the docks leave of the root
+        // screen
+        if (iter->first == m_root) {
+            m_icon_row = Box(left, top, right - left, m_icon_row_height);
+            top += m_icon_row_height;
+        }
+
+        // A dock which reserves the whole screen can't be honored, since that
+        // would leave nowhere to put anything
+        if (right <= left || bottom <= top) m_work_areas[iter->first] = box;
+        else m_work_areas[iter->first] = Box(left, top, right - left, bottom - top);
+    }
+}
+
 /**
  * Rebuilds the screen graph, from a list of screen bounding boxes.
  */
@@ -63,6 +197,18 @@ void CrtManager::rebuild_graph(std::vector<Box> &screens) {
     m_boxes[m_root] = origin_to_box[Dimension2D(0, 0)];
 
     build_node(m_root, origin_to_box, 1);
+
+    m_box_set.clear();
+    m_box_set_screens.clear();
+
+    for (std::map<Crt *, Box>::iterator iter = m_boxes.begin();
+         iter != m_boxes.end();
+         iter++) {
+        m_box_set.add(iter->second);
+        m_box_set_screens.push_back(iter->first);
+    }
+
+    update_work_areas();
 }
 
 /**
@@ -81,6 +227,15 @@ void CrtManager::dump(std::ostream &output) {
 
         output << "  Screen " << std::dec << id << "\n";
         output << "    " << bounds << "\n";
+        output << "    Work area: " << work_area_of_screen(crt) << "\n";
+    }
+
+    for (std::map<Window, Strut>::iterator strut = m_struts.begin();
+         strut != m_struts.end();
+         strut++) {
+        output << "  Strut of " << std::hex << strut->first << std::dec << ": " <<
+            "left " << strut->second.left << " right " << strut->second.right <<
+            " top " << strut->second.top << " bottom " << strut->second.bottom << "\n";
     }
 }
 
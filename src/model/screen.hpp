@@ -3,6 +3,7 @@
 #define __SMALLWM_SCREEN_MODEL__
 
 #include "../common.hpp"
+#include "geometry.hpp"
 
 #include <ios>
 #include <map>
@@ -75,7 +76,7 @@ private:
  */
 class CrtManager {
 public:
-CrtManager() : m_root(NULL) {
+CrtManager() : m_root(NULL), m_icon_row_height(0) {
 }
 
 ~CrtManager() {
@@ -87,9 +88,23 @@ Crt * root() const {
 }
 
 Crt * screen_of_coord(Dimension, Dimension) const;
+void screens_of_coords(const std::vector<Dimension>&,
+                       const std::vector<Dimension>&,
+                       std::vector<Crt *>&) const;
 const Box &box_of_screen(Crt *) const;
 Crt * screen_of_box(const Box &box);
 
+const Box &work_area_of_screen(Crt *) const;
+
+/// Where the icon row goes, at the top of the root screen's work area
+const Box &icon_row() const {
+    return m_icon_row;
+}
+
+void set_icon_row_height(Dimension);
+bool set_strut(Window, const Strut&);
+bool remove_strut(Window);
+
 void rebuild_graph(std::vector<Box>&);
 
 void dump(std::ostream&);
@@ -97,12 +112,33 @@ void dump(std::ostream&);
 private:
 int build_node(Crt *, std::map<Dimension2D, Box>&, int);
 void build_id_map(Crt *, std::map<int, Crt *>&);
+void update_work_areas();
 
 /// The root screen is located at (0, 0). Guaranteed not to be NULL
 Crt *m_root;
 
 /// The bounding box of each screen
 std::map<Crt *, Box> m_boxes;
+
+/** The bounding boxes again, laid out for searching by coordinate - this is
+ * rebuilt only when the screens change */
+BoxSet m_box_set;
+
+/// The screen of each box in m_box_set, in the same order
+std::vector<Crt *> m_box_set_screens;
+
+/** The part of each screen that isn't reserved by docks or the icon row -
+ * this is recomputed only when the screens or the reservations change */
+std::map<Crt *, Box> m_work_areas;
+
+/// The space reserved by each dock
+std::map<Window, Strut> m_struts;
+
+/// How much space to reserve for icons on the root screen
+Dimension m_icon_row_height;
+
+/// Where the icon row is
+Box m_icon_row;
 };
 
 #endif // ifndef __SMALLWM_SCREEN_MODEL__
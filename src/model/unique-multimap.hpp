@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -33,11 +34,15 @@
  *    Members are unique to the UniqueMultimap - that is, no member
  *    can belong to more than one category.
  */
-template <typename category_t, typename member_t, typename category_comparator_t = std::less<category_t> >
+template <typename category_t, typename member_t,
+          typename category_comparator_t = std::less<category_t>,
+          template <typename> class allocator_t = std::allocator>
 class UniqueMultimap
 {
 public:
-typedef typename std::vector<member_t>::const_iterator member_iter;
+/// The list of members in a single category
+typedef std::vector<member_t, allocator_t<member_t> > member_list;
+typedef typename member_list::const_iterator member_iter;
 
 /**
  * Returns whether or not a category value has a category in this object.
@@ -63,7 +68,7 @@ bool add_category(category_t const &category) {
     // Avoid including duplicates
     if (is_category(category)) return false;
 
-    m_category_members[category] = new std::vector<member_t>();
+    m_category_members[category] = new member_list();
     return true;
 }
 
@@ -139,7 +144,7 @@ bool remove_member(member_t const &member) {
     if (!is_member(member)) return false;
 
     category_t const &old_category = m_member_to_category[member];
-    typename std::vector<member_t>::iterator member_location = std::find(
+    typename member_list::iterator member_location = std::find(
         m_category_members[old_category]->begin(),
         m_category_members[old_category]->end(),
         member
@@ -152,20 +157,26 @@ bool remove_member(member_t const &member) {
 
 private:
 /// The 'top-down' mapping from categories to their members
-std::map<category_t, std::vector<member_t> *, category_comparator_t> m_category_members;
+std::map<category_t, member_list *, category_comparator_t,
+         allocator_t<std::pair<const category_t, member_list *> > > m_category_members;
 /// The 'bottom-up' mapping from members to their categories
-std::map<member_t, category_t> m_member_to_category;
+std::map<member_t, category_t, std::less<member_t>,
+         allocator_t<std::pair<const member_t, category_t> > > m_member_to_category;
 };
 
 /**
  * Sorts according to the categories of values contained inside of a
  * UniqueMultimap.
  */
-template <typename category_t, typename member_t>
+template <typename category_t, typename member_t,
+          typename category_comparator_t = std::less<category_t>,
+          template <typename> class allocator_t = std::allocator>
 class UniqueMultimapSorter
 {
 public:
-UniqueMultimapSorter(UniqueMultimap<category_t, member_t> &data) :
+typedef UniqueMultimap<category_t, member_t, category_comparator_t, allocator_t> multimap_t;
+
+UniqueMultimapSorter(multimap_t &data) :
     m_uniquemultimap(data) {
 };
 
@@ -180,7 +191,7 @@ bool operator()(member_t const &a, member_t const &b) {
 }
 
 private:
-UniqueMultimap<category_t, member_t> m_uniquemultimap;
+multimap_t &m_uniquemultimap;
 };
 
 #endif // ifndef __SMALLWM_UNIQUE_MULTIMAP__
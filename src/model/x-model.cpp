@@ -1,5 +1,32 @@
 /** @file */
 #include "x-model.hpp"
+#include "../object-pool.hpp"
+
+/**
+ * Gets the pool which icons are allocated from, since one is created every
+ * time a client is iconified.
+ */
+static ObjectPool &icon_pool() {
+    static ObjectPool pool("Icon", sizeof(Icon));
+    return pool;
+}
+
+/**
+ * Allocates an icon from the icon pool, charging it to the X model's memory
+ * account.
+ */
+void *Icon::operator new(size_t size) {
+    memory_account(MEM_X_MODEL).allocated(size);
+    return icon_pool().allocate();
+}
+
+/**
+ * Frees an icon, crediting the X model's memory account.
+ */
+void Icon::operator delete(void *memory, size_t size) {
+    memory_account(MEM_X_MODEL).freed(size);
+    icon_pool().release(memory);
+}
 
 /**
  * Registers a new icon - note that, at this point, XModel takes
@@ -44,13 +71,22 @@ Icon * XModel::find_icon_from_icon_window(Window icon_win) const {
  * Gets a list of all of the icons.
  */
 void XModel::get_icons(std::vector<Icon *> &icons) {
-    for (std::map<Window, Icon *>::iterator iter = m_clients_to_icons.begin();
+    for (XModelMap<Window, Icon *>::iterator iter = m_clients_to_icons.begin();
          iter != m_clients_to_icons.end();
          iter++) {
         if (iter->second != 0) icons.push_back(iter->second);
     }
 }
 
+/**
+ * Gets a view of all of the icons. This is invalidated when any icon is
+ * registered or unregistered.
+ */
+XModel::icon_range XModel::icons() const {
+    return icon_range(IconIterator(m_clients_to_icons.begin(), m_clients_to_icons.end()),
+                      IconIterator(m_clients_to_icons.end(), m_clients_to_icons.end()));
+}
+
 /**
  * Registers that a client is being moved, recording the client and the
  * placeholder, and recording the current pointer location.
@@ -170,3 +206,77 @@ void XModel::clear_effect(Window client, ClientEffect effect) {
 void XModel::remove_all_effects(Window client) {
     m_effects.erase(client);
 }
+
+/**
+ * Records the process which owns a client.
+ */
+void XModel::set_pid(Window client, unsigned long pid) {
+    m_pids[client] = pid;
+}
+
+/**
+ * Gets the process which owns a client.
+ * @return The process ID, or 0 if the client didn't give one.
+ */
+unsigned long XModel::find_pid(Window client) const {
+    XModelMap<Window, unsigned long>::const_iterator pid = m_pids.find(client);
+
+    if (pid == m_pids.end()) return 0;
+
+    return pid->second;
+}
+
+/**
+ * Forgets about the process which owns a client, and whether it may be frozen.
+ */
+void XModel::forget_pid(Window client) {
+    m_pids.erase(client);
+    m_freezable.erase(client);
+}
+
+/**
+ * Notes that the process of a client may be frozen while it is hidden.
+ */
+void XModel::set_freezable(Window client) {
+    m_freezable.insert(client);
+}
+
+/**
+ * Checks whether the process of a client may be frozen while it is hidden.
+ */
+bool XModel::is_freezable(Window client) const {
+    return m_freezable.count(client) > 0;
+}
+
+#ifdef WITH_THUMBNAILS
+/**
+ * Starts keeping a thumbnail for a client.
+ * @param client The client to keep the thumbnail of.
+ * @return The (empty) thumbnail.
+ */
+Thumbnail & XModel::track_thumbnail(Window client) {
+    return m_thumbnails[client];
+}
+
+/**
+ * Gets the thumbnail of a client.
+ * @param client The client to get the thumbnail of.
+ * @return The thumbnail, or NULL if the client doesn't have one.
+ */
+Thumbnail * XModel::find_thumbnail(Window client) {
+    XModelMap<Window, Thumbnail>::iterator thumbnail = m_thumbnails.find(client);
+
+    if (thumbnail == m_thumbnails.end()) return NULL;
+
+    return &thumbnail->second;
+}
+
+/**
+ * Stops keeping a thumbnail for a client. Note that the thumbnail's pixmap
+ * has to be freed beforehand.
+ * @param client The client to forget about.
+ */
+void XModel::forget_thumbnail(Window client) {
+    m_thumbnails.erase(client);
+}
+#endif
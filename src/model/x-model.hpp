@@ -1,10 +1,14 @@
 /** @file */
 #ifndef __SMALLWM_X_MODEL__
 #define __SMALLWM_X_MODEL__
+#include <cstddef>
+#include <iterator>
 #include <map>
 #include <vector>
 
 #include "../common.hpp"
+#include "../memory.hpp"
+#include "range.hpp"
 #include "../xdata.hpp"
 
 /**
@@ -15,6 +19,9 @@ struct Icon {
         client(_client), icon(_icon), gc(_gc) {
     };
 
+    static void *operator new(size_t);
+    static void operator delete(void *, size_t);
+
     /// The window that the icon "stands for"
     Window client;
 
@@ -25,6 +32,33 @@ struct Icon {
     XGC *gc;
 };
 
+#ifdef WITH_THUMBNAILS
+/**
+ * A scaled-down capture of a client's contents, which is shown in its icon.
+ */
+struct Thumbnail {
+    Thumbnail() :
+        damage(None), pixmap(None), width(0), height(0), stale(true),
+        captured_at(0) {
+    };
+
+    /// Tracks changes to the client's contents
+    Damage damage;
+
+    /// The captured contents, or None if the client hasn't been captured
+    Pixmap pixmap;
+
+    /// The size of the captured contents
+    Dimension width, height;
+
+    /// Whether or not the client has changed since it was captured
+    bool stale;
+
+    /// When the client was captured, in microseconds
+    unsigned long long captured_at;
+};
+#endif
+
 /**
  * The state of the client which is currently being moved or resized.
  */
@@ -68,7 +102,68 @@ enum ClientEffect {
  */
 class XModel
 {
+private:
+/// A map whose memory is accounted to the model
+template <typename K, typename V>
+using XModelMap = AccountedMap<K, V, MEM_X_MODEL>;
+
+public:
+/**
+ * Walks the registered icons in place, in the order of the clients they
+ * stand for.
+ */
+class IconIterator
+{
 public:
+typedef std::forward_iterator_tag iterator_category;
+typedef Icon *value_type;
+typedef std::ptrdiff_t difference_type;
+typedef Icon * const *pointer;
+typedef Icon * const &reference;
+
+typedef XModelMap<Window, Icon *>::const_iterator map_iter;
+
+IconIterator(map_iter position, map_iter end) :
+    m_position(position), m_end(end) {
+    skip_empty();
+};
+
+reference operator*() const {
+    return m_position->second;
+};
+
+IconIterator &operator++() {
+    m_position++;
+    skip_empty();
+    return *this;
+};
+
+IconIterator operator++(int) {
+    IconIterator old = *this;
+    ++*this;
+    return old;
+};
+
+bool operator==(const IconIterator &other) const {
+    return m_position == other.m_position;
+};
+
+bool operator!=(const IconIterator &other) const {
+    return m_position != other.m_position;
+};
+
+private:
+/// Moves forward past any clients without an icon
+void skip_empty() {
+    while (m_position != m_end && m_position->second == NULL) m_position++;
+};
+
+/// The current icon, and the end of the icons
+map_iter m_position, m_end;
+};
+
+typedef Range<IconIterator> icon_range;
+
 XModel() : m_moveresize(0) {
 };
 
@@ -78,6 +173,7 @@ void unregister_icon(Icon *);
 Icon * find_icon_from_client(Window) const;
 Icon * find_icon_from_icon_window(Window) const;
 void get_icons(std::vector<Icon *>&);
+icon_range icons() const;
 
 void enter_move(Window, Window, Dimension2D);
 void enter_resize(Window, Window, Dimension2D);
@@ -95,15 +191,39 @@ void set_effect(Window, ClientEffect);
 void clear_effect(Window, ClientEffect);
 void remove_all_effects(Window);
 
+void set_pid(Window, unsigned long);
+unsigned long find_pid(Window) const;
+void forget_pid(Window);
+
+void set_freezable(Window);
+bool is_freezable(Window) const;
+
+#ifdef WITH_THUMBNAILS
+Thumbnail & track_thumbnail(Window);
+Thumbnail * find_thumbnail(Window);
+void forget_thumbnail(Window);
+#endif
+
 private:
 /// A mapping between clients and their icons
-std::map<Window, Icon *> m_clients_to_icons;
+XModelMap<Window, Icon *> m_clients_to_icons;
 
 /// A mapping between icon windows and the icon structures
-std::map<Window, Icon *> m_icon_windows_to_icons;
+XModelMap<Window, Icon *> m_icon_windows_to_icons;
 
 /// The effects present on each window
-std::map<Window, ClientEffect> m_effects;
+XModelMap<Window, ClientEffect> m_effects;
+
+/// The process which owns each client, for clients which say (by _NET_WM_PID)
+XModelMap<Window, unsigned long> m_pids;
+
+/// The clients whose processes may be frozen while they are hidden
+AccountedSet<Window, MEM_X_MODEL> m_freezable;
+
+#ifdef WITH_THUMBNAILS
+/// The thumbnails of each client
+XModelMap<Window, Thumbnail> m_thumbnails;
+#endif
 
 /// The current data about moving or resizing
 MoveResize *m_moveresize;
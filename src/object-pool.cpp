@@ -0,0 +1,143 @@
+/** @file */
+#include <new>
+#include <sstream>
+
+#include "object-pool.hpp"
+
+/**
+ * Gets every pool which has been created, so that they can be dumped.
+ */
+static std::vector<const ObjectPool *> &all_pools() {
+    // This is a function-local static, so that it exists before any static
+    // pool registers itself
+    static std::vector<const ObjectPool *> pools;
+    return pools;
+}
+
+/**
+ * Creates an empty pool - nothing is allocated until the first block is
+ * requested.
+ * @param name What the blocks are used for.
+ * @param block_size The size of each block.
+ * @param chunk_blocks How many blocks to allocate at once.
+ */
+ObjectPool::ObjectPool(const std::string &name, size_t block_size,
+                       size_t chunk_blocks) :
+    m_name(name), m_chunk_blocks(chunk_blocks), m_free(NULL), m_live(0),
+    m_allocations(0), m_reused(0) {
+    // Every block has to be able to hold a free list link, and has to be
+    // aligned well enough for anything that is put in it
+    const size_t alignment = alignof(std::max_align_t);
+
+    if (block_size < sizeof(FreeBlock)) block_size = sizeof(FreeBlock);
+
+    m_block_size = (block_size + alignment - 1) / alignment * alignment;
+
+    all_pools().push_back(this);
+}
+
+/**
+ * Hands out a block, reusing a freed one if there is any.
+ */
+void *ObjectPool::allocate() {
+    if (m_free) m_reused++;
+    else grow();
+
+    FreeBlock *block = m_free;
+    m_free = block->next;
+
+    m_live++;
+    m_allocations++;
+    return block;
+}
+
+/**
+ * Puts a block back onto the free list.
+ */
+void ObjectPool::release(void *memory) {
+    if (!memory) return;
+
+    FreeBlock *block = static_cast<FreeBlock *>(memory);
+    block->next = m_free;
+    m_free = block;
+
+    m_live--;
+}
+
+/**
+ * Allocates a new chunk, and puts all of its blocks onto the free list.
+ */
+void ObjectPool::grow() {
+    char *chunk = static_cast<char *>(::operator new(m_block_size * m_chunk_blocks));
+    m_chunks.push_back(chunk);
+
+    // Link them backwards, so that the first block is handed out first
+    for (size_t block = m_chunk_blocks; block > 0; block--) {
+        FreeBlock *free_block = reinterpret_cast<FreeBlock *>(chunk + (block - 1) * m_block_size);
+        free_block->next = m_free;
+        m_free = free_block;
+    }
+}
+
+/**
+ * Writes out the counters of a single pool.
+ */
+void ObjectPool::dump(std::ostream &output) const {
+    output << "  " << m_name << ": " << std::dec <<
+        "live " << m_live << " allocations " << m_allocations <<
+        " reused " << m_reused << " chunks " << m_chunks.size() << "\n";
+}
+
+/**
+ * Creates a pool for every size class up to the given size.
+ * @param name What the objects are, which is shown in dumps along with the
+ * size of each class.
+ * @param largest The size of the largest object that will be pooled.
+ */
+SizedPools::SizedPools(const std::string &name, size_t largest) {
+    for (size_t size = SIZE_CLASS_STEP; size < largest + SIZE_CLASS_STEP;
+         size += SIZE_CLASS_STEP) {
+        std::ostringstream pool_name;
+        pool_name << name << " (" << size << " bytes)";
+
+        m_pools.push_back(new ObjectPool(pool_name.str(), size));
+    }
+}
+
+/**
+ * Hands out a block which is at least the given size.
+ */
+void *SizedPools::allocate(size_t size) {
+    size_t size_class = (size + SIZE_CLASS_STEP - 1) / SIZE_CLASS_STEP;
+
+    if (size_class == 0 || size_class > m_pools.size()) return ::operator new(size);
+
+    return m_pools[size_class - 1]->allocate();
+}
+
+/**
+ * Returns a block handed out by allocate() - the size must be the same as was
+ * given to allocate().
+ */
+void SizedPools::release(void *memory, size_t size) {
+    size_t size_class = (size + SIZE_CLASS_STEP - 1) / SIZE_CLASS_STEP;
+
+    if (size_class == 0 || size_class > m_pools.size()) ::operator delete(memory);
+    else m_pools[size_class - 1]->release(memory);
+}
+
+/**
+ * Converts the counters of every pool to a textual representation, which is
+ * written to the output stream.
+ */
+void dump_pools(std::ostream &output) {
+    output << "Pools\n";
+
+    std::vector<const ObjectPool *> &pools = all_pools();
+
+    for (std::vector<const ObjectPool *>::iterator pool = pools.begin();
+         pool != pools.end();
+         pool++) {
+        (*pool)->dump(output);
+    }
+}
@@ -0,0 +1,97 @@
+/** @file */
+#ifndef __SMALLWM_OBJECT_POOL__
+#define __SMALLWM_OBJECT_POOL__
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * A pool of fixed-size blocks, for objects which are created and destroyed
+ * once per window (or more often) - icons, graphics contexts, changes and the
+ * like.
+ *
+ * Freed blocks go onto a free list and are handed out again before anything
+ * new is carved out, and new blocks are carved out of chunks holding several
+ * of them at once. Chunks are kept for the life of the process, so that
+ * opening and closing windows doesn't go back to the general allocator once
+ * the pool has grown to the size of the session.
+ *
+ * Pools aren't thread safe - every pooled object is created and destroyed on
+ * the main thread.
+ */
+class ObjectPool
+{
+public:
+ObjectPool(const std::string&, size_t, size_t chunk_blocks = 32);
+
+void *allocate();
+void release(void *);
+
+/// The size of the blocks in this pool
+size_t block_size() const {
+    return m_block_size;
+};
+
+void dump(std::ostream&) const;
+
+private:
+/// A free block, which holds the link to the next free block
+struct FreeBlock {
+    FreeBlock *next;
+};
+
+void grow();
+
+/// What the blocks are used for, which is shown in dumps
+std::string m_name;
+
+/// The size of each block, which is large enough to hold a FreeBlock
+size_t m_block_size;
+
+/// How many blocks are carved out of each chunk
+size_t m_chunk_blocks;
+
+/// The blocks which are ready to be handed out
+FreeBlock *m_free;
+
+/// Every chunk which has been allocated
+std::vector<char *> m_chunks;
+
+/// How many blocks are handed out now
+unsigned long m_live;
+
+/// How many blocks have been handed out in total
+unsigned long m_allocations;
+
+/// How many of those blocks came off the free list
+unsigned long m_reused;
+};
+
+/**
+ * A group of pools for objects of different sizes - this is used for class
+ * hierarchies, where operator new is asked for the size of whichever subclass
+ * is being created. Sizes are rounded up to the next multiple of
+ * SIZE_CLASS_STEP, and anything larger than the largest class goes to the
+ * general allocator.
+ */
+class SizedPools
+{
+public:
+SizedPools(const std::string&, size_t);
+
+void *allocate(size_t);
+void release(void *, size_t);
+
+private:
+/// The difference in size between one pool and the next
+static const size_t SIZE_CLASS_STEP = 16;
+
+/// The pools, with the smallest blocks first (these live as long as the process)
+std::vector<ObjectPool *> m_pools;
+};
+
+void dump_pools(std::ostream&);
+
+#endif // ifndef __SMALLWM_OBJECT_POOL__
@@ -0,0 +1,435 @@
+/** @file */
+#include <climits>
+
+#include "property-fetcher.hpp"
+#include "utils.hpp"
+
+/// The most of _NET_WM_ICON that will be read, in 32-bit units
+static const long MAX_ICON_LENGTH = 1 << 22;
+
+/**
+ * Converts an 8-bit color channel into the bits of a pixel given by a
+ * TrueColor visual's mask for that channel.
+ * @param value The channel's value, from 0 to 255.
+ * @param mask The visual's mask for the channel.
+ * @return The channel, positioned within the pixel.
+ */
+static unsigned long channel_to_pixel(unsigned long value, unsigned long mask) {
+    if (mask == 0) return 0;
+
+    int shift = 0;
+
+    while (!(mask & (1UL << shift))) shift++;
+
+    int bits = 0;
+
+    while (bits + shift < (int)(sizeof(mask) * CHAR_BIT) &&
+           mask & (1UL << (bits + shift))) bits++;
+
+    if (bits < 8) value >>= 8 - bits;
+    else value <<= bits - 8;
+
+    return (value << shift) & mask;
+}
+
+/**
+ * Stops the background thread, and closes the background connection (which
+ * frees any icons that were decoded).
+ */
+PropertyFetcher::~PropertyFetcher() {
+    if (!m_display) return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stopping = true;
+    }
+
+    m_wakeup.notify_all();
+    m_thread.join();
+
+    XFreeGC(m_display, m_gc);
+    XCloseDisplay(m_display);
+}
+
+/**
+ * Opens the background connection and starts the background thread.
+ * @return true if the background connection could be opened, false
+ *         otherwise (in which case properties should be read directly).
+ */
+bool PropertyFetcher::start() {
+    m_display = XOpenDisplay(NULL);
+
+    if (!m_display) {
+        m_logger.log(LOG_WARNING) <<
+            "Could not open a second X connection - window properties "
+            "will be fetched on the main connection" << Log::endl;
+        return false;
+    }
+
+    m_net_wm_icon = XInternAtom(m_display, "_NET_WM_ICON", false);
+    m_gc = XCreateGC(m_display, DefaultRootWindow(m_display), 0, NULL);
+
+    m_thread = std::thread(&PropertyFetcher::thread_main, this);
+    return true;
+}
+
+/**
+ * Asks for some of a window's properties to be fetched. This is coalesced
+ * with any other requests for the window that haven't been started yet.
+ * @param window The window to fetch the properties of.
+ * @param flags Which properties to fetch (see PropertyFlags).
+ */
+void PropertyFetcher::request(Window window, unsigned int flags) {
+    if (!m_display) return;
+
+    m_tracked.insert(window);
+
+    if (!m_fetch_icons) flags &= ~PROP_ICON;
+
+    if (flags == 0) return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        PendingFetch &pending = m_requests[window];
+
+        if (pending.flags == 0) pending.since = monotonic_usec();
+
+        pending.flags |= flags;
+    }
+
+    m_wakeup.notify_one();
+}
+
+/**
+ * Drops everything known about a window, along with any requests for it
+ * which haven't been started. This should be called when the window is
+ * destroyed.
+ * @param window The window to forget.
+ */
+void PropertyFetcher::forget(Window window) {
+    if (!m_display) return;
+
+    m_tracked.erase(window);
+
+    std::map<Window, WindowProperties>::iterator cached = m_cache.find(window);
+
+    if (cached != m_cache.end()) {
+        if (cached->second.net_icon.pixmap != None) free_pixmap(cached->second.net_icon.pixmap);
+
+        m_cache.erase(cached);
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_requests.erase(window);
+}
+
+/**
+ * Gets the cached properties of a window.
+ * @param window The window to get the properties of.
+ * @return The properties, or NULL if they haven't been fetched yet.
+ */
+const WindowProperties * PropertyFetcher::find(Window window) const {
+    std::map<Window, WindowProperties>::const_iterator cached = m_cache.find(window);
+
+    if (cached == m_cache.end()) return NULL;
+
+    return &cached->second;
+}
+
+/**
+ * Figures out what has to be fetched when a property changes.
+ * @param atom The atom from a PropertyNotify event.
+ * @return The properties to fetch (see PropertyFlags), or 0 if the property
+ *         isn't one that is cached.
+ */
+unsigned int PropertyFetcher::flags_for_atom(Atom atom) const {
+    if (atom == XA_WM_NAME || atom == XA_WM_ICON_NAME) return PROP_NAME;
+
+    if (atom == XA_WM_HINTS) return PROP_HINTS;
+
+    if (m_fetch_icons && atom != None && atom == m_net_wm_icon) return PROP_ICON;
+
+    return 0;
+}
+
+/**
+ * Fetches properties until the fetcher is destroyed.
+ */
+void PropertyFetcher::thread_main() {
+    std::map<Window, PendingFetch> requests;
+    std::vector<Pixmap> unused_pixmaps;
+    std::vector<FetchTask *> finished;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+
+            while (!m_stopping && m_requests.empty() && m_unused_pixmaps.empty()) m_wakeup.wait(guard);
+
+            if (m_stopping) return;
+
+            requests.swap(m_requests);
+            unused_pixmaps.swap(m_unused_pixmaps);
+        }
+
+        for (std::vector<Pixmap>::iterator pixmap = unused_pixmaps.begin();
+             pixmap != unused_pixmaps.end();
+             pixmap++) {
+            XFreePixmap(m_display, *pixmap);
+        }
+
+        for (std::map<Window, PendingFetch>::iterator pending = requests.begin();
+             pending != requests.end();
+             pending++) {
+            FetchTask *task = new FetchTask(*this, pending->first,
+                                            pending->second.flags);
+            task->queued_at = pending->second.since;
+            task->started_at = monotonic_usec();
+            task->run();
+            finished.push_back(task);
+        }
+
+        // Requests on different connections aren't ordered with respect to
+        // each other, so any icons that were uploaded have to reach the
+        // server before the X thread tries to draw them
+        XSync(m_display, false);
+
+        for (std::vector<FetchTask *>::iterator task = finished.begin();
+             task != finished.end();
+             task++) {
+            m_completed.push(*task);
+        }
+
+        requests.clear();
+        unused_pixmaps.clear();
+        finished.clear();
+    }
+}
+
+/**
+ * Fetches properties on the background thread. If the window has been
+ * destroyed, this fails quietly and leaves the properties empty.
+ * @param window The window to fetch the properties of.
+ * @param flags Which properties to fetch.
+ * @param[out] properties Where to store the properties.
+ */
+void PropertyFetcher::fetch(Window window, unsigned int flags,
+                            WindowProperties &properties) {
+    if (flags & PROP_NAME) {
+        char *name = NULL;
+
+        XGetIconName(m_display, window, &name);
+
+        if (!name) XFetchName(m_display, window, &name);
+
+        if (name) {
+            properties.icon_name.assign(name);
+            XFree(name);
+        }
+    }
+
+    if (flags & PROP_HINTS) {
+        XWMHints *hints = XGetWMHints(m_display, window);
+
+        if (hints) {
+            properties.has_hints = true;
+            std::memcpy(&properties.hints, hints, sizeof(XWMHints));
+            XFree(hints);
+        }
+
+        // Getting the size now means that drawing the icon doesn't need a
+        // round trip. Pixmaps that can't be copied directly onto an icon
+        // (like 1-bit bitmaps) are left out.
+        if (properties.has_hints && properties.hints.flags & IconPixmapHint) {
+            Window _u1;
+            int _u2;
+            unsigned int _u3;
+            unsigned int width, height, depth;
+
+            if (XGetGeometry(m_display, properties.hints.icon_pixmap, &_u1,
+                             &_u2, &_u2, &width, &height, &_u3, &depth) &&
+                (int)depth == DefaultDepth(m_display, DefaultScreen(m_display))) {
+                properties.hint_icon.pixmap = properties.hints.icon_pixmap;
+                properties.hint_icon.width = width;
+                properties.hint_icon.height = height;
+            }
+        }
+    }
+
+    if (flags & PROP_ICON) fetch_net_icon(window, properties.net_icon);
+}
+
+/**
+ * Reads a window's _NET_WM_ICON, picks the most appropriately sized image,
+ * and uploads it as a pixmap.
+ * @param window The window to get the icon of.
+ * @param[out] icon Where to store the uploaded icon.
+ */
+void PropertyFetcher::fetch_net_icon(Window window, IconImage &icon) {
+    Atom type;
+    int format;
+    unsigned long length, _u1;
+    unsigned char *data = NULL;
+
+    if (XGetWindowProperty(m_display, window, m_net_wm_icon, 0,
+                           MAX_ICON_LENGTH, false, XA_CARDINAL, &type,
+                           &format, &length, &_u1, &data) != Success) return;
+
+    if (!data) return;
+
+    if (type != XA_CARDINAL || format != 32) {
+        XFree(data);
+        return;
+    }
+
+    // The property is a list of (width, height, pixels...) images. Use the
+    // smallest image that is at least as tall as an icon, or failing that,
+    // the largest image.
+    const unsigned long *images = reinterpret_cast<unsigned long *>(data);
+    const unsigned long *best = NULL;
+    unsigned long offset = 0;
+
+    while (offset + 2 <= length) {
+        unsigned long width = images[offset];
+        unsigned long height = images[offset + 1];
+
+        if (width == 0 || height == 0 ||
+            width > (length - offset - 2) / height) break;
+
+        const unsigned long *image = &images[offset];
+
+        if (!best) best = image;
+        else {
+            bool best_fits = best[1] >= (unsigned long)m_icon_height;
+            bool image_fits = height >= (unsigned long)m_icon_height;
+
+            if ((image_fits && (!best_fits || height < best[1])) ||
+                (!image_fits && !best_fits && height > best[1])) best = image;
+        }
+
+        offset += 2 + width * height;
+    }
+
+    if (best) {
+        Dimension height = m_icon_height;
+        Dimension width = (best[0] * height) / best[1];
+
+        if (width < 1) width = 1;
+
+        icon.pixmap = create_icon_pixmap(best + 2, best[0], best[1],
+                                         width, height);
+
+        if (icon.pixmap != None) {
+            icon.width = width;
+            icon.height = height;
+        }
+    }
+
+    XFree(data);
+}
+
+/**
+ * Scales an ARGB image, blends it over the icon background, and uploads it
+ * as a pixmap.
+ * @param pixels The ARGB pixels, one per unsigned long.
+ * @param src_width The width of the ARGB image.
+ * @param src_height The height of the ARGB image.
+ * @param width The width of the pixmap.
+ * @param height The height of the pixmap.
+ * @return The pixmap, or None if the image couldn't be converted.
+ */
+Pixmap PropertyFetcher::create_icon_pixmap(const unsigned long *pixels,
+                                           unsigned long src_width,
+                                           unsigned long src_height,
+                                           Dimension width, Dimension height) {
+    int screen = DefaultScreen(m_display);
+    Visual *visual = DefaultVisual(m_display, screen);
+    int depth = DefaultDepth(m_display, screen);
+
+    // Palette-based visuals would need colors allocated for every pixel,
+    // which isn't worth it for an icon
+    if (visual->c_class != TrueColor) return None;
+
+    XImage *image = XCreateImage(m_display, visual, depth, ZPixmap, 0, NULL,
+                                 width, height, 32, 0);
+
+    if (!image) return None;
+
+    image->data = static_cast<char *>(std::malloc(image->bytes_per_line * height));
+
+    if (!image->data) {
+        XDestroyImage(image);
+        return None;
+    }
+
+    for (Dimension y = 0; y < height; y++) {
+        const unsigned long *row = pixels + (y * src_height / height) * src_width;
+
+        for (Dimension x = 0; x < width; x++) {
+            unsigned long argb = row[x * src_width / width];
+            unsigned long alpha = (argb >> 24) & 0xff;
+
+            // Icon windows have a white background, so blend against that
+            unsigned long red = (((argb >> 16) & 0xff) * alpha + 0xff * (0xff - alpha)) / 0xff;
+            unsigned long green = (((argb >> 8) & 0xff) * alpha + 0xff * (0xff - alpha)) / 0xff;
+            unsigned long blue = ((argb & 0xff) * alpha + 0xff * (0xff - alpha)) / 0xff;
+
+            XPutPixel(image, x, y,
+                      channel_to_pixel(red, visual->red_mask) |
+                      channel_to_pixel(green, visual->green_mask) |
+                      channel_to_pixel(blue, visual->blue_mask));
+        }
+    }
+
+    Pixmap pixmap = XCreatePixmap(m_display, DefaultRootWindow(m_display),
+                                  width, height, depth);
+    XPutImage(m_display, pixmap, m_gc, image, 0, 0, 0, 0, width, height);
+    XDestroyImage(image);
+
+    return pixmap;
+}
+
+/**
+ * Stores the result of a fetch in the cache, on the X thread.
+ * @param task The finished fetch.
+ */
+void PropertyFetcher::store(FetchTask &task) {
+    // The window may have been destroyed while it was being fetched
+    if (!m_tracked.count(task.window)) {
+        if (task.properties.net_icon.pixmap != None) free_pixmap(task.properties.net_icon.pixmap);
+
+        return;
+    }
+
+    WindowProperties &cached = m_cache[task.window];
+
+    if (task.flags & PROP_NAME) cached.icon_name = task.properties.icon_name;
+
+    if (task.flags & PROP_HINTS) {
+        cached.has_hints = task.properties.has_hints;
+        cached.hints = task.properties.hints;
+        cached.hint_icon = task.properties.hint_icon;
+    }
+
+    if (task.flags & PROP_ICON) {
+        if (cached.net_icon.pixmap != None) free_pixmap(cached.net_icon.pixmap);
+
+        cached.net_icon = task.properties.net_icon;
+    }
+
+    if (m_listener) m_listener->properties_changed(task.window);
+}
+
+/**
+ * Hands a decoded icon back to the background thread to be freed, since it
+ * was created on the background connection.
+ * @param pixmap The pixmap to free.
+ */
+void PropertyFetcher::free_pixmap(Pixmap pixmap) {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_unused_pixmaps.push_back(pixmap);
+    }
+
+    m_wakeup.notify_one();
+}
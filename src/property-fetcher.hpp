@@ -0,0 +1,242 @@
+/** @file */
+#ifndef __SMALLWM_PROPERTY_FETCHER__
+#define __SMALLWM_PROPERTY_FETCHER__
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+#include "logging/logging.hpp"
+#include "worker-pool.hpp"
+
+/**
+ * Which groups of properties to fetch for a window.
+ */
+enum PropertyFlags {
+    /// WM_ICON_NAME and WM_NAME
+    PROP_NAME  = 1 << 0,
+    /// WM_HINTS, along with the size of the icon pixmap it names
+    PROP_HINTS = 1 << 1,
+    /// _NET_WM_ICON, which is decoded into a pixmap
+    PROP_ICON  = 1 << 2,
+    PROP_ALL   = PROP_NAME | PROP_HINTS | PROP_ICON
+};
+
+/**
+ * A pixmap which can be drawn onto an icon, along with its size (so that
+ * drawing it doesn't require asking the X server).
+ */
+struct IconImage {
+    IconImage() :
+        pixmap(None), width(0), height(0) {
+    };
+
+    /// The pixmap, or None if there isn't one
+    Pixmap pixmap;
+
+    /// The size of the pixmap
+    Dimension width, height;
+};
+
+/**
+ * The properties of a window which are needed to draw its icon.
+ */
+struct WindowProperties {
+    WindowProperties() :
+        has_hints(false) {
+        std::memset(&hints, 0, sizeof(hints));
+    };
+
+    /// The icon name if the window has one, otherwise its title
+    std::string icon_name;
+
+    /// Whether or not the window has WM_HINTS
+    bool has_hints;
+
+    /// The window's WM_HINTS
+    XWMHints hints;
+
+    /// The icon pixmap given by WM_HINTS
+    IconImage hint_icon;
+
+    /** The icon given by _NET_WM_ICON, scaled to the height of an icon - this
+     * pixmap belongs to the PropertyFetcher. */
+    IconImage net_icon;
+
+    /**
+     * Gets the best available icon image.
+     */
+    const IconImage &best_icon() const {
+        if (net_icon.pixmap != None) return net_icon;
+
+        return hint_icon;
+    };
+};
+
+/**
+ * Something which wants to know when the properties of a window have been
+ * fetched.
+ */
+class PropertyListener
+{
+public:
+virtual ~PropertyListener() {
+};
+
+/**
+ * Called on the X thread after new properties have been stored.
+ * @param window The window whose properties changed.
+ */
+virtual void properties_changed(Window window) = 0;
+};
+
+/**
+ * Fetches and decodes window properties over a second connection to the X
+ * server, which is owned by a background thread. This keeps bulk property
+ * transfers (like the multi-megabyte _NET_WM_ICON some applications set)
+ * from holding up the connection which handles input.
+ *
+ * Requests for the same window are coalesced until the thread gets to them,
+ * so a client that changes its title constantly only costs one fetch per
+ * pass. Results come back through the CompletionQueue and are cached here,
+ * where they can be read from the X thread.
+ */
+class PropertyFetcher
+{
+public:
+PropertyFetcher(Log &logger, CompletionQueue &completed,
+                Dimension icon_height, bool fetch_icons) :
+    m_logger(logger), m_completed(completed), m_listener(0),
+    m_icon_height(icon_height), m_fetch_icons(fetch_icons),
+    m_display(0), m_gc(0), m_net_wm_icon(None), m_stopping(false) {
+};
+
+~PropertyFetcher();
+
+bool start();
+
+void set_listener(PropertyListener *listener) {
+    m_listener = listener;
+};
+
+/// Whether or not the background connection is available
+bool is_running() const {
+    return m_display != 0;
+};
+
+void request(Window, unsigned int);
+void forget(Window);
+
+const WindowProperties * find(Window) const;
+unsigned int flags_for_atom(Atom) const;
+
+private:
+/**
+ * The result of fetching a window's properties, which is applied to the
+ * cache once it reaches the X thread.
+ */
+struct FetchTask : public WorkerTask {
+    FetchTask(PropertyFetcher &_fetcher, Window _window, unsigned int _flags) :
+        WorkerTask("property-fetch"), fetcher(_fetcher), window(_window),
+        flags(_flags) {
+    };
+
+    void run() {
+        fetcher.fetch(window, flags, properties);
+    };
+
+    void complete() {
+        fetcher.store(*this);
+    };
+
+    /// The fetcher which owns the cache
+    PropertyFetcher &fetcher;
+
+    /// The window whose properties were fetched
+    Window window;
+
+    /// Which properties were fetched
+    unsigned int flags;
+
+    /// The fetched properties (only those in flags are filled in)
+    WindowProperties properties;
+};
+
+/**
+ * A request which hasn't been picked up by the background thread yet.
+ */
+struct PendingFetch {
+    PendingFetch() :
+        flags(0), since(0) {
+    };
+
+    /// Which properties to fetch
+    unsigned int flags;
+
+    /// When the first request was made, in microseconds
+    unsigned long long since;
+};
+
+void thread_main();
+void fetch(Window, unsigned int, WindowProperties&);
+void fetch_net_icon(Window, IconImage&);
+Pixmap create_icon_pixmap(const unsigned long *, unsigned long,
+                          unsigned long, Dimension, Dimension);
+void store(FetchTask&);
+void free_pixmap(Pixmap);
+
+/// Where to report problems with the background connection
+Log &m_logger;
+
+/// Where finished fetches go
+CompletionQueue &m_completed;
+
+/// Who to tell about new properties
+PropertyListener *m_listener;
+
+/// How tall decoded icons should be
+Dimension m_icon_height;
+
+/// Whether or not _NET_WM_ICON should be fetched at all
+bool m_fetch_icons;
+
+/// The background connection, which is only used by the background thread
+Display *m_display;
+
+/// Used to upload decoded icons on the background connection
+GC m_gc;
+
+/// The _NET_WM_ICON atom, interned on the background connection
+Atom m_net_wm_icon;
+
+/// The background thread
+std::thread m_thread;
+
+/// Protects m_requests, m_unused_pixmaps and m_stopping
+std::mutex m_lock;
+
+/// Wakes the background thread when there is work to do
+std::condition_variable m_wakeup;
+
+/// The windows which need to be fetched
+std::map<Window, PendingFetch> m_requests;
+
+/// Decoded icons which are no longer used, and have to be freed
+std::vector<Pixmap> m_unused_pixmaps;
+
+/// Whether or not the background thread should exit
+bool m_stopping;
+
+/// The windows which have been requested and not forgotten
+std::set<Window> m_tracked;
+
+/// The properties of each window - this is only used on the X thread
+std::map<Window, WindowProperties> m_cache;
+};
+
+#endif // ifndef __SMALLWM_PROPERTY_FETCHER__
@@ -0,0 +1,256 @@
+/** @file */
+#include "request-limiter.hpp"
+#include "utils.hpp"
+
+/**
+ * Decides whether a request can be handled right away, taking a token from
+ * the bucket of the client that made it.
+ *
+ * @param request The ConfigureRequest, CirculateRequest or MapRequest.
+ * @param owner The client which the request's window belongs to (the window
+ *        itself, unless it is a child).
+ * @return true if the request should be handled now, false if it is being
+ *         held back (in which case it is passed to the listener later).
+ */
+bool RequestLimiter::admit(XEvent &request, Window owner) {
+    Bucket &bucket = m_buckets[owner];
+    bucket.received++;
+
+    Window window = request.xany.window;
+
+    switch (request.type) {
+    case ConfigureRequest:
+        window = request.xconfigurerequest.window;
+        break;
+    case CirculateRequest:
+        window = request.xcirculaterequest.window;
+        break;
+    case MapRequest:
+        window = request.xmaprequest.window;
+        break;
+    }
+
+    std::map<Window, Pending>::iterator pending = m_pending.find(window);
+
+    // Anything already being held has to go first, so this has to wait
+    // behind it, even if the bucket has refilled
+    if (pending != m_pending.end()) {
+        hold(pending->second, request);
+        return false;
+    }
+
+    if (m_rate != 0) {
+        refill(bucket, monotonic_usec());
+
+        if (bucket.tokens < 1.0) {
+            Pending &held = m_pending[window];
+            held.owner = owner;
+            hold(held, request);
+
+            schedule();
+            return false;
+        }
+
+        bucket.tokens -= 1.0;
+    }
+
+    bucket.forwarded++;
+    m_forwarded++;
+    return true;
+}
+
+/**
+ * Drops everything known about a window, once it has been destroyed.
+ */
+void RequestLimiter::forget(Window window) {
+    m_buckets.erase(window);
+
+    // Children's requests come out of their client's bucket, so they have to
+    // go along with it
+    std::map<Window, Pending>::iterator pending = m_pending.begin();
+
+    while (pending != m_pending.end()) {
+        if (pending->first == window || pending->second.owner == window)
+            m_pending.erase(pending++);
+        else pending++;
+    }
+}
+
+/**
+ * Lets through the held requests of every client whose bucket has refilled.
+ */
+void RequestLimiter::timer_expired(Timer *timer) {
+    unsigned long long now = monotonic_usec();
+    std::vector<Pending> ready;
+    std::map<Window, Pending>::iterator pending = m_pending.begin();
+
+    while (pending != m_pending.end()) {
+        Bucket &bucket = m_buckets[pending->second.owner];
+        refill(bucket, now);
+
+        if (bucket.tokens < 1.0) {
+            pending++;
+            continue;
+        }
+
+        bucket.tokens -= 1.0;
+        ready.push_back(pending->second);
+        m_pending.erase(pending++);
+    }
+
+    // The held requests are only released once the map is done with, since
+    // the listener is free to make more requests of its own
+    for (std::vector<Pending>::iterator held = ready.begin();
+         held != ready.end();
+         held++) {
+        release(*held);
+    }
+
+    schedule();
+}
+
+/**
+ * Converts the rate limiting state of each client to a textual
+ * representation, which is written to the output stream.
+ */
+void RequestLimiter::dump(std::ostream &output) {
+    output << "Request Limits\n";
+    output << "  Forwarded: " << std::dec << m_forwarded << "\n";
+    output << "  Coalesced: " << m_coalesced << "\n";
+    output << "  Held: " << m_pending.size() << "\n";
+
+    for (std::map<Window, Bucket>::iterator bucket = m_buckets.begin();
+         bucket != m_buckets.end();
+         bucket++) {
+        output << "  Client " << std::hex << bucket->first << ": " << std::dec <<
+            "received " << bucket->second.received <<
+            " forwarded " << bucket->second.forwarded <<
+            " coalesced " << bucket->second.coalesced << "\n";
+    }
+}
+
+/**
+ * Writes out how many requests have been let through and merged.
+ */
+void RequestLimiter::metrics(MetricsWriter &output) {
+    output.family("smallwm_client_requests_total", "counter",
+                  "Configure, circulate and map requests from clients, by result.");
+    output.sample("smallwm_client_requests_total", "result", "forwarded", m_forwarded);
+    output.sample("smallwm_client_requests_total", "result", "coalesced", m_coalesced);
+}
+
+/**
+ * Adds tokens to a bucket for the time that has passed since it was last
+ * refilled.
+ */
+void RequestLimiter::refill(Bucket &bucket, unsigned long long now) {
+    if (bucket.last_refill == 0) bucket.tokens = m_burst;
+    else {
+        bucket.tokens += (now - bucket.last_refill) * m_rate / 1000000.0;
+
+        if (bucket.tokens > m_burst) bucket.tokens = m_burst;
+    }
+
+    bucket.last_refill = now;
+}
+
+/**
+ * Merges a request into the requests being held back for its window.
+ */
+void RequestLimiter::hold(Pending &held, XEvent &request) {
+    bool replaced = false;
+
+    if (request.type == ConfigureRequest) {
+        const XConfigureRequestEvent &configure = request.xconfigurerequest;
+
+        if (!held.has_configure) {
+            held.configure = configure;
+            held.has_configure = true;
+        } else {
+            replaced = true;
+
+            if (configure.value_mask & CWX) held.configure.x = configure.x;
+            if (configure.value_mask & CWY) held.configure.y = configure.y;
+            if (configure.value_mask & CWWidth) held.configure.width = configure.width;
+            if (configure.value_mask & CWHeight) held.configure.height = configure.height;
+            if (configure.value_mask & CWBorderWidth)
+                held.configure.border_width = configure.border_width;
+            if (configure.value_mask & CWSibling) held.configure.above = configure.above;
+            if (configure.value_mask & CWStackMode) held.configure.detail = configure.detail;
+
+            held.configure.value_mask |= configure.value_mask;
+        }
+    } else if (request.type == CirculateRequest) {
+        replaced = held.has_circulate;
+        held.circulate = request.xcirculaterequest;
+        held.has_circulate = true;
+    } else if (request.type == MapRequest) {
+        replaced = held.has_map;
+        held.map = request.xmaprequest;
+        held.has_map = true;
+    }
+
+    if (replaced) {
+        m_buckets[held.owner].coalesced++;
+        m_coalesced++;
+    }
+}
+
+/**
+ * Passes the requests being held back for a window on to the listener. The
+ * geometry goes first, so that a window which asked to be moved before being
+ * mapped doesn't show up in the wrong place.
+ */
+void RequestLimiter::release(Pending &held) {
+    Bucket &bucket = m_buckets[held.owner];
+    XEvent request;
+
+    if (held.has_configure) {
+        request.xconfigurerequest = held.configure;
+        bucket.forwarded++;
+        m_forwarded++;
+        m_listener->request_released(request);
+    }
+
+    if (held.has_circulate) {
+        request.xcirculaterequest = held.circulate;
+        bucket.forwarded++;
+        m_forwarded++;
+        m_listener->request_released(request);
+    }
+
+    if (held.has_map) {
+        request.xmaprequest = held.map;
+        bucket.forwarded++;
+        m_forwarded++;
+        m_listener->request_released(request);
+    }
+}
+
+/**
+ * Arms the timer for when the next client with held requests gets a token
+ * back, or disarms it if nothing is being held.
+ */
+void RequestLimiter::schedule() {
+    if (m_pending.empty()) {
+        m_timer.disarm();
+        return;
+    }
+
+    unsigned long long now = monotonic_usec();
+    double wait = -1;
+
+    for (std::map<Window, Pending>::iterator pending = m_pending.begin();
+         pending != m_pending.end();
+         pending++) {
+        Bucket &bucket = m_buckets[pending->second.owner];
+        refill(bucket, now);
+
+        double needed = bucket.tokens >= 1.0 ? 0 : (1.0 - bucket.tokens) * 1000.0 / m_rate;
+
+        if (wait < 0 || needed < wait) wait = needed;
+    }
+
+    // Round up, so that the bucket has always refilled when the timer expires
+    m_timer.arm(static_cast<unsigned long>(wait) + 1);
+}
@@ -0,0 +1,146 @@
+/** @file */
+#ifndef __SMALLWM_REQUEST_LIMITER__
+#define __SMALLWM_REQUEST_LIMITER__
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "common.hpp"
+#include "event-loop.hpp"
+#include "metrics.hpp"
+#include "timer.hpp"
+
+/**
+ * Something which handles the requests that a RequestLimiter lets through
+ * after holding them back.
+ */
+class RequestListener
+{
+public:
+virtual ~RequestListener() {
+};
+
+/**
+ * Handles a request which was held back, and is now allowed through.
+ * @param request The request - a ConfigureRequest, CirculateRequest or
+ *        MapRequest, which is only valid during the call.
+ */
+virtual void request_released(XEvent &request) = 0;
+};
+
+/**
+ * Keeps any one client from flooding the X server (and the model, by way of
+ * the ConfigureNotify events that follow) with configure, circulate and map
+ * requests.
+ *
+ * Each client gets a token bucket, which is shared by all of its children.
+ * Requests that arrive while a client's bucket is empty are held back, and
+ * later requests for the same window are merged into the held request, so
+ * that only the latest geometry is applied once the bucket refills.
+ */
+class RequestLimiter : public TimerListener
+{
+public:
+RequestLimiter(EventLoop &loop, RequestListener *listener,
+               unsigned long rate, unsigned long burst) :
+    m_listener(listener), m_timer(loop, this, "request-limiter"), m_rate(rate), m_burst(burst),
+    m_forwarded(0), m_coalesced(0) {
+};
+
+bool admit(XEvent&, Window);
+void forget(Window);
+
+void timer_expired(Timer *);
+
+void dump(std::ostream&);
+void metrics(MetricsWriter&);
+
+private:
+/**
+ * The rate limiting state of a single client.
+ */
+struct Bucket {
+    Bucket() :
+        tokens(0), last_refill(0), received(0), forwarded(0), coalesced(0) {
+    };
+
+    /// How many requests the client can make right now
+    double tokens;
+
+    /// When the tokens were last refilled, in microseconds
+    unsigned long long last_refill;
+
+    /// How many requests the client and its children have made
+    unsigned long received;
+
+    /// How many of those requests were let through
+    unsigned long forwarded;
+
+    /// How many of those requests were merged into a later one
+    unsigned long coalesced;
+};
+
+/**
+ * The requests which are being held back for a single window, merged
+ * together.
+ */
+struct Pending {
+    Pending() :
+        owner(None), has_configure(false), configure(), has_circulate(false),
+        circulate(), has_map(false), map() {
+    };
+
+    /// The client whose bucket the requests come out of
+    Window owner;
+
+    /// Whether a ConfigureRequest is being held
+    bool has_configure;
+
+    /// The ConfigureRequests, merged so that the latest value of each field wins
+    XConfigureRequestEvent configure;
+
+    /// Whether a CirculateRequest is being held
+    bool has_circulate;
+
+    /// The latest CirculateRequest
+    XCirculateRequestEvent circulate;
+
+    /// Whether a MapRequest is being held
+    bool has_map;
+
+    /// The latest MapRequest
+    XMapRequestEvent map;
+};
+
+void refill(Bucket&, unsigned long long);
+void hold(Pending&, XEvent&);
+void release(Pending&);
+void schedule();
+
+/// Who handles requests once they have been held back
+RequestListener *m_listener;
+
+/// Expires when the next held request can be let through
+Timer m_timer;
+
+/// How many requests each client may make per second (0 means no limit)
+unsigned long m_rate;
+
+/// How many requests each client may make in a burst
+unsigned long m_burst;
+
+/// The rate limiting state of every client, keyed by the client
+std::map<Window, Bucket> m_buckets;
+
+/// The requests being held back, keyed by the window they are for
+std::map<Window, Pending> m_pending;
+
+/// How many requests have been let through, across every client
+unsigned long long m_forwarded;
+
+/// How many requests have been merged into later ones, across every client
+unsigned long long m_coalesced;
+};
+
+#endif // ifndef __SMALLWM_REQUEST_LIMITER__
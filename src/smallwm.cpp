@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <csignal>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -8,17 +10,36 @@
 #include "clientmodel-events.hpp"
 #include "configparse.hpp"
 #include "common.hpp"
+#include "cpu-weighting.hpp"
+#include "event-loop.hpp"
+#include "event-stream.hpp"
+#include "freezer.hpp"
+#include "journal.hpp"
+#include "latency-probe.hpp"
 #include "logging/logging.hpp"
 #include "logging/file.hpp"
 #include "logging/syslog.hpp"
+#include "logging/throttle.hpp"
+#include "memory.hpp"
+#include "metrics.hpp"
 #include "model/changes.hpp"
 #include "model/client-model.hpp"
 #include "model/screen.hpp"
 #include "model/x-model.hpp"
+#include "object-pool.hpp"
+#include "property-fetcher.hpp"
+#include "worker-pool.hpp"
 #include "xdata.hpp"
 #include "x-events.hpp"
 
 bool should_execute_dump = false;
+bool should_reap_children = false;
+
+/// The log that X errors are written to, once it has been set up
+Log *error_logger = NULL;
+
+/// The main connection to the X server
+Display *main_display = NULL;
 
 /**
  * Triggers a model state dump after the current batch of events has been processed.
@@ -27,16 +48,179 @@ void enable_dump(int signal) {
     should_execute_dump = true;
 }
 
+/**
+ * Triggers reaping the children which have exited, after the current batch of
+ * events has been processed.
+ */
+void enable_reap(int signal) {
+    should_reap_children = true;
+}
+
+/**
+ * Appends an already-formatted dump to the dump file. Since the dump file
+ * could be anywhere (including on a slow or hung network filesystem), this
+ * is kept off of the X thread.
+ */
+struct DumpWriteTask : public WorkerTask {
+    DumpWriteTask(Log &_logger, const std::string &_filename,
+                  const std::string &_contents) :
+        WorkerTask("dump-write"), logger(_logger), filename(_filename),
+        contents(_contents), succeeded(false) {
+    };
+
+    void run() {
+        std::fstream dump_file(filename.c_str(),
+                               std::fstream::out | std::fstream::app);
+
+        if (dump_file) {
+            dump_file << contents;
+            dump_file.close();
+            succeeded = !dump_file.fail();
+        }
+    };
+
+    void complete() {
+        if (!succeeded) {
+            logger.log(LOG_ERR) <<
+                "Could not write to dump file '" << filename <<
+                "'" << Log::endl;
+        }
+    };
+
+    /// Where to report failures
+    Log &logger;
+
+    /// The file to append the dump to
+    std::string filename;
+
+    /// The formatted dump
+    std::string contents;
+
+    /// Whether or not the dump was written out
+    bool succeeded;
+};
+
+/**
+ * Collects the metrics of every part of SmallWM, for the MetricsExporter.
+ */
+struct WMMetrics : public MetricsSource {
+    WMMetrics(EventLoop &_loop, XEvents &_x_events, XData &_xdata,
+              ClientModelEvents &_client_events, ClientModel &_clients,
+              ThrottledLog &_logger) :
+        loop(_loop), x_events(_x_events), xdata(_xdata),
+        client_events(_client_events), clients(_clients), logger(_logger) {
+    };
+
+    void metrics(MetricsWriter &output) {
+        loop.metrics(output);
+        x_events.metrics(output);
+        xdata.metrics(output);
+        client_events.metrics(output);
+
+        output.family("smallwm_clients", "gauge", "Managed clients, by desktop.");
+
+        for (int desktop = 0; desktop < clients.USER_DESKTOPS.size(); desktop++) {
+            std::ostringstream name;
+            name << desktop + 1;
+
+            output.sample("smallwm_clients", "desktop", name.str(),
+                          clients.count_clients_of(clients.USER_DESKTOPS[desktop]));
+        }
+
+        output.sample("smallwm_clients", "desktop", "all",
+                      clients.count_clients_of(clients.ALL_DESKTOPS));
+        output.sample("smallwm_clients", "desktop", "icon",
+                      clients.count_clients_of(clients.ICON_DESKTOP));
+        output.sample("smallwm_clients", "desktop", "moving",
+                      clients.count_clients_of(clients.MOVING_DESKTOP));
+        output.sample("smallwm_clients", "desktop", "resizing",
+                      clients.count_clients_of(clients.RESIZING_DESKTOP));
+        output.sample("smallwm_clients", "desktop", "warm",
+                      clients.count_clients_of(clients.WARM_DESKTOP));
+
+        output.family("smallwm_log_messages_total", "counter",
+                      "Log messages which were written out.");
+        output.sample("smallwm_log_messages_total", logger.written());
+
+        output.family("smallwm_log_dropped_total", "counter",
+                      "Log messages which were deduplicated or rate limited.");
+        output.sample("smallwm_log_dropped_total", logger.dropped());
+
+        output.family("smallwm_memory_live_bytes", "gauge",
+                      "Memory currently allocated, by subsystem.");
+
+        for (int subsystem = 0; subsystem < MEM_SUBSYSTEMS; subsystem++) {
+            MemorySubsystem which = static_cast<MemorySubsystem>(subsystem);
+            output.sample("smallwm_memory_live_bytes", "subsystem",
+                          memory_subsystem_label(which), memory_account(which).live());
+        }
+
+        output.family("smallwm_memory_peak_bytes", "gauge",
+                      "The most memory ever allocated at once, by subsystem.");
+
+        for (int subsystem = 0; subsystem < MEM_SUBSYSTEMS; subsystem++) {
+            MemorySubsystem which = static_cast<MemorySubsystem>(subsystem);
+            output.sample("smallwm_memory_peak_bytes", "subsystem",
+                          memory_subsystem_label(which), memory_account(which).peak());
+        }
+
+        output.family("smallwm_memory_allocations_total", "counter",
+                      "Allocations made, by subsystem.");
+
+        for (int subsystem = 0; subsystem < MEM_SUBSYSTEMS; subsystem++) {
+            MemorySubsystem which = static_cast<MemorySubsystem>(subsystem);
+            output.sample("smallwm_memory_allocations_total", "subsystem",
+                          memory_subsystem_label(which),
+                          memory_account(which).allocations());
+        }
+    };
+
+    /// Counts the wakeups of the event loop
+    EventLoop &loop;
+
+    /// Counts the events that have been dispatched
+    XEvents &x_events;
+
+    /// Counts the requests sent to the X server
+    XData &xdata;
+
+    /// Counts the batches of changes
+    ClientModelEvents &client_events;
+
+    /// Knows how many clients are on each desktop
+    ClientModel &clients;
+
+    /// Counts the log messages that were written and dropped
+    ThrottledLog &logger;
+};
+
 /**
  * Prints out X errors to enable diagnosis, but doesn't kill us.
  * @param display The display the error occurred on
  * @param event The error event that happened
  */
 int x_error_handler(Display *display, XErrorEvent *event) {
+    // Errors on the PropertyFetcher's connection are almost always windows
+    // which were destroyed before their properties could be read. Those are
+    // harmless, and the logger can't be used from the fetcher's thread anyway.
+    if (display != main_display) return 0;
+
     char err_desc[500];
 
     XGetErrorText(display, event->error_code, err_desc, 500);
 
+    // A client which goes away in the middle of being managed can cause a
+    // whole stream of these, so they have to go through the rate limiter
+    // rather than being written out directly
+    if (error_logger) {
+        error_logger->log(LOG_WARNING, LOG_SITE) <<
+            "X Error: display = '" << XDisplayName(NULL) <<
+            "' error = '" << err_desc <<
+            "' request = " << static_cast<int>(event->request_code) <<
+            " minor = " << static_cast<int>(event->minor_code) << Log::endl;
+        return 0;
+    }
+
     std::cerr << "X Error: \n"
         "\tdisplay = " << XDisplayName(NULL) << "'\n"
         "\tserial = " << event->serial << "'\n"
@@ -48,9 +232,13 @@ int x_error_handler(Display *display, XErrorEvent *event) {
 }
 
 int main() {
-    // Make sure that child processes don't generate zombies. This is an
-    // alternative to the wait() reaping loop under POSIX 2001
-    signal(SIGCHLD, SIG_IGN);
+    // Children are reaped from the main loop rather than being ignored, so
+    // that a pid isn't reused while a warm shell is still being waited on
+    signal(SIGCHLD, enable_reap);
+
+    // The PropertyFetcher uses Xlib from a second thread (although on its
+    // own connection)
+    XInitThreads();
 
     XSetErrorHandler(x_error_handler);
     signal(SIGUSR1, enable_dump);
@@ -58,7 +246,7 @@ int main() {
     WMConfig config;
     config.load();
 
-    Log *logger;
+    Log *base_logger;
 
     if (config.log_file == std::string("syslog")) {
         SysLog *sys_logger = new SysLog();
@@ -66,24 +254,37 @@ int main() {
         sys_logger->set_facility(LOG_USER);
         sys_logger->set_log_mask(LOG_UPTO(config.log_mask));
         sys_logger->start();
-        logger = sys_logger;
+        base_logger = sys_logger;
     } else {
-        logger = new FileLog(config.log_file, config.log_mask);
+        base_logger = new FileLog(config.log_file, config.log_mask);
     }
 
+    ThrottledLog *logger = new ThrottledLog(*base_logger,
+                                            config.log_dedup_window,
+                                            config.log_rate_limit,
+                                            config.log_rate_burst);
+    error_logger = logger;
+
     Display *display = XOpenDisplay(NULL);
+    main_display = display;
 
     if (!display) {
         logger->log(LOG_ERR) <<
             "Could not open X display - terminating" << Log::endl;
         logger->stop();
         delete logger;
+        delete base_logger;
 
         std::exit(2);
     }
 
     Window default_root = DefaultRootWindow(display);
     XData xdata(*logger, display, default_root, DefaultScreen(display));
+    xdata.load_label_font(config.icon_font);
+
+    #ifdef WITH_THUMBNAILS
+    if (config.icon_thumbnails && !xdata.init_thumbnails()) config.icon_thumbnails = false;
+    #endif
     xdata.select_input(default_root,
                        PointerMotionMask |
                        StructureNotifyMask |
@@ -93,6 +294,7 @@ int main() {
     CrtManager crt_manager;
     std::vector<Box> screens;
     xdata.get_screen_boxes(screens);
+    crt_manager.set_icon_row_height(config.icon_height);
     crt_manager.rebuild_graph(screens);
 
     ChangeStream changes;
@@ -105,23 +307,72 @@ int main() {
     std::vector<Window> existing_windows;
     xdata.get_windows(existing_windows);
 
+    EventLoop loop(xdata.connection_fd());
+    logger->use_loop(loop);
+
+    CompletionQueue completions;
+    loop.add_source(completions.fd(), POLLIN, &completions, "completions");
+
+    WorkerPool workers(completions, config.worker_threads);
+
+    PropertyFetcher properties(*logger, completions, config.icon_height,
+                               config.show_icons);
+    properties.start();
+
+    LatencyProbe probe(xdata, config.key_commands, config.latency_probe);
+
     XModel xmodel;
-    XEvents x_events(config, xdata, clients, xmodel);
+    XEvents x_events(config, xdata, clients, xmodel, loop, properties, probe);
 
-    for (std::vector<Window>::iterator win_iter = existing_windows.begin();
-         win_iter != existing_windows.end();
-         win_iter++) {
-        if (*win_iter != default_root) x_events.add_window(*win_iter);
-    }
+    existing_windows.erase(std::remove(existing_windows.begin(), existing_windows.end(),
+                                       default_root),
+                           existing_windows.end());
+    x_events.add_windows(existing_windows);
 
     ClientModelEvents client_events(config, *logger, changes,
                                     xdata, clients, xmodel);
 
+    EventStream event_stream(*logger, loop);
+
+    if (!config.event_socket.empty() && event_stream.listen(config.event_socket))
+        client_events.add_observer(&event_stream);
+
+    CpuWeighting cpu_weighting(*logger, clients, xmodel);
+
+    if (!config.cgroup_root.empty() && cpu_weighting.enable(config.cgroup_root))
+        client_events.add_observer(&cpu_weighting);
+
+    Freezer freezer(*logger, clients, xmodel, loop, config.freeze_delay);
+    freezer.use_cgroup(config.cgroup_root);
+
+    if (!config.freeze_classes.empty())
+        client_events.add_observer(&freezer);
+
+    WMMetrics metrics(loop, x_events, xdata, client_events, clients, *logger);
+    MetricsExporter exporter(*logger, loop, workers, metrics);
+
+    if (!config.metrics_file.empty())
+        exporter.start(config.metrics_file, config.metrics_interval);
+
+    // The existing windows have been adopted by now, so any that are in the
+    // journal can be put back where they were before SmallWM restarted
+    ModelJournal journal(*logger, clients);
+
+    if (!config.journal_file.empty() && journal.open(config.journal_file, xdata.get_server_session())) {
+        journal.restore();
+        client_events.add_observer(&journal);
+    }
+
     // Make sure to process all the changes produced by the class actions for
     // the first set of windows
     client_events.handle_queued_changes();
 
     while (x_events.step()) {
+        if (should_reap_children) {
+            should_reap_children = false;
+            x_events.reap_children();
+        }
+
         if (should_execute_dump) {
             should_execute_dump = false;
 
@@ -129,27 +380,37 @@ int main() {
                 "Executing dump to target file '" << config.dump_file <<
                 "'" << Log::endl;
 
-            std::fstream dump_file(config.dump_file.c_str(),
-                                   std::fstream::out | std::fstream::app);
-
-            if (dump_file) {
-                dump_file << "#BEGIN DUMP\n";
-                crt_manager.dump(dump_file);
-                clients.dump(dump_file);
-                dump_file << "#END DUMP\n";
-                dump_file.close();
-            } else {
-                logger->log(LOG_ERR) <<
-                    "Could not open dump file '" << config.dump_file <<
-                    "' for writing" << Log::endl;
-            }
+            // The models can only be looked at from this thread, but the
+            // write itself can go to a worker
+            std::ostringstream dump;
+            dump << "#BEGIN DUMP\n";
+            crt_manager.dump(dump);
+            clients.dump(dump);
+            logger->dump(dump);
+            completions.dump(dump);
+            loop.dump(dump);
+            probe.dump(dump);
+            event_stream.dump(dump);
+            cpu_weighting.dump(dump);
+            freezer.dump(dump);
+            journal.dump(dump);
+            x_events.dump(dump);
+            dump_memory(dump);
+            dump_pools(dump);
+            dump << "#END DUMP\n";
+
+            workers.submit(new DumpWriteTask(*logger, config.dump_file,
+                                             dump.str()));
         }
 
         client_events.handle_queued_changes();
+        probe.end_batch();
     }
 
+    error_logger = NULL;
     logger->stop();
     delete logger;
+    delete base_logger;
 
     return 0;
 }
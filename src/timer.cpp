@@ -0,0 +1,81 @@
+/** @file */
+#include <cstdint>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "timer.hpp"
+
+/**
+ * Creates a disarmed timer.
+ * @param loop The loop to wake up when the timer expires.
+ * @param listener Who to tell when the timer expires.
+ * @param name What the timer's wakeups are counted under.
+ */
+Timer::Timer(EventLoop &loop, TimerListener *listener, const char *name) :
+    m_loop(loop), m_listener(listener), m_name(name), m_armed(false),
+    m_repeating(false) {
+    m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+Timer::~Timer() {
+    disarm();
+
+    if (m_fd != -1) close(m_fd);
+}
+
+/**
+ * Starts the timer, replacing whatever it was doing before.
+ * @param msec How long until the timer expires, in milliseconds.
+ * @param interval How often the timer expires after that, in milliseconds, or
+ *                 0 if it only expires once.
+ */
+void Timer::arm(unsigned long msec, unsigned long interval) {
+    if (m_fd == -1) return;
+
+    // A zero value would disarm the timerfd instead
+    if (msec == 0) msec = 1;
+
+    struct itimerspec spec;
+    spec.it_value.tv_sec = msec / 1000;
+    spec.it_value.tv_nsec = (msec % 1000) * 1000000;
+    spec.it_interval.tv_sec = interval / 1000;
+    spec.it_interval.tv_nsec = (interval % 1000) * 1000000;
+
+    timerfd_settime(m_fd, 0, &spec, NULL);
+
+    if (!m_armed) m_loop.add_source(m_fd, POLLIN, this, m_name);
+
+    m_armed = true;
+    m_repeating = interval != 0;
+}
+
+/**
+ * Stops the timer, if it is armed.
+ */
+void Timer::disarm() {
+    if (!m_armed) return;
+
+    struct itimerspec spec = {};
+    timerfd_settime(m_fd, 0, &spec, NULL);
+
+    m_loop.remove_source(m_fd);
+    m_armed = false;
+}
+
+/**
+ * Tells the listener that the timer has expired.
+ */
+void Timer::on_ready(int fd, short revents) {
+    uint64_t _expirations;
+
+    // This may have been disarmed (and so cleared) by an earlier handler
+    if (::read(m_fd, &_expirations, sizeof(_expirations)) != sizeof(_expirations)) return;
+
+    if (!m_repeating) {
+        m_loop.remove_source(m_fd);
+        m_armed = false;
+    }
+
+    m_listener->timer_expired(this);
+}
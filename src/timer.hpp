@@ -0,0 +1,68 @@
+/** @file */
+#ifndef __SMALLWM_TIMER__
+#define __SMALLWM_TIMER__
+
+#include "event-loop.hpp"
+
+class Timer;
+
+/**
+ * Something which wants to know when a Timer expires.
+ */
+class TimerListener
+{
+public:
+virtual ~TimerListener() {
+};
+
+/**
+ * Called on the event loop's thread when the timer expires.
+ * @param timer The timer which expired.
+ */
+virtual void timer_expired(Timer *timer) = 0;
+};
+
+/**
+ * A timer which wakes up the EventLoop when it expires, so that work can be
+ * put off without anything having to poll for it.
+ *
+ * This is backed by a timerfd, which is only registered with the loop while
+ * the timer is armed - a disarmed timer costs nothing.
+ */
+class Timer : public LoopHandler
+{
+public:
+Timer(EventLoop &loop, TimerListener *listener, const char *name);
+~Timer();
+
+void arm(unsigned long, unsigned long interval = 0);
+void disarm();
+
+/// Whether or not the timer will expire
+bool is_armed() const {
+    return m_armed;
+};
+
+void on_ready(int, short);
+
+private:
+/// The loop which waits on the timer
+EventLoop &m_loop;
+
+/// Who to tell when the timer expires
+TimerListener *m_listener;
+
+/// What the timer's wakeups are counted under
+const char *m_name;
+
+/// The timerfd, or -1 if one couldn't be created
+int m_fd;
+
+/// Whether or not the timer is armed
+bool m_armed;
+
+/// Whether or not the timer rearms itself after it expires
+bool m_repeating;
+};
+
+#endif // ifndef __SMALLWM_TIMER__
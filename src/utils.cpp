@@ -1,4 +1,6 @@
 /** @file */
+#include <unistd.h>
+
 #include "utils.hpp"
 
 /**
@@ -70,3 +72,25 @@ unsigned long try_parse_ulong_nonzero(const char *string, unsigned long default_
     if (result == 0) return default_;
     else return result;
 }
+
+/**
+ * Gets the current value of the monotonic clock, which is useful for
+ * measuring intervals since it doesn't jump when the wall clock is changed.
+ *
+ * @return The current time, in microseconds.
+ */
+unsigned long long monotonic_usec() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<unsigned long long>(now.tv_sec) * 1000000ULL +
+           now.tv_nsec / 1000;
+}
+
+/**
+ * Checks whether a pid names a process which a client's process could be -
+ * that is, anything other than init or SmallWM itself.
+ */
+bool is_other_process(unsigned long pid) {
+    return pid > 1 && pid != static_cast<unsigned long>(getpid());
+}
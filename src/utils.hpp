@@ -6,10 +6,13 @@
 #include <cstdlib>
 #include <cstring>
 #include <map>
+#include <time.h>
 
 unsigned long try_parse_ulong(const char *string, unsigned long default_);
 unsigned long try_parse_ulong_nonzero(const char *string, unsigned long default_);
 void strip_string(const char *text, const char *remove, char *buffer);
+unsigned long long monotonic_usec();
+bool is_other_process(unsigned long pid);
 
 template<class InputIt, class T>
 bool contains(InputIt start, InputIt end, T& value) {
@@ -20,20 +23,29 @@ bool contains(InputIt start, InputIt end, T& value) {
 
 /**
  * A sorter that uses the elements being sorted as keys to a map, which are
- * sorted by their values in the map.
+ * sorted by their values in the map. Keys which aren't in the map sort as if
+ * they had the default value.
  */
-template <class Key, class Value>
+template <class Key, class Value, class Map = std::map<Key, Value> >
 class MapSorter
 {
 public:
-MapSorter(std::map<Key, Value> map) : m_map(map) {
+MapSorter(const Map &map) : m_map(map) {
 }
 
 bool operator()(const Key &a, const Key &b) {
-    return m_map[a] < m_map[b];
+    return value_of(a) < value_of(b);
 }
 
 private:
-std::map<Key, Value> m_map;
+Value value_of(const Key &key) {
+    typename Map::const_iterator entry = m_map.find(key);
+
+    if (entry == m_map.end()) return Value();
+
+    return entry->second;
+}
+
+const Map &m_map;
 };
 #endif // ifndef __SMALLWM_UTILS__
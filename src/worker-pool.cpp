@@ -0,0 +1,208 @@
+/** @file */
+#include <cstdint>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "worker-pool.hpp"
+#include "utils.hpp"
+
+/**
+ * Creates the eventfd which wakes the event loop.
+ */
+CompletionQueue::CompletionQueue() :
+    m_head(0) {
+    m_eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+/**
+ * Discards any tasks which were never completed.
+ */
+CompletionQueue::~CompletionQueue() {
+    WorkerTask *task = m_head.exchange(0);
+
+    while (task) {
+        WorkerTask *next = task->next;
+        delete task;
+        task = next;
+    }
+
+    close(m_eventfd);
+}
+
+/**
+ * Adds a finished task to the queue, and wakes up the event loop. This may be
+ * called from any thread.
+ * @param task The finished task.
+ */
+void CompletionQueue::push(WorkerTask *task) {
+    task->finished_at = monotonic_usec();
+
+    WorkerTask *old_head = m_head.load(std::memory_order_relaxed);
+
+    do {
+        task->next = old_head;
+    } while (!m_head.compare_exchange_weak(old_head, task,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+
+    uint64_t one = 1;
+    ssize_t _unused = ::write(m_eventfd, &one, sizeof(one));
+    (void)_unused;
+}
+
+/**
+ * Completes all the tasks which are currently finished, in the order that
+ * they finished. This must be called from the X thread.
+ */
+void CompletionQueue::drain() {
+    // Clear the eventfd before taking the tasks - anything pushed after this
+    // point will signal it again, so no wakeups are lost
+    uint64_t _counter;
+    ssize_t _unused = ::read(m_eventfd, &_counter, sizeof(_counter));
+    (void)_unused;
+
+    WorkerTask *stack = m_head.exchange(0, std::memory_order_acquire);
+
+    // The stack is newest-first, so flip it around
+    WorkerTask *in_order = 0;
+
+    while (stack) {
+        WorkerTask *next = stack->next;
+        stack->next = in_order;
+        in_order = stack;
+        stack = next;
+    }
+
+    while (in_order) {
+        WorkerTask *task = in_order;
+        in_order = task->next;
+
+        unsigned long long now = monotonic_usec();
+        unsigned long long run_time = task->finished_at - task->started_at;
+
+        TaskTiming &timing = m_timing[task->name];
+        timing.count++;
+        timing.wait_usec += task->started_at - task->queued_at;
+        timing.run_usec += run_time;
+        timing.completion_usec += now - task->finished_at;
+
+        if (run_time > timing.max_run_usec) timing.max_run_usec = run_time;
+
+        task->complete();
+        delete task;
+    }
+}
+
+/**
+ * Completes finished tasks when the event loop notices the eventfd.
+ */
+void CompletionQueue::on_ready(int fd, short revents) {
+    drain();
+}
+
+/**
+ * Converts the timing of all the completed tasks to a textual
+ * representation, which is written to an output stream.
+ */
+void CompletionQueue::dump(std::ostream &output) {
+    output << "Worker tasks\n";
+
+    for (std::map<const char *, TaskTiming>::iterator timing = m_timing.begin();
+         timing != m_timing.end();
+         timing++) {
+        TaskTiming &info = timing->second;
+
+        output << "  Task: " << timing->first << "\n";
+        output << "    Count: " << std::dec << info.count << "\n";
+        output << "    Total wait: " << info.wait_usec << "us\n";
+        output << "    Total run: " << info.run_usec << "us\n";
+        output << "    Longest run: " << info.max_run_usec << "us\n";
+        output << "    Total completion delay: " << info.completion_usec << "us\n";
+    }
+}
+
+/**
+ * Starts up the worker threads.
+ * @param completed Where to put tasks once they've been run.
+ * @param num_threads How many threads to start. If this is 0, then tasks
+ *                    are run as soon as they are submitted.
+ */
+WorkerPool::WorkerPool(CompletionQueue &completed, unsigned int num_threads) :
+    m_completed(completed), m_stopping(false) {
+    for (unsigned int thread = 0; thread < num_threads; thread++) {
+        m_threads.push_back(std::thread(&WorkerPool::worker_main, this));
+    }
+}
+
+/**
+ * Stops all the worker threads, after they finish their current tasks. Any
+ * tasks which haven't been started are discarded.
+ */
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stopping = true;
+    }
+
+    m_wakeup.notify_all();
+
+    for (std::vector<std::thread>::iterator thread = m_threads.begin();
+         thread != m_threads.end();
+         thread++) {
+        thread->join();
+    }
+
+    for (std::deque<WorkerTask *>::iterator task = m_pending.begin();
+         task != m_pending.end();
+         task++) {
+        delete *task;
+    }
+}
+
+/**
+ * Queues up a task to be run on a worker thread. Once it has run, its
+ * complete() method is called on the X thread.
+ * @param task The task to run - the pool takes ownership of it.
+ */
+void WorkerPool::submit(WorkerTask *task) {
+    task->queued_at = monotonic_usec();
+
+    if (m_threads.empty()) {
+        task->started_at = task->queued_at;
+        task->run();
+        m_completed.push(task);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_pending.push_back(task);
+    }
+
+    m_wakeup.notify_one();
+}
+
+/**
+ * Runs tasks until the pool is stopped.
+ */
+void WorkerPool::worker_main() {
+    while (true) {
+        WorkerTask *task;
+
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+
+            while (!m_stopping && m_pending.empty()) m_wakeup.wait(guard);
+
+            if (m_stopping) return;
+
+            task = m_pending.front();
+            m_pending.pop_front();
+        }
+
+        task->started_at = monotonic_usec();
+        task->run();
+        m_completed.push(task);
+    }
+}
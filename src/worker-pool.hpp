@@ -0,0 +1,147 @@
+/** @file */
+#ifndef __SMALLWM_WORKER_POOL__
+#define __SMALLWM_WORKER_POOL__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "event-loop.hpp"
+
+/**
+ * A piece of work which can be done away from the X thread.
+ *
+ * The task is split into two halves - run() is called on a worker thread and
+ * must not touch Xlib or any of the models, while complete() is called
+ * later on the X thread, where it can apply the results. After complete()
+ * returns, the task is deleted.
+ */
+struct WorkerTask {
+    WorkerTask(const char *_name) :
+        name(_name), queued_at(0), started_at(0), finished_at(0), next(0) {
+    };
+
+    virtual ~WorkerTask() {
+    };
+
+    /// Does the work - this is run on a worker thread.
+    virtual void run() = 0;
+
+    /// Applies the results of the work - this is run on the X thread.
+    virtual void complete() = 0;
+
+    /// What kind of task this is - this groups tasks for the timing report
+    const char *name;
+
+    /// When the task was submitted, in microseconds
+    unsigned long long queued_at;
+
+    /// When a worker started running the task, in microseconds
+    unsigned long long started_at;
+
+    /// When a worker finished running the task, in microseconds
+    unsigned long long finished_at;
+
+    /// The next task in the completion queue
+    WorkerTask *next;
+};
+
+/**
+ * Collects finished tasks from any number of threads, and hands them to the
+ * X thread when the event loop notices that the queue's eventfd is readable.
+ *
+ * Pushing is lock-free - finished tasks are pushed onto an intrusive stack
+ * with a compare-and-swap, and the X thread takes the entire stack at once.
+ */
+class CompletionQueue : public LoopHandler
+{
+public:
+CompletionQueue();
+~CompletionQueue();
+
+int fd() const {
+    return m_eventfd;
+};
+
+void push(WorkerTask *);
+void drain();
+void on_ready(int, short);
+
+void dump(std::ostream&);
+
+private:
+/**
+ * The timing information of all the tasks of a particular kind.
+ */
+struct TaskTiming {
+    TaskTiming() :
+        count(0), wait_usec(0), run_usec(0), max_run_usec(0),
+        completion_usec(0) {
+    };
+
+    /// How many tasks of this kind have been completed
+    unsigned long count;
+
+    /// How long the tasks spent waiting for a worker
+    unsigned long long wait_usec;
+
+    /// How long the tasks spent running on a worker
+    unsigned long long run_usec;
+
+    /// The longest any one task spent running on a worker
+    unsigned long long max_run_usec;
+
+    /// How long the tasks spent waiting for the X thread after running
+    unsigned long long completion_usec;
+};
+
+/// The top of the stack of finished tasks
+std::atomic<WorkerTask *> m_head;
+
+/// The eventfd which is signalled whenever a task is finished
+int m_eventfd;
+
+/// The timing of every kind of task, keyed by the task's name
+std::map<const char *, TaskTiming> m_timing;
+};
+
+/**
+ * A small set of threads which run WorkerTasks, handing them off to a
+ * CompletionQueue when they are finished.
+ */
+class WorkerPool
+{
+public:
+WorkerPool(CompletionQueue&, unsigned int);
+~WorkerPool();
+
+void submit(WorkerTask *);
+
+private:
+void worker_main();
+
+/// Where finished tasks go
+CompletionQueue &m_completed;
+
+/// The tasks which haven't been picked up by a worker
+std::deque<WorkerTask *> m_pending;
+
+/// Protects m_pending and m_stopping
+std::mutex m_lock;
+
+/// Wakes up workers when tasks are submitted
+std::condition_variable m_wakeup;
+
+/// Whether or not the workers should exit
+bool m_stopping;
+
+/// The worker threads - this may be empty, in which case tasks are run inline
+std::vector<std::thread> m_threads;
+};
+
+#endif // ifndef __SMALLWM_WORKER_POOL__
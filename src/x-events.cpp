@@ -1,42 +1,212 @@
+#include <algorithm>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "x-events.hpp"
 
+/// How close together, in milliseconds, keyboard moves have to be to accelerate
+static const Time NUDGE_REPEAT_MSEC = 150;
+
+/// How many repeats it takes to increase the keyboard move step by one step
+static const unsigned int NUDGE_ACCEL_PRESSES = 5;
+
+/// How many steps a single keyboard move can go at most
+static const unsigned int NUDGE_MAX_MULTIPLIER = 8;
+
 /**
  * Runs a single iteration of the event loop, by capturing an X event and
  * acting upon it.
  *
+ * If something other than X wakes up the event loop (a worker finishing, or a
+ * signal), then this returns without handling an X event, so that the caller
+ * can process whatever changes were made.
+ *
  * @return true if more events can be processed, false otherwise.
  */
 bool XEvents::step() {
+    // Only wait if Xlib doesn't already have an event read off the
+    // connection, since poll() can't see those
+    if (!m_xdata.has_pending_events()) {
+        m_loop.wait(-1);
+
+        if (!m_xdata.has_pending_events()) return !m_done;
+    }
+
     // Grab the next event from X, and then dispatch upon its type
     m_xdata.next_event(m_event);
 
-    if (m_event.type == m_xdata.randr_event_offset + RRNotify) handle_rrnotify();
+    Dispatch *entry = NULL;
+
+    if (m_event.type == GenericEvent) {
+        std::map<int, Dispatch>::iterator generic =
+            m_generic_dispatch.find(m_event.xcookie.extension);
+
+        if (generic != m_generic_dispatch.end()) entry = &generic->second;
+    } else if (m_event.type >= 0 && m_event.type < MAX_EVENT_TYPES)
+        entry = &m_dispatch[m_event.type];
+
+    if (!entry || !entry->name) {
+        m_unhandled++;
+        return !m_done;
+    }
+
+    entry->count++;
+
+    if (entry->method) (this->*(entry->method))();
+    else entry->handler->handle_event(m_event);
+
+    return !m_done;
+}
+
+/**
+ * Fills in the dispatch table with the handlers that are a part of XEvents.
+ */
+void XEvents::add_core_handlers() {
+    add_method(m_xdata.randr_event_offset + RRNotify, "RRNotify",
+               &XEvents::handle_rrnotify);
+
+    #ifdef WITH_THUMBNAILS
+    if (m_config.icon_thumbnails)
+        add_method(m_xdata.damage_event_offset + XDamageNotify, "XDamageNotify",
+                   &XEvents::handle_damagenotify);
+    #endif
+
+    add_method(KeyPress, "KeyPress", &XEvents::handle_keypress);
+    add_method(ButtonPress, "ButtonPress", &XEvents::handle_buttonpress);
+    add_method(ButtonRelease, "ButtonRelease", &XEvents::handle_buttonrelease);
+    add_method(MotionNotify, "MotionNotify", &XEvents::handle_motionnotify);
+    add_method(ConfigureNotify, "ConfigureNotify", &XEvents::handle_configurenotify);
+    add_method(MapNotify, "MapNotify", &XEvents::handle_mapnotify);
+    add_method(UnmapNotify, "UnmapNotify", &XEvents::handle_unmapnotify);
+    add_method(Expose, "Expose", &XEvents::handle_expose);
+    add_method(EnterNotify, "EnterNotify", &XEvents::handle_enternotify);
+    add_method(LeaveNotify, "LeaveNotify", &XEvents::handle_leavenotify);
+    add_method(PropertyNotify, "PropertyNotify", &XEvents::handle_propertynotify);
+    add_method(DestroyNotify, "DestroyNotify", &XEvents::handle_destroynotify);
+    add_method(ConfigureRequest, "ConfigureRequest", &XEvents::handle_configurerequest);
+    add_method(MapRequest, "MapRequest", &XEvents::handle_maprequest);
+    add_method(CirculateRequest, "CirculateRequest", &XEvents::handle_circulaterequest);
+}
 
-    if (m_event.type == KeyPress) handle_keypress();
+/**
+ * Dispatches an event type to one of XEvents' own handlers.
+ * @return true if the handler was added, false if the type is invalid or
+ * already handled.
+ */
+bool XEvents::add_method(int type, const char *name, EventMethod method) {
+    if (type < 0 || type >= MAX_EVENT_TYPES || m_dispatch[type].name) return false;
 
-    if (m_event.type == ButtonPress) handle_buttonpress();
+    m_dispatch[type].name = name;
+    m_dispatch[type].method = method;
+    return true;
+}
 
-    if (m_event.type == ButtonRelease) handle_buttonrelease();
+/**
+ * Dispatches an event type to a handler outside of XEvents.
+ * @param type The type of event to handle.
+ * @param name The name of the event type, which is shown in dumps.
+ * @param handler The handler, which must outlive XEvents.
+ * @return true if the handler was added, false if the type is invalid or
+ * already handled.
+ */
+bool XEvents::add_handler(int type, const char *name, XEventHandler *handler) {
+    if (type < 0 || type >= MAX_EVENT_TYPES || m_dispatch[type].name) return false;
 
-    if (m_event.type == MotionNotify) handle_motionnotify();
+    m_dispatch[type].name = name;
+    m_dispatch[type].handler = handler;
+    return true;
+}
 
-    if (m_event.type == ConfigureNotify) handle_configurenotify();
+/**
+ * Dispatches one of an extension's events to a handler outside of XEvents.
+ * @param event_base The first event code of the extension, as reported by
+ * XQueryExtension (or the extension's own QueryExtension call).
+ * @param offset Which of the extension's events to handle (RRNotify,
+ * XkbEventCode, XSyncAlarmNotify, etc.)
+ * @param name The name of the event, which is shown in dumps.
+ * @param handler The handler, which must outlive XEvents.
+ * @return true if the handler was added, false otherwise.
+ */
+bool XEvents::add_extension_handler(int event_base, int offset,
+                                    const char *name, XEventHandler *handler) {
+    // Extension events always come after the core ones
+    if (event_base < LASTEvent) return false;
 
-    if (m_event.type == MapNotify) handle_mapnotify();
+    return add_handler(event_base + offset, name, handler);
+}
 
-    if (m_event.type == UnmapNotify) handle_unmapnotify();
+/**
+ * Dispatches the GenericEvents of an extension (such as XInput2) to a handler
+ * outside of XEvents. The handler is responsible for getting the event's data
+ * with XGetEventData.
+ * @param extension The extension's major opcode.
+ * @param name The name of the extension's events, which is shown in dumps.
+ * @param handler The handler, which must outlive XEvents.
+ * @return true if the handler was added, false if the extension is already
+ * handled.
+ */
+bool XEvents::add_generic_handler(int extension, const char *name,
+                                  XEventHandler *handler) {
+    if (m_generic_dispatch.count(extension)) return false;
+
+    Dispatch &entry = m_generic_dispatch[extension];
+    entry.name = name;
+    entry.handler = handler;
+    return true;
+}
 
-    if (m_event.type == Expose) handle_expose();
+/**
+ * Writes out how many events of each type have been dispatched.
+ */
+void XEvents::dump(std::ostream &output) {
+    output << "Events\n";
 
-    if (m_event.type == DestroyNotify) handle_destroynotify();
+    for (int type = 0; type < MAX_EVENT_TYPES; type++) {
+        const Dispatch &entry = m_dispatch[type];
 
-    if (m_event.type == ConfigureRequest) handle_configurerequest();
+        if (entry.name)
+            output << "  " << entry.name << ": " << std::dec << entry.count << "\n";
+    }
 
-    if (m_event.type == MapRequest) handle_maprequest();
+    for (std::map<int, Dispatch>::iterator generic = m_generic_dispatch.begin();
+         generic != m_generic_dispatch.end();
+         generic++) {
+        output << "  " << generic->second.name << ": " << std::dec <<
+            generic->second.count << "\n";
+    }
 
-    if (m_event.type == CirculateRequest) handle_circulaterequest();
+    output << "  Unhandled: " << std::dec << m_unhandled << "\n";
 
-    return !m_done;
+    m_limiter.dump(output);
+}
+
+/**
+ * Writes out the event counters as Prometheus samples - one for each event
+ * type, one for events without a handler, and the request limiter's counters.
+ */
+void XEvents::metrics(MetricsWriter &output) {
+    output.family("smallwm_events_total", "counter",
+                  "X events dispatched, by type.");
+
+    for (int type = 0; type < MAX_EVENT_TYPES; type++) {
+        const Dispatch &entry = m_dispatch[type];
+
+        if (entry.name)
+            output.sample("smallwm_events_total", "type", entry.name, entry.count);
+    }
+
+    for (std::map<int, Dispatch>::iterator generic = m_generic_dispatch.begin();
+         generic != m_generic_dispatch.end();
+         generic++) {
+        output.sample("smallwm_events_total", "type", generic->second.name,
+                      generic->second.count);
+    }
+
+    output.family("smallwm_events_unhandled_total", "counter",
+                  "X events which nothing handles.");
+    output.sample("smallwm_events_unhandled_total", m_unhandled);
+
+    m_limiter.metrics(output);
 }
 
 /**
@@ -70,16 +240,20 @@ void XEvents::handle_keypress() {
     KeyBinding binding(key, is_using_secondary_action);
     KeyboardAction action = m_config.key_commands.binding_to_action[binding];
 
+    m_probe.begin_action(action, m_event.xkey.time);
+
     switch (action) {
         case CLIENT_NEXT_DESKTOP:
 
-            if (is_client) m_clients.client_next_desktop(client);
+            if (is_client && m_config.group_actions) m_clients.client_next_desktop_group(client);
+            else if (is_client) m_clients.client_next_desktop(client);
 
             break;
 
         case CLIENT_PREV_DESKTOP:
 
-            if (is_client) m_clients.client_prev_desktop(client);
+            if (is_client && m_config.group_actions) m_clients.client_prev_desktop_group(client);
+            else if (is_client) m_clients.client_prev_desktop(client);
 
             break;
 
@@ -93,13 +267,15 @@ void XEvents::handle_keypress() {
 
         case TOGGLE_STICK:
 
-            if (is_client) m_clients.toggle_stick(client);
+            if (is_client && m_config.group_actions) m_clients.toggle_stick_group(client);
+            else if (is_client) m_clients.toggle_stick(client);
 
             break;
 
         case ICONIFY:
 
-            if (is_client) m_clients.iconify(client);
+            if (is_client && m_config.group_actions) m_clients.iconify_group(client);
+            else if (is_client) m_clients.iconify(client);
 
             break;
 
@@ -217,6 +393,19 @@ void XEvents::handle_keypress() {
             m_clients.cycle_focus_backward();
             break;
 
+        case MOVE_UP:
+        case MOVE_DOWN:
+        case MOVE_LEFT:
+        case MOVE_RIGHT:
+        case GROW_WIDTH:
+        case SHRINK_WIDTH:
+        case GROW_HEIGHT:
+        case SHRINK_HEIGHT:
+
+            if (is_client) nudge(client, action);
+
+            break;
+
         case EXIT_WM:
             m_done = true;
             break;
@@ -232,6 +421,8 @@ void XEvents::handle_keypress() {
  *  - Focusing a window
  */
 void XEvents::handle_buttonpress() {
+    m_probe.begin("button-press", m_event.xbutton.time);
+
     // We have to test both the window and the subwindow, because we might want
     // to route to the parent or the child, depending upon the event
     bool is_client = false;
@@ -265,31 +456,13 @@ void XEvents::handle_buttonpress() {
     if (!(is_client || is_child || icon)
         && m_event.xbutton.button == LAUNCH_BUTTON
         && m_event.xbutton.state & m_xdata.primary_mod_flag) {
-        if (!fork()) {
-            /*
-             * Here's why 'exec' is used in two different ways. First, it is
-             * important to have /bin/sh process the shell command since it
-             * supports argument parsing, which eases our burden dramatically.
-             *
-             * Now, consider the process sequence as depicted below (where 'xterm'
-             * is the user's chosen shell).
-             *
-             * fork()
-             * [creates process] ==> execl(/bin/sh, -c, /bin/sh, exec xterm)
-             * # Somewhere in the /bin/sh source...
-             * [creates process] ==> execl(/usr/bin/xterm, /usr/bin/xterm)
-             *
-             * If we used std::system instead, then the first process after fork()
-             * would stick around to get the return code from the /bin/sh. If 'exec'
-             * were not used in the /bin/sh command line, then /bin/sh would stick
-             * around waiting for /usr/bin/xterm.
-             *
-             * So, to avoid an extra smallwm process sticking around, _or_ an
-             * unnecessary /bin/sh process sticking around, use 'exec' twice.
-             */
-            std::string shell = std::string("exec ") + m_config.shell;
-            execl("/bin/.hpp", "/bin/.hpp", "-c", shell.c_str(), NULL);
-            exit(1);
+        // Showing a warm shell only takes a map request, but if there isn't
+        // one ready then a new one has to be started the slow way
+        if (m_config.warm_terminals == 0) launch_shell();
+        else {
+            if (m_clients.reveal_warm_client() == None) launch_shell();
+
+            m_warm_timer.arm(WARM_REFILL_DELAY);
         }
     } else if (icon) {
         // Any click on an icon, whether or not the action modifier is
@@ -324,6 +497,8 @@ void XEvents::handle_buttonrelease() {
     // If this is *not* the current placeholder, then bail
     if (expected_placeholder != m_event.xbutton.window) return;
 
+    m_probe.begin("button-release", m_event.xbutton.time);
+
     MoveResizeState state = m_xmodel.get_move_resize_state();
     Window client = m_xmodel.get_move_resize_client();
 
@@ -354,6 +529,9 @@ void XEvents::handle_configurenotify() {
 
     if (!m_clients.is_client(client)) return;
 
+    m_clients.update_location(client,
+                              m_event.xconfigure.x,
+                              m_event.xconfigure.y);
     m_clients.update_size(client,
                           m_event.xconfigure.width,
                           m_event.xconfigure.height);
@@ -376,22 +554,31 @@ void XEvents::handle_configurenotify() {
  *  - A client which is remapping itself, possibly from another desktop
  */
 void XEvents::handle_mapnotify() {
-    Window being_mapped = m_event.xmap.window;
+    // Windows tend to be mapped in bursts (especially when a session starts
+    // up), so every MapNotify that is next in line is handled along with this
+    // one, and all their windows are adopted together
+    std::vector<Window> to_adopt;
+
+    do {
+        Window being_mapped = m_event.xmap.window;
+
+        // This has to bypass the expect check, since this needs to happen to
+        // every mapped window, and we don't have another way to do this for
+        // windows that are (for example) deiconified
+        if (m_clients.is_packed_client(being_mapped)) {
+            PackCorner corner = m_clients.get_pack_corner(being_mapped);
+            m_clients.repack_corner(corner);
+        }
 
-    // This has to bypass the expect check, since this needs to happen to every
-    // mapped window, and we don't have another way to do this for windows that
-    // are (for example) deiconified
-    if (m_clients.is_packed_client(being_mapped)) {
-        PackCorner corner = m_clients.get_pack_corner(being_mapped);
-        m_clients.repack_corner(corner);
-    }
+        if (m_xmodel.has_effect(being_mapped, EXPECT_MAP)) {
+            m_xmodel.clear_effect(being_mapped, EXPECT_MAP);
+            continue;
+        }
 
-    if (m_xmodel.has_effect(being_mapped, EXPECT_MAP)) {
-        m_xmodel.clear_effect(being_mapped, EXPECT_MAP);
-        return;
-    }
+        to_adopt.push_back(being_mapped);
+    } while (m_xdata.take_next_event(m_event, MapNotify));
 
-    add_window(being_mapped);
+    if (!to_adopt.empty()) add_windows(to_adopt);
 }
 
 /**
@@ -408,9 +595,109 @@ void XEvents::handle_unmapnotify() {
         return;
     }
 
+    // A dock which withdraws itself no longer needs its space
+    m_clients.remove_strut(being_unmapped);
     m_clients.unmap_client(being_unmapped);
 }
 
+/**
+ * Moves or resizes a client from the keyboard. Unlike moving or resizing with
+ * the mouse, this changes the client directly rather than going through a
+ * placeholder.
+ *
+ * Any autorepeats of the key which are already queued are folded into this
+ * press, so holding the key down costs one move or resize per pass through
+ * the event loop rather than one per autorepeat. The longer the key is held,
+ * the further each autorepeat goes.
+ */
+void XEvents::nudge(Window client, KeyboardAction action) {
+    Time pressed = m_event.xkey.time;
+    int presses = 1 + m_xdata.take_key_repeats(m_event.xkey);
+
+    // Packed clients are placed by their corner, and hidden clients (including
+    // those being moved by the mouse) can't be seen to move
+    if (m_clients.is_packed_client(client) || !m_clients.is_visible(client)) return;
+
+    if (action != m_nudge_action || pressed - m_nudge_time > NUDGE_REPEAT_MSEC) m_nudge_repeats = 0;
+
+    m_nudge_action = action;
+    m_nudge_time = m_event.xkey.time;
+
+    Dimension distance = 0;
+
+    for (int press = 0; press < presses; press++) {
+        unsigned int multiplier = 1 + m_nudge_repeats / NUDGE_ACCEL_PRESSES;
+        distance += m_config.move_step * std::min(multiplier, NUDGE_MAX_MULTIPLIER);
+        m_nudge_repeats++;
+    }
+
+    const Dimension2D location = m_clients.get_location(client);
+    const Dimension2D size = m_clients.get_size(client);
+
+    Dimension x = DIM2D_X(location), y = DIM2D_Y(location);
+    Dimension width = DIM2D_WIDTH(size), height = DIM2D_HEIGHT(size);
+    Dimension min_width = 1, min_height = 1;
+
+    // Don't shrink the client below the smallest size it says it can handle,
+    // which falls back to its base size (ICCCM 4.1.2.3)
+    if (action == SHRINK_WIDTH || action == SHRINK_HEIGHT) {
+        XSizeHints hints = {};
+        m_xdata.get_size_hints(client, hints);
+
+        if (hints.flags & PMinSize) {
+            min_width = std::max(hints.min_width, 1);
+            min_height = std::max(hints.min_height, 1);
+        } else if (hints.flags & PBaseSize) {
+            min_width = std::max(hints.base_width, 1);
+            min_height = std::max(hints.base_height, 1);
+        }
+    }
+
+    switch (action) {
+        case MOVE_UP:
+            y -= distance;
+            break;
+
+        case MOVE_DOWN:
+            y += distance;
+            break;
+
+        case MOVE_LEFT:
+            x -= distance;
+            break;
+
+        case MOVE_RIGHT:
+            x += distance;
+            break;
+
+        case GROW_WIDTH:
+            width += distance;
+            break;
+
+        case SHRINK_WIDTH:
+            width = std::max(width - distance, std::min(width, min_width));
+            break;
+
+        case GROW_HEIGHT:
+            height += distance;
+            break;
+
+        case SHRINK_HEIGHT:
+            height = std::max(height - distance, std::min(height, min_height));
+            break;
+
+        default:
+            return;
+    }
+
+    // A client that the user places by hand isn't snapped anymore
+    m_clients.change_mode(client, CPS_FLOATING);
+
+    if (x != DIM2D_X(location) || y != DIM2D_Y(location)) m_clients.change_location(client, x, y);
+
+    if (width != DIM2D_WIDTH(size) || height != DIM2D_HEIGHT(size)) m_clients.change_size(client, width, height);
+}
+
 /**
  * Handles the motion of the pointer. The only time that this ever applies is
  * when the user has moved the placeholder window - at all other times, this
@@ -471,36 +758,323 @@ void XEvents::handle_expose() {
 
     if (!the_icon) return;
 
+    redraw_icon(the_icon);
+}
+
+/**
+ * Puts a client into the window group named by its WM_HINTS, if it names one.
+ */
+void XEvents::update_group(Window client, const XWMHints &hints) {
+    if (hints.flags & WindowGroupHint) m_clients.set_group(client, hints.window_group);
+    else m_clients.set_group(client, None);
+}
+
+/**
+ * Reads the space that a window reserves for itself, and updates the work
+ * areas if it has changed.
+ * @return true if the window reserves any space, false otherwise.
+ */
+bool XEvents::update_strut(Window window) {
+    Strut strut;
+    bool has_strut = m_xdata.get_strut(window, strut);
+
+    return apply_strut(window, has_strut, strut);
+}
+
+/**
+ * Reserves (or releases) the space that a dock wants, given its strut.
+ * @return true if the window reserves any space, false otherwise.
+ */
+bool XEvents::apply_strut(Window window, bool has_strut, const Strut &strut) {
+    if (!has_strut || strut.empty()) {
+        m_clients.remove_strut(window);
+        return false;
+    }
+
+    m_clients.set_strut(window, strut);
+    return true;
+}
+
+/**
+ * Focuses clients when the pointer enters them, if focus follows the pointer.
+ *
+ * Only the last of a burst of crossings counts, since the pointer has already
+ * left the others - and if there is a hover delay, the pointer has to stay put
+ * for that long before anything is focused. This keeps a sweep of the pointer
+ * across a busy desktop from focusing (and restacking) every client along the
+ * way. Crossings caused by our own restacking and unmapping are ignored, since
+ * the user didn't ask for them.
+ */
+void XEvents::handle_enternotify() {
+    m_xdata.get_latest_event(m_event, EnterNotify);
+
+    const XCrossingEvent &crossing = m_event.xcrossing;
+
+    if (crossing.mode != NotifyNormal || crossing.detail == NotifyInferior) return;
+
+    if (m_xdata.caused_by_layout(crossing)) return;
+
+    Window window = crossing.window;
+
+    if (!m_clients.is_client(window) || window == m_clients.get_focused()) {
+        m_hover_window = None;
+        m_hover_timer.disarm();
+        return;
+    }
+
+    m_hover_window = window;
+    m_hover_time = crossing.time;
+
+    if (m_config.focus_delay == 0) focus_hovered();
+    else m_hover_timer.arm(m_config.focus_delay);
+}
+
+/**
+ * Stops waiting to focus a client once the pointer leaves it.
+ */
+void XEvents::handle_leavenotify() {
+    const XCrossingEvent &crossing = m_event.xcrossing;
+
+    if (crossing.window != m_hover_window) return;
+
+    if (crossing.mode != NotifyNormal || crossing.detail == NotifyInferior) return;
+
+    // Since EnterNotify events are compressed, this may be from before the
+    // pointer came back in
+    if (static_cast<long>(crossing.time - m_hover_time) < 0) return;
+
+    m_hover_window = None;
+    m_hover_timer.disarm();
+}
+
+/**
+ * Focuses the hovered client once the pointer has stayed in it for long
+ * enough.
+ */
+void XEvents::timer_expired(Timer *timer) {
+    if (timer == &m_warm_timer) refill_warm_terminals();
+    else focus_hovered();
+}
+
+/**
+ * Starts the user's shell.
+ * @return The process ID of the shell, or -1 if it couldn't be started.
+ */
+pid_t XEvents::launch_shell() {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        /*
+         * Here's why 'exec' is used in two different ways. First, it is
+         * important to have /bin/sh process the shell command since it
+         * supports argument parsing, which eases our burden dramatically.
+         *
+         * Now, consider the process sequence as depicted below (where 'xterm'
+         * is the user's chosen shell).
+         *
+         * fork()
+         * [creates process] ==> execl(/bin/sh, -c, /bin/sh, exec xterm)
+         * # Somewhere in the /bin/sh source...
+         * [creates process] ==> execl(/usr/bin/xterm, /usr/bin/xterm)
+         *
+         * If we used std::system instead, then the first process after fork()
+         * would stick around to get the return code from the /bin/sh. If 'exec'
+         * were not used in the /bin/sh command line, then /bin/sh would stick
+         * around waiting for /usr/bin/xterm.
+         *
+         * So, to avoid an extra smallwm process sticking around, _or_ an
+         * unnecessary /bin/sh process sticking around, use 'exec' twice.
+         *
+         * This also means that the shell's window has the same process ID as
+         * the one returned by fork(), which is how warm shells are recognized.
+         */
+        std::string shell = std::string("exec ") + m_config.shell;
+        execl("/bin/sh", "/bin/sh", "-c", shell.c_str(), NULL);
+        exit(1);
+    }
+
+    return pid;
+}
+
+/**
+ * Starts another warm shell, if the pool isn't full. Warm shells are
+ * recognized by the _NET_WM_PID of their windows, and are kept hidden on the
+ * warm desktop until they are launched.
+ *
+ * Only one shell is started at a time, and the next one waits for another
+ * WARM_REFILL_DELAY, so that filling the pool is spread out rather than
+ * starting a burst of terminals at once.
+ */
+void XEvents::refill_warm_terminals() {
+    ClientModel::client_range warm = m_clients.clients_of(m_clients.WARM_DESKTOP);
+    unsigned long shells = std::distance(warm.begin(), warm.end()) + m_warm_pending.size();
+
+    if (shells >= m_config.warm_terminals) return;
+
+    pid_t pid = launch_shell();
+
+    if (pid <= 0) return;
+
+    m_warm_pending.push_back(pid);
+
+    if (shells + 1 < m_config.warm_terminals) m_warm_timer.arm(WARM_REFILL_DELAY);
+}
+
+/**
+ * Reaps every child which has exited. Warm shells which exited before they
+ * showed a window will never show one, so they stop being waited on - since
+ * they aren't reaped until now, their pids can't have been reused.
+ */
+void XEvents::reap_children() {
+    pid_t pid;
+
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        std::vector<pid_t>::iterator warm_shell =
+            std::find(m_warm_pending.begin(), m_warm_pending.end(), pid);
+
+        if (warm_shell == m_warm_pending.end()) continue;
+
+        m_warm_pending.erase(warm_shell);
+
+        // The next one would most likely fail the same way, so the pool isn't
+        // refilled again until the user launches a shell
+        m_warm_timer.disarm();
+    }
+}
+
+/**
+ * Focuses the client the pointer is in, if it can still be focused.
+ */
+void XEvents::focus_hovered() {
+    Window window = m_hover_window;
+    m_hover_window = None;
+
+    if (window != None && m_clients.is_client(window) && m_clients.is_visible(window))
+        m_clients.focus(window);
+}
+
+/**
+ * Refetches the properties that are cached for clients whenever the client
+ * changes them. This also notices when the LatencyProbe's marker changes.
+ */
+void XEvents::handle_propertynotify() {
+    Window client = m_event.xproperty.window;
+
+    if (m_probe.is_marker(client)) {
+        m_probe.complete(m_event.xproperty.time);
+        return;
+    }
+
+    if (m_xdata.is_strut_property(m_event.xproperty.atom)) {
+        update_strut(client);
+        return;
+    }
+
+    if (!m_clients.is_client(client)) return;
+
+    unsigned int flags = m_properties.flags_for_atom(m_event.xproperty.atom);
+
+    if (flags != 0) m_properties.request(client, flags);
+}
+
+#ifdef WITH_THUMBNAILS
+/**
+ * Notes that a client's contents have changed since its thumbnail was
+ * captured. Nothing is captured here - that waits until the client is
+ * iconified, which is the only time the thumbnail is visible.
+ */
+void XEvents::handle_damagenotify() {
+    XDamageNotifyEvent *event = reinterpret_cast<XDamageNotifyEvent *>(&m_event);
+    Thumbnail *thumbnail = m_xmodel.find_thumbnail(event->drawable);
+
+    if (thumbnail) thumbnail->stale = true;
+}
+#endif
+
+/**
+ * Redraws a client's icon after its properties have been fetched.
+ * @param window The client whose properties changed.
+ */
+void XEvents::properties_changed(Window window) {
+    const WindowProperties *properties = m_properties.find(window);
+
+    // Clients can join or leave a window group by changing their WM_HINTS
+    if (properties && properties->has_hints) update_group(window, properties->hints);
+
+    Icon *the_icon = m_xmodel.find_icon_from_client(window);
+
+    if (the_icon) redraw_icon(the_icon);
+}
+
+/**
+ * Draws the contents of an icon - the application's icon, if it has one,
+ * and the application's name.
+ *
+ * @param the_icon The icon to draw.
+ */
+void XEvents::redraw_icon(Icon *the_icon) {
     // Avoid drawing over the current contents of the icon
     the_icon->gc->clear();
 
-    int text_x_offset;
+    int text_x_offset = 0;
 
-    if (m_config.show_icons) {
-        // Get the application's pixmap icon, and figure out where to place
-        // the text (since the icon goes to the left)
-        XWMHints hints;
-        bool has_hints = m_xdata.get_wm_hints(the_icon->client, hints);
+    std::string preferred_icon_name;
 
-        if (has_hints && hints.flags & IconPixmapHint) {
-            // Copy the pixmap into the left side of the icon, keeping
-            // its size. The width of the pixmap is the same as the
-            // X offset of the window name (no padding is done here).
-            Dimension2D pixmap_size = the_icon->gc->copy_pixmap(
-                hints.icon_pixmap, 0, 0);
-            text_x_offset = DIM2D_WIDTH(pixmap_size);
-        } else text_x_offset = 0;
-    } else text_x_offset = 0;
+    const WindowProperties *properties = m_properties.find(the_icon->client);
+    bool show_icons = m_config.show_icons;
 
-    std::string preferred_icon_name;
+    #ifdef WITH_THUMBNAILS
+    // A thumbnail of the client takes the place of its application icon
+    Thumbnail *thumbnail = m_xmodel.find_thumbnail(the_icon->client);
+
+    if (thumbnail && thumbnail->pixmap != None) {
+        the_icon->gc->copy_pixmap(thumbnail->pixmap, 0, 0,
+                                  thumbnail->width, thumbnail->height);
+        text_x_offset = thumbnail->width;
+        show_icons = false;
+    }
+    #endif
+
+    if (properties) {
+        // The properties were fetched in the background, so drawing the icon
+        // doesn't have to wait on the X server at all
+        if (show_icons) {
+            const IconImage &image = properties->best_icon();
+
+            if (image.pixmap != None) {
+                the_icon->gc->copy_pixmap(image.pixmap, 0, 0,
+                                          image.width, image.height);
+                text_x_offset = image.width;
+            }
+        }
 
-    m_xdata.get_icon_name(the_icon->client, preferred_icon_name);
+        preferred_icon_name = properties->icon_name;
+    } else {
+        if (show_icons) {
+            // Get the application's pixmap icon, and figure out where to place
+            // the text (since the icon goes to the left)
+            XWMHints hints;
+            bool has_hints = m_xdata.get_wm_hints(the_icon->client, hints);
+
+            if (has_hints && hints.flags & IconPixmapHint) {
+                // Copy the pixmap into the left side of the icon, keeping
+                // its size. The width of the pixmap is the same as the
+                // X offset of the window name (no padding is done here).
+                Dimension2D pixmap_size = the_icon->gc->copy_pixmap(
+                    hints.icon_pixmap, 0, 0);
+                text_x_offset = DIM2D_WIDTH(pixmap_size);
+            }
+        }
 
-    // The one thing that is strange here is that the Y offset is the entire
-    // icon's height. This is because Xlib draws the text, starting at the
-    // Y offset, from *bottom* to *top*. I don't know why.
-    the_icon->gc->draw_string(text_x_offset, m_config.icon_height,
-                              preferred_icon_name);
+        m_xdata.get_icon_name(the_icon->client, preferred_icon_name);
+    }
+
+    // The label gets whatever space the pixmap didn't take up, and is cut
+    // short if it doesn't fit
+    the_icon->gc->draw_label(text_x_offset,
+                             m_config.icon_width - text_x_offset,
+                             m_config.icon_height,
+                             preferred_icon_name);
 }
 
 /**
@@ -513,6 +1087,21 @@ void XEvents::handle_destroynotify() {
     Window destroyed_window = m_event.xdestroywindow.window;
 
     m_xmodel.remove_all_effects(destroyed_window);
+    m_xmodel.forget_pid(destroyed_window);
+    m_limiter.forget(destroyed_window);
+    m_properties.forget(destroyed_window);
+    m_clients.remove_strut(destroyed_window);
+
+    #ifdef WITH_THUMBNAILS
+    // The damage object goes away along with the window
+    Thumbnail *thumbnail = m_xmodel.find_thumbnail(destroyed_window);
+
+    if (thumbnail) {
+        if (thumbnail->pixmap != None) m_xdata.free_pixmap(thumbnail->pixmap);
+
+        m_xmodel.forget_thumbnail(destroyed_window);
+    }
+    #endif
 
     if (m_clients.is_client(destroyed_window)) {
         // Ensure to re-pack if we're removing something that should be
@@ -534,12 +1123,62 @@ void XEvents::handle_destroynotify() {
 }
 
 /**
- * Handles requests from clients to configure themselves. These may or may not
- * be allowed, depending upon the window's current mode and the nature of the
- * request.
+ * Handles requests from clients to configure themselves, once the client's
+ * rate limit allows it.
  */
 void XEvents::handle_configurerequest() {
-    Window client = m_event.xconfigurerequest.window;
+    Window window = m_event.xconfigurerequest.window;
+
+    if (m_limiter.admit(m_event, request_owner(window))) apply_request(m_event);
+}
+
+/**
+ * Allows clients to map themselves, once the client's rate limit allows it.
+ * This is only necessary because SubstructureRedirectMask includes it.
+ */
+void XEvents::handle_maprequest() {
+    Window window = m_event.xmaprequest.window;
+
+    if (adopt_warm_shell(window)) return;
+
+    if (m_limiter.admit(m_event, request_owner(window))) apply_request(m_event);
+}
+
+/**
+ * Allows clients to restack their subwindows, once the client's rate limit
+ * allows it.
+ */
+void XEvents::handle_circulaterequest() {
+    Window window = m_event.xcirculaterequest.window;
+
+    if (m_limiter.admit(m_event, request_owner(window))) apply_request(m_event);
+}
+
+/**
+ * Applies a request which the rate limiter held back for a while.
+ */
+void XEvents::request_released(XEvent &request) {
+    apply_request(request);
+}
+
+/**
+ * Carries out a configure, map or circulate request.
+ *
+ * Configure requests may or may not be allowed, depending upon the window's
+ * current mode and the nature of the request. Circulate requests are allowed,
+ * but only because they should be affecting subwindows instead of nested
+ * windows.
+ */
+void XEvents::apply_request(XEvent &request) {
+    if (request.type == MapRequest) {
+        m_xdata.map_win(request.xmaprequest.window);
+        return;
+    } else if (request.type == CirculateRequest) {
+        m_xdata.forward_circulate_request(request);
+        return;
+    }
+
+    Window client = request.xconfigurerequest.window;
 
     // If we're not dealing with a window we manage, then allow it to do what
     // it wants. Note that we also give nearly free reign to children, since
@@ -551,11 +1190,11 @@ void XEvents::handle_configurerequest() {
             CWX | CWY | CWWidth | CWHeight :
             0;
 
-        m_xdata.forward_configure_request(m_event, allowed_flags);
+        m_xdata.forward_configure_request(request, allowed_flags);
         return;
     }
 
-    int modify_flags = m_event.xconfigurerequest.value_mask;
+    int modify_flags = request.xconfigurerequest.value_mask;
     int allowed_flags = 0;
 
     int change_pos = modify_flags & CWX || modify_flags & CWY;
@@ -569,23 +1208,17 @@ void XEvents::handle_configurerequest() {
 
     modify_flags &= allowed_flags;
 
-    if (modify_flags != 0) m_xdata.forward_configure_request(m_event, modify_flags);
+    if (modify_flags != 0) m_xdata.forward_configure_request(request, modify_flags);
 }
 
 /**
- * Allows clients to map themselves. This is only necessary because
- * SubstructureRedirectMask includes it.
+ * Finds the client whose rate limit covers a window's requests - this is
+ * the window's parent if it is a child, and the window itself otherwise.
  */
-void XEvents::handle_maprequest() {
-    m_xdata.map_win(m_event.xmaprequest.window);
-}
+Window XEvents::request_owner(Window window) {
+    if (m_clients.is_child(window)) return m_clients.get_parent_of(window);
 
-/**
- * Allow these, but only because they should be affecting subwindows instead of
- * nested windows.
- */
-void XEvents::handle_circulaterequest() {
-    m_xdata.forward_circulate_request(m_event);
+    return window;
 }
 
 /**
@@ -595,60 +1228,145 @@ void XEvents::handle_circulaterequest() {
  * @param window The window to add.
  */
 void XEvents::add_window(Window window) {
-    // First, test if this client is already known to us - if it is, then
-    // move it onto the current desktop
-    if (m_clients.is_client(window)) {
-        Desktop const *mapped_desktop = m_clients.find_desktop(window);
-
-        // Icons must be uniconified
-        if (mapped_desktop->is_icon_desktop()) m_clients.deiconify(window);
-
-        // Moving/resizing clients must stop being moved/resized
-        if (mapped_desktop->is_moving_desktop() || mapped_desktop->is_resizing_desktop()) {
-            Window placeholder = m_xmodel.get_move_resize_placeholder();
-            m_xmodel.exit_move_resize();
-
-            XWindowAttributes placeholder_attr;
-            m_xdata.get_attributes(placeholder, placeholder_attr);
-
-            if (mapped_desktop->is_moving_desktop()) m_clients.stop_moving(window,
-                                                                           Dimension2D(placeholder_attr.x, placeholder_attr.y));
-            else if (mapped_desktop->is_resizing_desktop()) m_clients.stop_resizing(window,
-                                                                                    Dimension2D(placeholder_attr.width, placeholder_attr.height));
-        }
+    add_windows(std::vector<Window>(1, window));
+}
 
-        // Clients which are currently stuck on all desktops don't need to have
-        // anything done to them. Everybody else has to be moved onto the
-        // current desktop.
-        if (!mapped_desktop->is_all_desktop()) m_clients.client_reset_desktop(window);
+/**
+ * Adds several windows at once. Everything that has to be asked of the X
+ * server about the new windows is asked all at once, rather than a window at
+ * a time, and then the windows are added to the model in the order given.
+ *
+ * @param windows The windows to add.
+ */
+void XEvents::add_windows(const std::vector<Window> &windows) {
+    std::vector<WindowAdoption> adoptions;
 
-        // Make sure that it can be accessed by the focus cycle again
-        m_clients.remap_client(window);
+    for (std::vector<Window>::const_iterator window = windows.begin();
+         window != windows.end();
+         window++) {
+        if (!m_clients.is_client(*window)) adoptions.push_back(WindowAdoption(*window));
+    }
 
-        return;
+    if (!adoptions.empty()) m_xdata.get_adoptions(adoptions);
+
+    std::vector<WindowAdoption>::iterator adoption = adoptions.begin();
+
+    for (std::vector<Window>::const_iterator window = windows.begin();
+         window != windows.end();
+         window++) {
+        // A window which appears twice is adopted the first time, and then
+        // treated as an existing client
+        if (adoption != adoptions.end() && adoption->window == *window) {
+            if (m_clients.is_client(*window)) readopt(*window);
+            else adopt(*adoption, false);
+
+            adoption++;
+        } else readopt(*window);
     }
+}
 
-    // So, this isn't an existing client. We have to figure out now if this is
-    // even a client *at all* - override_redirect indicates if this client does
-    // (false) or does not (true) want to be managed. Similarly, InputOnly means
-    // that the window should never be made visible and should never be focused,
-    // so there's nothing we can usefully do to it
-    XWindowAttributes win_attr;
-    m_xdata.get_attributes(window, win_attr);
+/**
+ * Adopts a window which is asking to be mapped, if it belongs to one of the
+ * warm shells. The map request is never carried out, so the shell stays off
+ * the screen until it is revealed.
+ *
+ * This costs a round trip for every map request while warm shells are being
+ * started, since the window's _NET_WM_PID can't be known otherwise.
+ *
+ * @param window The window asking to be mapped.
+ * @return true if the window was adopted as a warm shell, false if it should
+ * be mapped as usual.
+ */
+bool XEvents::adopt_warm_shell(Window window) {
+    if (m_warm_pending.empty() || m_clients.is_client(window)) return false;
 
-    if (win_attr.override_redirect || win_attr.c_class == InputOnly) return;
+    std::vector<WindowAdoption> adoptions(1, WindowAdoption(window));
+    m_xdata.get_adoptions(adoptions);
 
-    // If this is a child window, then register it as such
-    Window parent = m_xdata.get_transient_hint(window);
+    const WindowAdoption &adoption = adoptions[0];
+    std::vector<pid_t>::iterator warm_shell =
+        std::find(m_warm_pending.begin(), m_warm_pending.end(),
+                  static_cast<pid_t>(adoption.pid));
 
-    if (parent != None) {
-        // Make sure that the parent is something that we would also consider
-        // managing
-        XWindowAttributes parent_attr;
-        m_xdata.get_attributes(parent, parent_attr);
+    if (adoption.pid == 0 || warm_shell == m_warm_pending.end()) return false;
 
-        if (parent_attr.override_redirect || parent_attr.c_class == InputOnly) return;
+    m_warm_pending.erase(warm_shell);
+    adopt(adoption, true);
+
+    // Windows which can't be managed (such as override-redirect ones) are
+    // mapped as usual
+    return m_clients.is_client(window);
+}
 
+/**
+ * Handles an existing client being mapped again, by moving it onto the
+ * current desktop.
+ *
+ * @param window The client being mapped.
+ */
+void XEvents::readopt(Window window) {
+    Desktop const *mapped_desktop = m_clients.find_desktop(window);
+
+    // Icons must be uniconified
+    if (mapped_desktop->is_icon_desktop()) m_clients.deiconify(window);
+
+    // Moving/resizing clients must stop being moved/resized
+    if (mapped_desktop->is_moving_desktop() || mapped_desktop->is_resizing_desktop()) {
+        Window placeholder = m_xmodel.get_move_resize_placeholder();
+        m_xmodel.exit_move_resize();
+
+        XWindowAttributes placeholder_attr;
+        m_xdata.get_attributes(placeholder, placeholder_attr);
+
+        if (mapped_desktop->is_moving_desktop()) m_clients.stop_moving(window,
+                                                                       Dimension2D(placeholder_attr.x, placeholder_attr.y));
+        else if (mapped_desktop->is_resizing_desktop()) m_clients.stop_resizing(window,
+                                                                                Dimension2D(placeholder_attr.width, placeholder_attr.height));
+    }
+
+    // Clients which are currently stuck on all desktops don't need to have
+    // anything done to them. Everybody else has to be moved onto the
+    // current desktop.
+    if (!mapped_desktop->is_all_desktop()) m_clients.client_reset_desktop(window);
+
+    // Make sure that it can be accessed by the focus cycle again
+    m_clients.remap_client(window);
+}
+
+/**
+ * Starts managing a window which isn't already a client, using what was
+ * fetched about it by XData::get_adoptions.
+ *
+ * @param adoption The window, and what is known about it.
+ * @param warm Whether the window belongs to a warm shell, which is kept
+ * hidden until it is revealed.
+ */
+void XEvents::adopt(const WindowAdoption &adoption, bool warm) {
+    Window window = adoption.window;
+
+    // Windows which disappeared before we could ask about them have nothing to
+    // manage. Otherwise, we have to figure out now if this is even a client
+    // *at all* - override_redirect indicates if this client does (false) or
+    // does not (true) want to be managed. Similarly, InputOnly means that the
+    // window should never be made visible and should never be focused, so
+    // there's nothing we can usefully do to it
+    if (!adoption.exists || adoption.input_only) return;
+
+    // Docks reserve their space whether or not they want to be managed, and
+    // unmanaged docks have to be watched so that changes to their struts are
+    // noticed
+    if (apply_strut(window, adoption.has_strut, adoption.strut) &&
+        adoption.override_redirect)
+        m_xdata.select_input(window, PropertyChangeMask);
+
+    if (adoption.override_redirect) return;
+
+    // If this is a child window, then register it as such
+    Window parent = adoption.transient_for;
+
+    if (parent != None) {
+        // Clients are always things we manage, but anything else has to be
+        // checked to make sure that we would also consider managing it
         if (m_clients.is_client(parent)) {
             m_clients.add_child(parent, window);
             #ifdef WITH_BORDERS
@@ -656,6 +1374,11 @@ void XEvents::add_window(Window window) {
             #endif
             return;
         }
+
+        XWindowAttributes parent_attr;
+        m_xdata.get_attributes(parent, parent_attr);
+
+        if (parent_attr.override_redirect || parent_attr.c_class == InputOnly) return;
     }
 
     #ifdef WITH_BORDERS
@@ -670,29 +1393,68 @@ void XEvents::add_window(Window window) {
     //  - The client's size (we know this one too)
     //
     //  The information about the initial state is given by XWMHints
-    XWMHints hints;
-    bool has_hints = m_xdata.get_wm_hints(window, hints);
+    const XWMHints &hints = adoption.hints;
+    bool has_hints = adoption.has_hints;
 
     InitialState init_state = IS_VISIBLE;
 
     if (has_hints && hints.flags & StateHint &&
         hints.initial_state == IconicState) init_state = IS_HIDDEN;
 
-    std::string win_class;
-    m_xdata.get_class(window, win_class);
+    // Warm shells stay hidden until they are launched, whatever they ask for
+    if (warm) init_state = IS_WARM;
+
+    if (adoption.pid != 0) {
+        m_xmodel.set_pid(window, adoption.pid);
+
+        if (contains(m_config.freeze_classes.begin(),
+                     m_config.freeze_classes.end(),
+                     adoption.win_class))
+            m_xmodel.set_freezable(window);
+    }
+
     bool should_focus = !contains(m_config.no_autofocus.begin(),
                                   m_config.no_autofocus.end(),
-                                  win_class);
+                                  adoption.win_class);
+
+    Dimension2D location(adoption.x, adoption.y);
+    Dimension2D size(adoption.width, adoption.height);
+
+    // Clients which don't say where they should go are moved to wherever they
+    // cover the least of the other visible clients - this has to be found
+    // before the client itself is one of them
+    Dimension2D free_space = location;
 
-    m_clients.add_client(window, init_state,
-                         Dimension2D(win_attr.x, win_attr.y),
-                         Dimension2D(win_attr.width, win_attr.height),
-                         should_focus);
+    if (init_state == IS_VISIBLE && !adoption.positioned)
+        free_space = m_clients.find_free_space(location, size);
+
+    m_clients.add_client(window, init_state, location, size, should_focus);
+
+    if (free_space != location)
+        m_clients.change_location(window, DIM2D_X(free_space), DIM2D_Y(free_space));
+
+    if (has_hints) update_group(window, hints);
+
+    // Start fetching what the client's icon will need, and keep it up to
+    // date as the client changes it
+    long input_mask = PropertyChangeMask;
+
+    if (m_config.focus_follows_mouse) input_mask |= EnterWindowMask | LeaveWindowMask;
+
+    m_xdata.select_input(window, input_mask);
+    m_properties.request(window, PROP_ALL);
+
+    #ifdef WITH_THUMBNAILS
+    if (m_config.icon_thumbnails) {
+        Thumbnail &thumbnail = m_xmodel.track_thumbnail(window);
+        thumbnail.damage = m_xdata.watch_damage(window);
+    }
+    #endif
 
     // Finally, execute the actions tied to the window's class
 
-    if (m_config.classactions.count(win_class) > 0 && init_state != IS_HIDDEN) {
-        ClassActions &action = m_config.classactions[win_class];
+    if (m_config.classactions.count(adoption.win_class) > 0 && init_state == IS_VISIBLE) {
+        ClassActions &action = m_config.classactions[adoption.win_class];
 
         if (action.actions & ACT_STICK) m_clients.toggle_stick(window);
 
@@ -722,22 +1484,20 @@ void XEvents::add_window(Window window) {
         }
 
         if (action.actions & ACT_MOVE_X || action.actions & ACT_MOVE_Y) {
-            // This is exempt from the typical use for screen sizes, which is
-            // relative to the window (that is, the screen size is the size of
-            // the screen *that the window occupies*). This is because we can't
-            // know what screen the user intended the window to be on.
-            Box screen = m_clients.get_screen(window);
+            // The relative position is within the work area of the screen
+            // that the window was created on
+            Box area = m_clients.get_work_area(window);
 
             m_clients.change_mode(window, CPS_FLOATING);
 
-            Dimension win_x_pos = win_attr.x;
-            Dimension win_y_pos = win_attr.y;
+            Dimension win_x_pos = adoption.x;
+            Dimension win_y_pos = adoption.y;
 
-            if (action.actions & ACT_MOVE_X) win_x_pos = screen.width * action.relative_x;
+            if (action.actions & ACT_MOVE_X) win_x_pos = area.x + area.width * action.relative_x;
 
-            if (action.actions & ACT_MOVE_Y) win_y_pos = screen.height * action.relative_y;
+            if (action.actions & ACT_MOVE_Y) win_y_pos = area.y + area.height * action.relative_y;
 
-            if (win_attr.x != win_x_pos || win_attr.x != win_y_pos) m_clients.change_location(window, win_x_pos, win_y_pos);
+            if (adoption.x != win_x_pos || adoption.y != win_y_pos) m_clients.change_location(window, win_x_pos, win_y_pos);
         }
 
         if (action.actions & ACT_PACK) m_clients.pack_client(window, action.pack_corner, action.pack_priority);
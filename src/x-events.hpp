@@ -3,27 +3,67 @@
 #define __SMALLWM_X_EVENTS__
 
 #include <algorithm>
+#include <map>
+#include <ostream>
+
+#include <sys/types.h>
 
 #include "model/client-model.hpp"
 #include "model/x-model.hpp"
 #include "configparse.hpp"
 #include "common.hpp"
+#include "event-loop.hpp"
+#include "latency-probe.hpp"
+#include "metrics.hpp"
+#include "property-fetcher.hpp"
+#include "request-limiter.hpp"
+#include "timer.hpp"
 #include "utils.hpp"
 #include "xdata.hpp"
 
+/**
+ * Something other than XEvents which handles a kind of X event - usually an
+ * extension's event, from a subsystem which plugs itself into XEvents.
+ */
+class XEventHandler
+{
+public:
+virtual ~XEventHandler() {
+};
+
+/**
+ * Handles an event of a type this handler was registered for.
+ * @param event The event, which is only valid during the call.
+ */
+virtual void handle_event(XEvent &event) = 0;
+};
+
 /**
  * A dispatcher for handling the different type of X events.
  *
  * This serves as the linkage between raw Xlib events, and changes in the
  * client model.
  */
-class XEvents
+class XEvents : public PropertyListener, public TimerListener,
+    public RequestListener
 {
 public:
 XEvents(WMConfig &config, XData &xdata, ClientModel &clients,
-        XModel &xmodel) :
+        XModel &xmodel, EventLoop &loop, PropertyFetcher &properties,
+        LatencyProbe &probe) :
     m_config(config), m_xdata(xdata), m_clients(clients),
-    m_xmodel(xmodel), m_done(false) {
+    m_xmodel(xmodel), m_loop(loop), m_properties(properties),
+    m_probe(probe), m_done(false), m_nudge_action(INVALID_ACTION),
+    m_nudge_time(0), m_nudge_repeats(0),
+    m_hover_timer(loop, this, "hover-focus"), m_hover_window(None),
+    m_hover_time(0), m_warm_timer(loop, this, "warm-terminals"),
+    m_limiter(loop, this, config.request_rate_limit, config.request_rate_burst),
+    m_unhandled(0) {
+    properties.set_listener(this);
+
+    if (config.warm_terminals > 0) m_warm_timer.arm(WARM_REFILL_DELAY);
+    add_core_handlers();
+
     xdata.add_hotkey_mouse(MOVE_BUTTON);
     xdata.add_hotkey_mouse(RESIZE_BUTTON);
     xdata.add_hotkey_mouse(LAUNCH_BUTTON);
@@ -40,6 +80,8 @@ XEvents(WMConfig &config, XData &xdata, ClientModel &clients,
         LAYER_ABOVE,         LAYER_BELOW,             LAYER_TOP,           LAYER_BOTTOM,
         LAYER_1,             LAYER_2,                 LAYER_3,             LAYER_4,        LAYER_5,LAYER_6, LAYER_7, LAYER_8, LAYER_9,
         CYCLE_FOCUS,         CYCLE_FOCUS_BACK,        EXIT_WM,
+        MOVE_UP,             MOVE_DOWN,               MOVE_LEFT,           MOVE_RIGHT,
+        GROW_WIDTH,          SHRINK_WIDTH,            GROW_HEIGHT,         SHRINK_HEIGHT,
         INVALID_ACTION
     };
 
@@ -54,8 +96,56 @@ bool step();
 // Note that this is exposed because smallwm.cpp has to import existing
 // windows when main() runs
 void add_window(Window);
+void add_windows(const std::vector<Window>&);
+
+void properties_changed(Window);
+void timer_expired(Timer *);
+void reap_children();
+void request_released(XEvent&);
+
+bool add_handler(int, const char *, XEventHandler *);
+bool add_extension_handler(int, int, const char *, XEventHandler *);
+bool add_generic_handler(int, const char *, XEventHandler *);
+
+void dump(std::ostream&);
+void metrics(MetricsWriter&);
 
 private:
+/// A handler which is a part of XEvents
+typedef void (XEvents::*EventMethod)();
+
+/**
+ * What to do with one type of event, and how often it has been done.
+ */
+struct Dispatch {
+    Dispatch() :
+        name(0), method(0), handler(0), count(0) {
+    };
+
+    /// The name of the event type, or NULL if nothing handles it
+    const char *name;
+
+    /// The handler, if it is a part of XEvents
+    EventMethod method;
+
+    /// The handler, if it was plugged in from outside of XEvents
+    XEventHandler *handler;
+
+    /// How many events have been dispatched to the handler
+    unsigned long count;
+};
+
+/// Event types are 7 bits wide (the top bit marks events sent by clients)
+static const int MAX_EVENT_TYPES = 128;
+
+/** How long, in milliseconds, to wait after launching a shell before starting
+ * a warm shell, and between starting each of them, so that they don't slow
+ * down the one being shown or anything else the user is doing */
+static const unsigned long WARM_REFILL_DELAY = 1000;
+
+void add_core_handlers();
+bool add_method(int, const char *, EventMethod);
+
 void handle_rrnotify();
 void handle_keypress();
 void handle_buttonpress();
@@ -65,11 +155,31 @@ void handle_configurenotify();
 void handle_mapnotify();
 void handle_unmapnotify();
 void handle_expose();
+void handle_enternotify();
+void handle_leavenotify();
+void handle_propertynotify();
+#ifdef WITH_THUMBNAILS
+void handle_damagenotify();
+#endif
 void handle_destroynotify();
 
 void handle_configurerequest();
 void handle_maprequest();
 void handle_circulaterequest();
+void apply_request(XEvent&);
+Window request_owner(Window);
+
+void redraw_icon(Icon *);
+void nudge(Window, KeyboardAction);
+void focus_hovered();
+pid_t launch_shell();
+void refill_warm_terminals();
+void readopt(Window);
+void adopt(const WindowAdoption&, bool);
+bool adopt_warm_shell(Window);
+bool update_strut(Window);
+bool apply_strut(Window, bool, const Strut&);
+void update_group(Window, const XWMHints&);
 
 /// The currently active event
 XEvent m_event;
@@ -90,8 +200,55 @@ ClientModel &m_clients;
  * about them. */
 XModel &m_xmodel;
 
+/// The loop which waits on X along with everything else
+EventLoop &m_loop;
+
+/// The cache of window properties, which are fetched in the background
+PropertyFetcher &m_properties;
+
+/// Measures how long input events take to have an effect
+LatencyProbe &m_probe;
+
 /// The offset for all RandR generated events
 int m_randroffset;
+
+/// The last keyboard move or resize, which is accelerated if it is repeated
+KeyboardAction m_nudge_action;
+
+/// The server time of the last keyboard move or resize
+Time m_nudge_time;
+
+/// How many times the last keyboard move or resize has repeated
+unsigned int m_nudge_repeats;
+
+/// Waits for the pointer to settle before focusing what it is in
+Timer m_hover_timer;
+
+/// The client the pointer last entered, which will be focused if it stays
+Window m_hover_window;
+
+/// The server time the pointer entered the hovered client
+Time m_hover_time;
+
+/// Waits for things to settle before starting more warm shells
+Timer m_warm_timer;
+
+/** The warm shells which have been started, but which haven't shown their
+ * windows yet */
+std::vector<pid_t> m_warm_pending;
+
+/// Keeps clients from flooding the server with configure and map requests
+RequestLimiter m_limiter;
+
+/// The handler for each event type, indexed by the type
+Dispatch m_dispatch[MAX_EVENT_TYPES];
+
+/** The handlers for GenericEvents (used by XInput2 and the like), indexed by
+ * the major opcode of the extension which sent them */
+std::map<int, Dispatch> m_generic_dispatch;
+
+/// How many events arrived which nothing handles
+unsigned long m_unhandled;
 };
 
 #endif // ifndef __SMALLWM_X_EVENTS__
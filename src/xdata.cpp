@@ -1,5 +1,35 @@
 /** @file */
+#include <random>
+
+#include <X11/Xlib-xcb.h>
+#include <unistd.h>
+
 #include "xdata.hpp"
+#include "object-pool.hpp"
+#include "utils.hpp"
+
+/**
+ * Gets the pool which graphics contexts are allocated from, since one is
+ * created along with every icon.
+ */
+static ObjectPool &gc_pool() {
+    static ObjectPool pool("XGC", sizeof(XGC));
+    return pool;
+}
+
+/**
+ * Allocates a graphics context from the pool.
+ */
+void *XGC::operator new(size_t size) {
+    return gc_pool().allocate();
+}
+
+/**
+ * Returns a graphics context to the pool.
+ */
+void XGC::operator delete(void *memory) {
+    gc_pool().release(memory);
+}
 
 /**
  * Clears the window of the graphics context.
@@ -26,6 +56,109 @@ void XGC::draw_string(Dimension x, Dimension y, const std::string &text) {
     XDrawString(m_display, m_window, m_gc, x, y, text.c_str(), text.size());
 }
 
+/**
+ * Draws a label into the current graphics context, truncating it if it is
+ * too wide to fit.
+ *
+ * With Xft, the truncated and rendered label is kept in a pixmap, so that
+ * redrawing the same label at the same size is a single copy. Without Xft,
+ * this is the same as draw_string.
+ *
+ * @param x The X coordinate of the left of the label.
+ * @param width The space available for the label.
+ * @param height The height of the label (the text is centered within it).
+ * @param text The text to draw.
+ */
+void XGC::draw_label(Dimension x, Dimension width, Dimension height,
+                     const std::string &text) {
+    #ifdef WITH_XFT
+    if (m_style && m_style->font) {
+        if (width <= 0 || height <= 0) return;
+
+        if (m_label == None || text != m_label_text ||
+            width != m_label_width || height != m_label_height) layout_label(width, height, text);
+
+        XCopyArea(m_display, m_label, m_window, m_gc, 0, 0, width, height,
+                  x, 0);
+        return;
+    }
+    #endif
+
+    draw_string(x, height, text);
+}
+
+#ifdef WITH_XFT
+/**
+ * Gets how wide the first part of a string is when drawn with a font.
+ */
+static Dimension text_width(Display *display, XftFont *font,
+                            const std::string &text, size_t length) {
+    XGlyphInfo extents;
+
+    XftTextExtents8(display, font,
+                    reinterpret_cast<const FcChar8 *>(text.c_str()), length,
+                    &extents);
+    return extents.xOff;
+}
+
+/**
+ * Truncates and renders a label into the label pixmap.
+ * @param width The width of the label.
+ * @param height The height of the label.
+ * @param text The text to draw.
+ */
+void XGC::layout_label(Dimension width, Dimension height,
+                       const std::string &text) {
+    int screen = DefaultScreen(m_display);
+
+    if (m_label == None || width != m_label_width || height != m_label_height) {
+        if (m_label != None) XFreePixmap(m_display, m_label);
+
+        m_label = XCreatePixmap(m_display, m_window, width, height,
+                                DefaultDepth(m_display, screen));
+        m_label_width = width;
+        m_label_height = height;
+    }
+
+    m_label_text = text;
+
+    XSetForeground(m_display, m_gc, WhitePixel(m_display, screen));
+    XFillRectangle(m_display, m_label, m_gc, 0, 0, width, height);
+    XSetForeground(m_display, m_gc, BlackPixel(m_display, screen));
+
+    // Window names are Latin-1, so every byte is a character - find the
+    // longest prefix which fits alongside the ellipsis
+    static const std::string ellipsis("...");
+    std::string shown = text;
+
+    if (text_width(m_display, m_style->font, text, text.size()) > width) {
+        Dimension available = width -
+                              text_width(m_display, m_style->font, ellipsis, ellipsis.size());
+        size_t fits = 0, too_long = text.size();
+
+        while (too_long - fits > 1) {
+            size_t middle = (fits + too_long) / 2;
+
+            if (text_width(m_display, m_style->font, text, middle) <= available) fits = middle;
+            else too_long = middle;
+        }
+
+        shown = text.substr(0, fits) + ellipsis;
+    }
+
+    if (shown.empty()) return;
+
+    XftDraw *draw = XftDrawCreate(m_display, m_label, m_style->visual,
+                                  m_style->colormap);
+    Dimension baseline = (height + m_style->font->ascent - m_style->font->descent) / 2;
+
+    XftDrawString8(draw, &m_style->color, m_style->font, 0, baseline,
+                   reinterpret_cast<const FcChar8 *>(shown.c_str()),
+                   shown.size());
+    XftDrawDestroy(draw);
+}
+#endif
+
 /**
  * Copies the contents of a pixmap onto this graphics context.
  * @param pixmap The pixmap to copy.
@@ -41,6 +174,7 @@ Dimension2D XGC::copy_pixmap(Drawable pixmap, Dimension x, Dimension y) {
 
     unsigned int pix_width, pix_height;
 
+    m_round_trips++;
     XGetGeometry(m_display, pixmap, &_u1, &_u2, &_u2,
                  &pix_width, &pix_height, &_u3, &_u3);
 
@@ -52,6 +186,185 @@ Dimension2D XGC::copy_pixmap(Drawable pixmap, Dimension x, Dimension y) {
     return Dimension2D(pix_width, pix_height);
 }
 
+/**
+ * Copies the contents of a pixmap whose size is already known onto this
+ * graphics context. Unlike the other copy_pixmap, this doesn't have to wait
+ * on the X server.
+ * @param pixmap The pixmap to copy.
+ * @param x The X coordinate of the target area.
+ * @param y The Y coordinate of the target area.
+ * @param width The width of the pixmap.
+ * @param height The height of the pixmap.
+ */
+void XGC::copy_pixmap(Drawable pixmap, Dimension x, Dimension y,
+                      Dimension width, Dimension height) {
+    XCopyArea(m_display, pixmap, m_window, m_gc, 0, 0, width, height, x, y);
+}
+
+#ifdef WITH_XFT
+/**
+ * Releases the label font.
+ */
+XData::~XData() {
+    if (m_label_style.font) {
+        XftColorFree(m_display, m_label_style.visual, m_label_style.colormap,
+                     &m_label_style.color);
+        XftFontClose(m_display, m_label_style.font);
+    }
+}
+#endif
+
+/**
+ * Loads the font used to draw labels. If SmallWM wasn't built with Xft, or
+ * the font can't be loaded, labels are drawn with the core X font instead.
+ * @param name The Fontconfig pattern of the font to use.
+ */
+void XData::load_label_font(const std::string &name) {
+    #ifdef WITH_XFT
+    m_label_style.font = XftFontOpenName(m_display, m_screen, name.c_str());
+
+    if (!m_label_style.font) {
+        m_logger.log(LOG_WARNING) <<
+            "Could not load icon font '" << name << "' - using the core "
+            "font instead" << Log::endl;
+        return;
+    }
+
+    m_label_style.visual = DefaultVisual(m_display, m_screen);
+    m_label_style.colormap = DefaultColormap(m_display, m_screen);
+    XftColorAllocName(m_display, m_label_style.visual, m_label_style.colormap,
+                      "black", &m_label_style.color);
+    #endif
+}
+
+#ifdef WITH_THUMBNAILS
+/**
+ * Sets up the extensions needed to capture thumbnails of windows, and
+ * redirects all the top-level windows offscreen so that their contents can
+ * be read. The redirection is automatic, so the server still draws them.
+ * @return true if the Composite, Damage and Render extensions are all
+ *         present, false otherwise.
+ */
+bool XData::init_thumbnails() {
+    int _, composite_major = 0, composite_minor = 2;
+
+    if (!XCompositeQueryExtension(m_display, &_, &_) ||
+        !XCompositeQueryVersion(m_display, &composite_major, &composite_minor) ||
+        (composite_major == 0 && composite_minor < 2)) {
+        m_logger.log(LOG_WARNING) <<
+            "XComposite 0.2 is not available - icon thumbnails are disabled" <<
+            Log::endl;
+        return false;
+    }
+
+    if (!XDamageQueryExtension(m_display, &damage_event_offset, &_)) {
+        m_logger.log(LOG_WARNING) <<
+            "XDamage is not available - icon thumbnails are disabled" <<
+            Log::endl;
+        return false;
+    }
+
+    if (!XRenderQueryExtension(m_display, &_, &_)) {
+        m_logger.log(LOG_WARNING) <<
+            "XRender is not available - icon thumbnails are disabled" <<
+            Log::endl;
+        return false;
+    }
+
+    int damage_major = 1, damage_minor = 1;
+    XDamageQueryVersion(m_display, &damage_major, &damage_minor);
+
+    XCompositeRedirectSubwindows(m_display, m_root, CompositeRedirectAutomatic);
+    return true;
+}
+
+/**
+ * Starts tracking whether the contents of a window have changed. Only one
+ * notification is sent until the damage is cleared by capture_thumbnail,
+ * so a window which redraws constantly doesn't flood the event queue.
+ * @param window The window to watch.
+ * @return The damage object for the window.
+ */
+Damage XData::watch_damage(Window window) {
+    return XDamageCreate(m_display, window, XDamageReportNonEmpty);
+}
+
+/**
+ * Captures the current contents of a window, scaled down to fit within a
+ * given size. This has to be done while the window is still mapped, since
+ * an unmapped window has no contents.
+ * @param window The window to capture.
+ * @param damage The damage object of the window, which is cleared.
+ * @param max_width The maximum width of the thumbnail.
+ * @param max_height The maximum height of the thumbnail.
+ * @param[out] width The width of the thumbnail.
+ * @param[out] height The height of the thumbnail.
+ * @return The thumbnail, or None if the window couldn't be captured.
+ */
+Pixmap XData::capture_thumbnail(Window window, Damage damage,
+                                Dimension max_width, Dimension max_height,
+                                Dimension &width, Dimension &height) {
+    XWindowAttributes attrs;
+
+    m_round_trips++;
+    if (!XGetWindowAttributes(m_display, window, &attrs) ||
+        attrs.map_state != IsViewable) return None;
+
+    XRenderPictFormat *src_format = XRenderFindVisualFormat(m_display, attrs.visual);
+    XRenderPictFormat *dest_format = XRenderFindVisualFormat(
+        m_display, DefaultVisual(m_display, m_screen));
+
+    if (!src_format || !dest_format) return None;
+
+    // The window's pixmap includes its border
+    Dimension src_width = attrs.width + 2 * attrs.border_width;
+    Dimension src_height = attrs.height + 2 * attrs.border_width;
+
+    double scale = std::min(static_cast<double>(max_width) / src_width,
+                            static_cast<double>(max_height) / src_height);
+
+    if (scale > 1) scale = 1;
+
+    width = std::max(1, static_cast<int>(src_width * scale));
+    height = std::max(1, static_cast<int>(src_height * scale));
+
+    // Anything drawn after this point will notify us again
+    XDamageSubtract(m_display, damage, None, None);
+
+    Pixmap contents = XCompositeNameWindowPixmap(m_display, window);
+    Picture src = XRenderCreatePicture(m_display, contents, src_format, 0, NULL);
+
+    XTransform transform = {{
+        { XDoubleToFixed(1 / scale), XDoubleToFixed(0), XDoubleToFixed(0) },
+        { XDoubleToFixed(0), XDoubleToFixed(1 / scale), XDoubleToFixed(0) },
+        { XDoubleToFixed(0), XDoubleToFixed(0), XDoubleToFixed(1) }
+    }};
+    XRenderSetPictureTransform(m_display, src, &transform);
+    XRenderSetPictureFilter(m_display, src, FilterBilinear, NULL, 0);
+
+    Pixmap thumbnail = XCreatePixmap(m_display, m_root, width, height,
+                                     DefaultDepth(m_display, m_screen));
+    Picture dest = XRenderCreatePicture(m_display, thumbnail, dest_format, 0, NULL);
+
+    XRenderComposite(m_display, PictOpSrc, src, None, dest,
+                     0, 0, 0, 0, 0, 0, width, height);
+
+    XRenderFreePicture(m_display, src);
+    XRenderFreePicture(m_display, dest);
+    XFreePixmap(m_display, contents);
+
+    return thumbnail;
+}
+
+/**
+ * Frees a pixmap created by capture_thumbnail.
+ * @param pixmap The pixmap to free.
+ */
+void XData::free_pixmap(Pixmap pixmap) {
+    XFreePixmap(m_display, pixmap);
+}
+#endif
+
 /**
  * Initializes XRandR on the current display.
  *
@@ -90,6 +403,7 @@ void XData::load_modifier_flags() {
     XDisplayKeycodes(m_display, &min_keycode, &max_keycode);
 
     int keysyms_per_keycode;
+    m_round_trips++;
     KeySym *key_map = XGetKeyboardMapping(m_display,
                                           min_keycode,
                                           max_keycode - min_keycode,
@@ -101,6 +415,7 @@ void XData::load_modifier_flags() {
     caps_mod_flag = 0;
     scroll_mod_flag = 0;
 
+    m_round_trips++;
     XModifierKeymap *mod_map = XGetModifierMapping(m_display);
 
     for (int mod = 0; mod < 8; mod++) {
@@ -184,7 +499,11 @@ void XData::load_modifier_flags() {
  * @return A new XGC for the given window.
  */
 XGC * XData::create_gc(Window window) {
-    return new XGC(m_display, window);
+    #ifdef WITH_XFT
+    return new XGC(m_display, window, m_round_trips, &m_label_style);
+    #else
+    return new XGC(m_display, window, m_round_trips);
+    #endif
 }
 
 /**
@@ -243,6 +562,68 @@ void XData::change_property(Window window, const std::string &prop,
                     type, 32, PropModeReplace, value, elems);
 }
 
+/**
+ * Gets a random token which identifies the running X server. This is kept on
+ * the root window, so it is shared by every SmallWM run against the same
+ * server and goes away when the server exits or resets.
+ * @return The token, which is created if this is the first time it was asked
+ *         for on this server.
+ */
+unsigned long long XData::get_server_session() {
+    Atom actual_type;
+    int actual_format;
+    unsigned long num_items, bytes_after;
+    unsigned char *data = NULL;
+    unsigned long long session = 0;
+
+    m_round_trips++;
+    if (XGetWindowProperty(m_display, m_root, intern_if_needed("_SMALLWM_JOURNAL_SESSION"),
+                           0, 2, false, XA_CARDINAL,
+                           &actual_type, &actual_format, &num_items,
+                           &bytes_after, &data) == Success && data) {
+        // Format 32 properties are given to us as longs, whatever their size
+        const unsigned long *values = reinterpret_cast<const unsigned long *>(data);
+
+        if (actual_format == 32 && num_items == 2)
+            session = (static_cast<unsigned long long>(values[0] & 0xffffffff) << 32) |
+                      (values[1] & 0xffffffff);
+
+        XFree(data);
+    }
+
+    if (session != 0) return session;
+
+    std::random_device random;
+
+    while (session == 0)
+        session = (static_cast<unsigned long long>(random()) << 32) | random();
+
+    long values[] = {
+        static_cast<long>(session >> 32),
+        static_cast<long>(session & 0xffffffff)
+    };
+
+    change_property(m_root, "_SMALLWM_JOURNAL_SESSION", XA_CARDINAL,
+                    reinterpret_cast<unsigned char *>(values), 2);
+    return session;
+}
+
+/**
+ * Gets the file descriptor of the connection to the X server, so that it can
+ * be waited on alongside other file descriptors.
+ */
+int XData::connection_fd() {
+    return ConnectionNumber(m_display);
+}
+
+/**
+ * Checks whether there are events that can be read without blocking. This
+ * also flushes any requests which haven't been sent to the server yet.
+ */
+bool XData::has_pending_events() {
+    return XPending(m_display) > 0;
+}
+
 /**
  * Gets the next event from the X server.
  * @param[in] event The place to store the event.
@@ -260,6 +641,61 @@ void XData::get_latest_event(XEvent &data, int type) {
     while (XCheckTypedEvent(m_display, type, &data));
 }
 
+/**
+ * Takes the next event off of the queue, but only if it has the given type
+ * and has already arrived - this never waits for the X server.
+ * @param[out] data The place to store the event.
+ * @param type The type of event to take.
+ * @return true if an event was taken, false otherwise.
+ */
+bool XData::take_next_event(XEvent &data, int type) {
+    if (XEventsQueued(m_display, QueuedAfterReading) == 0) return false;
+
+    XEvent next;
+    XPeekEvent(m_display, &next);
+
+    if (next.type != type) return false;
+
+    XNextEvent(m_display, &data);
+    return true;
+}
+
+/**
+ * Matches presses and releases of the key given by the XKeyEvent which is
+ * passed as the argument, for XCheckIfEvent.
+ */
+static Bool is_same_key(Display *display, XEvent *event, XPointer arg) {
+    XKeyEvent *key = reinterpret_cast<XKeyEvent *>(arg);
+
+    if (event->type == KeyRelease) return event->xkey.keycode == key->keycode;
+
+    return event->type == KeyPress &&
+           event->xkey.keycode == key->keycode &&
+           event->xkey.state == key->state;
+}
+
+/**
+ * Removes any presses (and releases) of a key which are already queued, which
+ * is what holding down a key and letting it autorepeat produces.
+ * @param[in,out] key The key to look for - its timestamp is changed to that of
+ *                the last press which was removed.
+ * @return How many presses were removed.
+ */
+int XData::take_key_repeats(XKeyEvent &key) {
+    XEvent event;
+    int presses = 0;
+
+    while (XCheckIfEvent(m_display, &event, is_same_key,
+                         reinterpret_cast<XPointer>(&key))) {
+        if (event.type == KeyPress) {
+            presses++;
+            key.time = event.xkey.time;
+        }
+    }
+
+    return presses;
+}
+
 /**
  * Adds a new hotkey - this means that the given key (plus the default
  * modifier) registers an event no matter where it is pressed.
@@ -358,6 +794,7 @@ void XData::add_hotkey_mouse(unsigned int button) {
  */
 void XData::confine_pointer(Window window) {
     if (m_confined == None) {
+        m_round_trips++;
         XGrabPointer(m_display, window, false,
                      PointerMotionMask | ButtonReleaseMask,
                      GrabModeAsync, GrabModeAsync,
@@ -418,6 +855,7 @@ void XData::get_windows(std::vector<Window> &windows) {
     Window *children;
     unsigned int nchildren;
 
+    m_round_trips++;
     XQueryTree(m_display, m_root, &_unused1, &_unused1,
                &children, &nchildren);
 
@@ -438,6 +876,7 @@ void XData::get_pointer_location(Dimension &x, Dimension &y) {
     int _u2;
     unsigned int _u3;
 
+    m_round_trips++;
     XQueryPointer(m_display, m_root, &_u1, &_u1,
                   &x, &y, &_u2, &_u2, &_u3);
 }
@@ -450,6 +889,7 @@ Window XData::get_input_focus() {
     Window new_focus;
     int _unused;
 
+    m_round_trips++;
     XGetInputFocus(m_display, &new_focus, &_unused);
     return new_focus;
 }
@@ -473,6 +913,7 @@ bool XData::set_input_focus(Window window) {
  * @param window The window to map.
  */
 void XData::map_win(Window window) {
+    m_layout_changed = true;
     XMapWindow(m_display, window);
 }
 
@@ -481,6 +922,8 @@ void XData::map_win(Window window) {
  * @param window The window to unmap.
  */
 void XData::unmap_win(Window window) {
+    m_layout_changed = true;
+
     // The unmap handler in x-events assumes that the unmap event was
     // triggered by the client itself, and not us. To keep that assumption
     // intact, we can't raise any UnmapNotify events
@@ -523,6 +966,7 @@ void XData::destroy_win(Window window) {
  * @param[out] attr The storage for the attributes.
  */
 void XData::get_attributes(Window window, XWindowAttributes &attr) {
+    m_round_trips++;
     XGetWindowAttributes(m_display, window, &attr);
 }
 
@@ -578,6 +1022,7 @@ void XData::set_border_width(Window window, Dimension size) {
  * @param y The Y coordinate of the window's new position.
  */
 void XData::move_window(Window window, int x, int y) {
+    m_layout_changed = true;
     disable_substructure_events();
     XMoveWindow(m_display, window, x, y);
     enable_substructure_events();
@@ -590,6 +1035,7 @@ void XData::move_window(Window window, int x, int y) {
  * @param height The height of the window's new size.
  */
 void XData::resize_window(Window window, Dimension width, Dimension height) {
+    m_layout_changed = true;
     disable_substructure_events();
     XResizeWindow(m_display, window, width, height);
     enable_substructure_events();
@@ -600,18 +1046,26 @@ void XData::resize_window(Window window, Dimension width, Dimension height) {
  * @param window The window to raise.
  */
 void XData::raise(Window window) {
+    m_layout_changed = true;
     disable_substructure_events();
     XRaiseWindow(m_display, window);
     enable_substructure_events();
 }
 
 /**
- * Stacks a series of windows.
+ * Stacks a series of windows above every other window.
  * @param windows The windows to stack, in top-to-bottom order.
  */
 void XData::restack(const std::vector<Window> &windows) {
+    if (windows.empty()) return;
+
+    m_layout_changed = true;
     disable_substructure_events();
 
+    // XRestackWindows leaves the first window where it is, and only moves the
+    // rest underneath it
+    XRaiseWindow(m_display, windows.front());
+
     // We have to do some juggling to get a non-const pointer from a const
     // iteartor
     Window *win_ptr = const_cast<Window *>(&(*windows.begin()));
@@ -627,6 +1081,7 @@ void XData::restack(const std::vector<Window> &windows) {
  * @return True if the window has hints, False otherwise.
  */
 bool XData::get_wm_hints(Window window, XWMHints &hints) {
+    m_round_trips++;
     XWMHints *returned_hints = XGetWMHints(m_display, window);
 
     // Since we have to get rid of this later, and it is an unnecessary
@@ -648,6 +1103,7 @@ bool XData::get_wm_hints(Window window, XWMHints &hints) {
 void XData::get_size_hints(Window window, XSizeHints &hints) {
     long _u1;
 
+    m_round_trips++;
     XGetWMNormalHints(m_display, window, &hints, &_u1);
 }
 
@@ -660,6 +1116,7 @@ void XData::get_size_hints(Window window, XSizeHints &hints) {
 Window XData::get_transient_hint(Window window) {
     Window transient = None;
 
+    m_round_trips++;
     XGetTransientForHint(m_display, window, &transient);
     return transient;
 }
@@ -674,6 +1131,7 @@ Window XData::get_transient_hint(Window window) {
 void XData::get_icon_name(Window window, std::string &name) {
     char *icon_name;
 
+    m_round_trips++;
     XGetIconName(m_display, window, &icon_name);
 
     if (icon_name) {
@@ -682,6 +1140,7 @@ void XData::get_icon_name(Window window, std::string &name) {
         return;
     }
 
+    m_round_trips++;
     XFetchName(m_display, window, &icon_name);
 
     if (icon_name) {
@@ -702,6 +1161,7 @@ void XData::get_icon_name(Window window, std::string &name) {
 void XData::get_class(Window win, std::string &xclass) {
     XClassHint *hint = XAllocClassHint();
 
+    m_round_trips++;
     XGetClassHint(m_display, win, hint);
 
     if (hint->res_name) XFree(hint->res_name);
@@ -714,6 +1174,302 @@ void XData::get_class(Window win, std::string &xclass) {
     XFree(hint);
 }
 
+/**
+ * Fills in a strut from the values of _NET_WM_STRUT_PARTIAL (which has 12
+ * values) or _NET_WM_STRUT (which has 4, and always covers whole edges).
+ */
+template <typename T>
+static void decode_strut(const T *values, bool is_partial,
+                         Dimension root_width, Dimension root_height,
+                         Strut &strut) {
+    strut = Strut();
+    strut.left = values[0];
+    strut.right = values[1];
+    strut.top = values[2];
+    strut.bottom = values[3];
+
+    if (is_partial) {
+        strut.left_start_y = values[4];
+        strut.left_end_y = values[5];
+        strut.right_start_y = values[6];
+        strut.right_end_y = values[7];
+        strut.top_start_x = values[8];
+        strut.top_end_x = values[9];
+        strut.bottom_start_x = values[10];
+        strut.bottom_end_x = values[11];
+    } else {
+        strut.left_end_y = root_height - 1;
+        strut.right_end_y = root_height - 1;
+        strut.top_end_x = root_width - 1;
+        strut.bottom_end_x = root_width - 1;
+    }
+}
+
+/**
+ * Gets the space that a dock reserves along the edges of the root window,
+ * from _NET_WM_STRUT_PARTIAL or (for older docks) _NET_WM_STRUT.
+ * @param window The window to get the strut of.
+ * @param[out] strut The space reserved by the window.
+ * @return true if the window has a strut, false otherwise.
+ */
+bool XData::get_strut(Window window, Strut &strut) {
+    const char *names[] = { "_NET_WM_STRUT_PARTIAL", "_NET_WM_STRUT", NULL };
+
+    for (const char **name = &names[0]; *name; name++) {
+        Atom actual_type;
+        int actual_format;
+        unsigned long num_items, bytes_after;
+        unsigned char *data = NULL;
+
+        m_round_trips++;
+        if (XGetWindowProperty(m_display, window, intern_if_needed(*name),
+                               0, 12, false, XA_CARDINAL,
+                               &actual_type, &actual_format, &num_items,
+                               &bytes_after, &data) != Success) continue;
+
+        // Format 32 properties are given to us as longs, whatever their size
+        const long *values = reinterpret_cast<const long *>(data);
+        bool is_partial = name == &names[0];
+
+        if (!data || actual_format != 32 || num_items < (is_partial ? 12 : 4)) {
+            if (data) XFree(data);
+            continue;
+        }
+
+        decode_strut(values, is_partial, DisplayWidth(m_display, m_screen),
+                     DisplayHeight(m_display, m_screen), strut);
+
+        XFree(data);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Waits for the reply to a GetProperty request sent over XCB, throwing away
+ * any error (which happens when the window is already gone).
+ * @return The reply, which must be freed, or NULL if the window doesn't have
+ * the property in the requested type and format.
+ */
+static xcb_get_property_reply_t *property_reply(xcb_connection_t *connection,
+                                                xcb_get_property_cookie_t cookie,
+                                                uint8_t format,
+                                                uint32_t min_items) {
+    xcb_generic_error_t *error = NULL;
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(connection, cookie, &error);
+
+    if (error) free(error);
+
+    if (reply && (reply->format != format || reply->value_len < min_items)) {
+        free(reply);
+        return NULL;
+    }
+
+    return reply;
+}
+
+/**
+ * Fetches what is needed to start managing each of a batch of windows.
+ *
+ * Getting these one at a time through Xlib costs several round trips per
+ * window, which adds up when a whole session's windows are mapped at once.
+ * Instead, the requests for every window in the batch are sent over XCB
+ * before any of the replies are waited on, so that the whole batch takes about
+ * one round trip. The replies are read back in the same order as the batch.
+ *
+ * @param[in,out] adoptions The windows to fetch, which are filled in.
+ */
+void XData::get_adoptions(std::vector<WindowAdoption> &adoptions) {
+    xcb_connection_t *connection = XGetXCBConnection(m_display);
+
+    xcb_atom_t strut_partial_atom = intern_if_needed("_NET_WM_STRUT_PARTIAL"),
+               strut_atom = intern_if_needed("_NET_WM_STRUT"),
+               pid_atom = intern_if_needed("_NET_WM_PID");
+
+    struct Cookies {
+        xcb_get_window_attributes_cookie_t attributes;
+        xcb_get_geometry_cookie_t geometry;
+        xcb_get_property_cookie_t transient_for, hints, normal_hints, win_class,
+                                  strut_partial, strut, pid, client_machine;
+    };
+
+    std::vector<Cookies> cookies(adoptions.size());
+
+    for (size_t i = 0; i < adoptions.size(); i++) {
+        xcb_window_t window = adoptions[i].window;
+        Cookies &cookie = cookies[i];
+
+        cookie.attributes = xcb_get_window_attributes(connection, window);
+        cookie.geometry = xcb_get_geometry(connection, window);
+        cookie.transient_for = xcb_get_property(connection, 0, window, XA_WM_TRANSIENT_FOR,
+                                                XA_WINDOW, 0, 1);
+        cookie.hints = xcb_get_property(connection, 0, window, XA_WM_HINTS,
+                                        XA_WM_HINTS, 0, 9);
+        cookie.normal_hints = xcb_get_property(connection, 0, window, XA_WM_NORMAL_HINTS,
+                                               XA_WM_SIZE_HINTS, 0, 1);
+        cookie.win_class = xcb_get_property(connection, 0, window, XA_WM_CLASS,
+                                            XA_STRING, 0, 256);
+        cookie.strut_partial = xcb_get_property(connection, 0, window, strut_partial_atom,
+                                                XA_CARDINAL, 0, 12);
+        cookie.strut = xcb_get_property(connection, 0, window, strut_atom,
+                                        XA_CARDINAL, 0, 4);
+        cookie.pid = xcb_get_property(connection, 0, window, pid_atom,
+                                      XA_CARDINAL, 0, 1);
+        cookie.client_machine = xcb_get_property(connection, 0, window, XA_WM_CLIENT_MACHINE,
+                                                 XCB_GET_PROPERTY_TYPE_ANY, 0, 64);
+    }
+
+    xcb_flush(connection);
+
+    // Every request was sent before waiting on any reply, so the whole batch
+    // only costs one round trip
+    m_round_trips++;
+
+    Dimension root_width = DisplayWidth(m_display, m_screen),
+              root_height = DisplayHeight(m_display, m_screen);
+
+    // A pid only means anything on the machine it came from (EWMH 1.5)
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+
+    for (size_t i = 0; i < adoptions.size(); i++) {
+        WindowAdoption &adoption = adoptions[i];
+        Cookies &cookie = cookies[i];
+
+        // Every reply has to be read, even if the window turns out to be gone
+        xcb_generic_error_t *error = NULL;
+        xcb_get_window_attributes_reply_t *attributes =
+            xcb_get_window_attributes_reply(connection, cookie.attributes, &error);
+
+        if (error) free(error);
+
+        error = NULL;
+        xcb_get_geometry_reply_t *geometry =
+            xcb_get_geometry_reply(connection, cookie.geometry, &error);
+
+        if (error) free(error);
+
+        xcb_get_property_reply_t *transient_for =
+            property_reply(connection, cookie.transient_for, 32, 1);
+        xcb_get_property_reply_t *hints =
+            property_reply(connection, cookie.hints, 32, 8);
+        xcb_get_property_reply_t *normal_hints =
+            property_reply(connection, cookie.normal_hints, 32, 1);
+        xcb_get_property_reply_t *win_class =
+            property_reply(connection, cookie.win_class, 8, 1);
+        xcb_get_property_reply_t *strut_partial =
+            property_reply(connection, cookie.strut_partial, 32, 12);
+        xcb_get_property_reply_t *strut =
+            property_reply(connection, cookie.strut, 32, 4);
+        xcb_get_property_reply_t *pid =
+            property_reply(connection, cookie.pid, 32, 1);
+        xcb_get_property_reply_t *client_machine =
+            property_reply(connection, cookie.client_machine, 8, 1);
+
+        adoption.exists = attributes && geometry;
+
+        if (adoption.exists) {
+            adoption.override_redirect = attributes->override_redirect;
+            adoption.input_only = attributes->_class == XCB_WINDOW_CLASS_INPUT_ONLY;
+            adoption.x = geometry->x;
+            adoption.y = geometry->y;
+            adoption.width = geometry->width;
+            adoption.height = geometry->height;
+        }
+
+        if (transient_for)
+            adoption.transient_for =
+                static_cast<const xcb_window_t *>(xcb_get_property_value(transient_for))[0];
+
+        if (hints) {
+            // This is the same layout that XGetWMHints decodes - older clients
+            // leave off the window group
+            const uint32_t *values = static_cast<const uint32_t *>(xcb_get_property_value(hints));
+
+            adoption.has_hints = true;
+            adoption.hints.flags = values[0];
+            adoption.hints.input = values[1] != 0;
+            adoption.hints.initial_state = values[2];
+            adoption.hints.icon_pixmap = values[3];
+            adoption.hints.icon_window = values[4];
+            adoption.hints.icon_x = values[5];
+            adoption.hints.icon_y = values[6];
+            adoption.hints.icon_mask = values[7];
+
+            if (hints->value_len >= 9) adoption.hints.window_group = values[8];
+            else adoption.hints.flags &= ~WindowGroupHint;
+        }
+
+        // Only the flags are needed, which come first
+        if (normal_hints) {
+            uint32_t flags = static_cast<const uint32_t *>(xcb_get_property_value(normal_hints))[0];
+            adoption.positioned = (flags & (USPosition | PPosition)) != 0;
+        }
+
+        if (win_class) {
+            // WM_CLASS is the instance name and then the class, each ending
+            // in a NUL
+            const char *value = static_cast<const char *>(xcb_get_property_value(win_class));
+            int length = xcb_get_property_value_length(win_class);
+            const char *instance_end = static_cast<const char *>(std::memchr(value, '\0', length));
+
+            if (instance_end) {
+                const char *class_start = instance_end + 1;
+                const char *class_end = value + length;
+                const char *terminator = static_cast<const char *>(
+                    std::memchr(class_start, '\0', class_end - class_start));
+
+                if (terminator) class_end = terminator;
+
+                adoption.win_class.assign(class_start, class_end);
+            }
+        }
+
+        if (strut_partial) {
+            adoption.has_strut = true;
+            decode_strut(static_cast<const uint32_t *>(xcb_get_property_value(strut_partial)),
+                         true, root_width, root_height, adoption.strut);
+        } else if (strut) {
+            adoption.has_strut = true;
+            decode_strut(static_cast<const uint32_t *>(xcb_get_property_value(strut)),
+                         false, root_width, root_height, adoption.strut);
+        }
+
+        // Trusting a pid from another machine (or one naming init or SmallWM)
+        // would let a client have an unrelated process frozen or moved into
+        // a cgroup
+        if (pid && client_machine) {
+            std::string machine(static_cast<const char *>(xcb_get_property_value(client_machine)),
+                                xcb_get_property_value_length(client_machine));
+            machine.erase(machine.find_last_not_of('\0') + 1);
+
+            unsigned long value = static_cast<const uint32_t *>(xcb_get_property_value(pid))[0];
+
+            if (machine == hostname && is_other_process(value)) adoption.pid = value;
+        }
+
+        free(attributes);
+        free(geometry);
+        free(transient_for);
+        free(hints);
+        free(normal_hints);
+        free(win_class);
+        free(strut_partial);
+        free(strut);
+        free(pid);
+        free(client_machine);
+    }
+}
+
+/**
+ * Checks whether a property is one which gives a dock's strut.
+ */
+bool XData::is_strut_property(Atom atom) {
+    return atom == intern_if_needed("_NET_WM_STRUT_PARTIAL") ||
+           atom == intern_if_needed("_NET_WM_STRUT");
+}
+
 /**
  * Gets a list of screen boxes, to update the ClientModel.
  *
@@ -724,6 +1480,7 @@ void XData::get_class(Window win, std::string &xclass) {
  * The AwesomeWM codebase was helpful in finding out a few things, though.
  */
 void XData::get_screen_boxes(std::vector<Box> &box) {
+    m_round_trips++;
     XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_display, m_root);
 
     // XRandR stores things called 'CRTCs', which is apparently a funny way of
@@ -739,6 +1496,7 @@ void XData::get_screen_boxes(std::vector<Box> &box) {
     for (int crtc_idx = 0; crtc_idx < resources->ncrtc; crtc_idx++) {
         RRCrtc crtc_id = resources->crtcs[crtc_idx];
 
+        m_round_trips++;
         XRRCrtcInfo *crtc = XRRGetCrtcInfo(m_display, resources, crtc_id);
 
         if (!crtc || crtc->width == 0 || crtc->height == 0) continue;
@@ -759,6 +1517,7 @@ KeySym XData::get_keysym(int keycode) {
     KeySym *possible_keysyms;
     int keysyms_per_keycode;
 
+    m_round_trips++;
     possible_keysyms = XGetKeyboardMapping(m_display, keycode, 1,
                                            &keysyms_per_keycode);
 
@@ -824,6 +1583,43 @@ void XData::forward_circulate_request(XEvent &event) {
     XCirculateSubwindows(m_display, event.xcirculaterequest.window, direction);
 }
 
+/**
+ * Marks the end of a batch of layout changes. If anything was mapped, moved or
+ * restacked, the pointer may have crossed into a different window because of
+ * it - a no-op request is sent to mark where those crossings end, so that
+ * they can be told apart from crossings caused by the user moving the pointer.
+ */
+void XData::end_layout() {
+    if (!m_layout_changed) return;
+
+    m_crossing_serial = NextRequest(m_display);
+    XNoOp(m_display);
+    m_layout_changed = false;
+}
+
+/**
+ * Checks whether an EnterNotify or LeaveNotify was caused by our own layout
+ * changes, rather than by the pointer moving.
+ */
+bool XData::caused_by_layout(const XCrossingEvent &event) {
+    // Serials wrap around, so compare them by their difference
+    return static_cast<long>(event.serial - m_crossing_serial) < 0;
+}
+
+/**
+ * Writes out how many requests have been sent to the X server, and how many
+ * of them had to wait for a reply.
+ */
+void XData::metrics(MetricsWriter &output) {
+    output.family("smallwm_x_requests_total", "counter",
+                  "Requests sent to the X server.");
+    output.sample("smallwm_x_requests_total", XNextRequest(m_display) - 1);
+
+    output.family("smallwm_x_round_trips_total", "counter",
+                  "Requests which waited for a reply from the X server.");
+    output.sample("smallwm_x_round_trips_total", m_round_trips);
+}
+
 /**
  * Interns an string, converting it into an atom and caching it. On
  * subsequent calls, the cache is used instead of going through Xlib.
@@ -833,6 +1629,7 @@ void XData::forward_circulate_request(XEvent &event) {
 Atom XData::intern_if_needed(const std::string &atom_name) {
     if (m_atoms.count(atom_name) > 0) return m_atoms[atom_name];
 
+    m_round_trips++;
     Atom the_atom = XInternAtom(m_display, atom_name.c_str(), false);
     m_atoms[atom_name] = the_atom;
     return the_atom;
@@ -2,13 +2,48 @@
 #ifndef __SMALLWM_XDATA__
 #define __SMALLWM_XDATA__
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <map>
+#include <string>
 #include <vector>
 
+#ifdef WITH_XFT
+#include <X11/Xft/Xft.h>
+#endif
+
+#ifdef WITH_THUMBNAILS
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xrender.h>
+#endif
+
 #include "common.hpp"
 #include "logging/logging.hpp"
+#include "metrics.hpp"
+
+#ifdef WITH_XFT
+/**
+ * The font and color used to draw labels with Xft. This is shared between
+ * every XGC, so the glyphs that Xft uploads to the server are shared too.
+ */
+struct LabelStyle {
+    LabelStyle() :
+        font(0), visual(0), colormap(None) {
+    };
+
+    /// The font, or NULL if it couldn't be loaded
+    XftFont *font;
+
+    /// The color of the text
+    XftColor color;
+
+    /// The visual and colormap that labels are drawn with
+    Visual *visual;
+    Colormap colormap;
+};
+#endif
 
 /**
  * An X graphics context which is used to draw on windows.
@@ -16,20 +51,42 @@
 class XGC
 {
 public:
-XGC(Display *dpy, Window window) :
-    m_display(dpy), m_window(window) {
+#ifdef WITH_XFT
+XGC(Display *dpy, Window window, unsigned long &round_trips,
+    const LabelStyle *style) :
+    m_display(dpy), m_window(window), m_round_trips(round_trips),
+    m_style(style), m_label(None), m_label_width(0), m_label_height(0) {
+    m_gc = XCreateGC(dpy, window, 0, NULL);
+};
+#else
+XGC(Display *dpy, Window window, unsigned long &round_trips) :
+    m_display(dpy), m_window(window), m_round_trips(round_trips) {
     m_gc = XCreateGC(dpy, window, 0, NULL);
 };
+#endif
 
 ~XGC() {
+    #ifdef WITH_XFT
+    if (m_label != None) XFreePixmap(m_display, m_label);
+    #endif
+
     XFree(m_gc);
 };
 
+static void *operator new(size_t);
+static void operator delete(void *);
+
 void clear();
 void draw_string(Dimension, Dimension, const std::string&);
+void draw_label(Dimension, Dimension, Dimension, const std::string&);
 Dimension2D copy_pixmap(Drawable, Dimension, Dimension);
+void copy_pixmap(Drawable, Dimension, Dimension, Dimension, Dimension);
 
 private:
+#ifdef WITH_XFT
+void layout_label(Dimension, Dimension, const std::string&);
+#endif
+
 /** The raw X display - this is necessary to have since XData doesn't
  * expose it. */
 Display *m_display;
@@ -38,8 +95,81 @@ Display *m_display;
 /// The window this graphics context belongs to
 Window m_window;
 
+/// XData's count of requests which had to wait for a reply
+unsigned long &m_round_trips;
+
 /// The X graphics context this sits above
 GC m_gc;
+
+#ifdef WITH_XFT
+/// How to draw labels
+const LabelStyle *m_style;
+
+/** The most recently drawn label, already truncated and rendered, so that
+ * redrawing the same label is a single copy */
+Pixmap m_label;
+
+/// The text of the cached label, before truncation
+std::string m_label_text;
+
+/// The size the cached label was laid out for
+Dimension m_label_width, m_label_height;
+#endif
+};
+
+/**
+ * What has to be known about a window before it can be managed. This is
+ * fetched for a whole batch of windows at once - see XData::get_adoptions.
+ */
+struct WindowAdoption {
+    WindowAdoption(Window _window) :
+        window(_window), exists(false), override_redirect(false),
+        input_only(false), x(0), y(0), width(0), height(0),
+        transient_for(None), has_hints(false), positioned(false),
+        has_strut(false), pid(0) {
+        std::memset(&hints, 0, sizeof(hints));
+    };
+
+    /// The window being adopted
+    Window window;
+
+    /// Whether or not the window still existed when it was asked about
+    bool exists;
+
+    /// Whether or not the window wants to be left alone
+    bool override_redirect;
+
+    /// Whether or not the window is InputOnly
+    bool input_only;
+
+    /// The location and size of the window
+    Dimension x, y, width, height;
+
+    /// The window given by WM_TRANSIENT_FOR, or None
+    Window transient_for;
+
+    /// Whether or not the window has WM_HINTS
+    bool has_hints;
+
+    /// The window's WM_HINTS
+    XWMHints hints;
+
+    /** Whether the user or the program chose where the window goes, as given
+     * by WM_NORMAL_HINTS - if not, the window is put wherever is free */
+    bool positioned;
+
+    /// The class given by WM_CLASS, or an empty string
+    std::string win_class;
+
+    /// Whether or not the window reserves space as a dock
+    bool has_strut;
+
+    /// The space that the window reserves
+    Strut strut;
+
+    /** The process given by _NET_WM_PID, or 0 if the window's WM_CLIENT_MACHINE
+     * isn't this machine (or the pid is init's or SmallWM's) */
+    unsigned long pid;
 };
 
 /**
@@ -59,7 +189,8 @@ class XData
 public:
 XData(Log &logger, Display *dpy, Window root, int screen) :
     m_display(dpy), m_logger(logger), m_confined(None),
-    m_old_root_mask(NoEventMask), m_substructure_depth(0) {
+    m_old_root_mask(NoEventMask), m_substructure_depth(0),
+    m_layout_changed(false), m_crossing_serial(0), m_round_trips(0) {
     m_root = DefaultRootWindow(dpy);
     m_screen = DefaultScreen(dpy);
 
@@ -67,17 +198,35 @@ XData(Log &logger, Display *dpy, Window root, int screen) :
     load_modifier_flags();
 };
 
+#ifdef WITH_XFT
+~XData();
+#endif
+
 void init_xrandr();
 void load_modifier_flags();
+void load_label_font(const std::string&);
+
+#ifdef WITH_THUMBNAILS
+bool init_thumbnails();
+Damage watch_damage(Window);
+Pixmap capture_thumbnail(Window, Damage, Dimension, Dimension,
+                         Dimension&, Dimension&);
+void free_pixmap(Pixmap);
+#endif
 
 XGC * create_gc(Window);
 Window create_window(bool);
 
 void change_property(Window, const std::string&, Atom,
                      const unsigned char *, size_t);
+unsigned long long get_server_session();
 
+int connection_fd();
+bool has_pending_events();
 void next_event(XEvent&);
 void get_latest_event(XEvent&, int);
+bool take_next_event(XEvent&, int);
+int take_key_repeats(XKeyEvent&);
 
 void add_hotkey(KeySym, bool);
 void add_hotkey_mouse(unsigned int);
@@ -120,6 +269,9 @@ void get_size_hints(Window, XSizeHints&);
 Window get_transient_hint(Window);
 void get_icon_name(Window, std::string&);
 void get_class(Window, std::string&);
+bool get_strut(Window, Strut&);
+bool is_strut_property(Atom);
+void get_adoptions(std::vector<WindowAdoption>&);
 
 void get_screen_boxes(std::vector<Box>&);
 
@@ -129,9 +281,19 @@ void keysym_to_string(KeySym, std::string&);
 void forward_configure_request(XEvent&, unsigned int);
 void forward_circulate_request(XEvent&);
 
+void end_layout();
+bool caused_by_layout(const XCrossingEvent&);
+
+void metrics(MetricsWriter&);
+
 /// The event code X adds to each XRandR event (used by XEvents)
 int randr_event_offset;
 
+#ifdef WITH_THUMBNAILS
+/// The event code X adds to each XDamage event (used by XEvents)
+int damage_event_offset;
+#endif
+
 unsigned int primary_mod_flag;
 unsigned int secondary_mod_flag;
 
@@ -154,6 +316,17 @@ long m_old_root_mask;
 /// How deep we are inside of a nested group of enable/disable substruture events
 int m_substructure_depth;
 
+/** Whether any windows have been mapped, unmapped, moved, resized or
+ * restacked since the last call to end_layout */
+bool m_layout_changed;
+
+/** The serial of the request sent after the last layout change - crossing
+ * events from before this were caused by us, and not by the pointer */
+unsigned long m_crossing_serial;
+
+/// How many requests have been sent which had to wait for a reply
+unsigned long m_round_trips;
+
 /// The logging interface
 Log &m_logger;
 
@@ -171,6 +344,11 @@ std::map<std::string, Atom> m_atoms;
 
 /// The window the pointer is confined to, or None
 Window m_confined;
+
+#ifdef WITH_XFT
+/// The font used for all the labels drawn by XGCs
+LabelStyle m_label_style;
+#endif
 };
 
 #endif // ifndef __SMALLWM_XDATA__
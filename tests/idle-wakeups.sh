@@ -0,0 +1,69 @@
+#!/bin/sh
+# Checks that an idle SmallWM never wakes up. SmallWM is started on Xvfb with
+# the default configuration and left alone, and the wakeup counters of two
+# dumps taken a few seconds apart are compared.
+#
+# Usage: idle-wakeups.sh <smallwm> [idle seconds]
+
+SMALLWM="$1"
+IDLE_SECONDS="${2:-5}"
+
+# CTest counts this exit code as a skip
+if ! command -v xvfb-run >/dev/null 2>&1; then
+    echo "xvfb-run is not installed - skipping"
+    exit 77
+fi
+
+WORKDIR="$(mktemp -d)"
+trap 'rm -rf "$WORKDIR"' EXIT
+
+# Only the log and the dump are moved somewhere that can be checked
+mkdir -p "$WORKDIR/.config"
+cat > "$WORKDIR/.config/smallwm" <<EOF
+[smallwm]
+log-file=$WORKDIR/log
+dump-file=$WORKDIR/dump
+EOF
+
+cat > "$WORKDIR/run.sh" <<'EOF'
+"$1" &
+WM=$!
+
+# Let SmallWM finish starting up before the first dump
+sleep 2
+kill -USR1 $WM
+sleep "$2"
+kill -USR1 $WM
+
+# The dumps are written out by a worker
+sleep 1
+kill $WM
+wait $WM
+EOF
+
+HOME="$WORKDIR" xvfb-run -a sh "$WORKDIR/run.sh" "$SMALLWM" "$IDLE_SECONDS"
+
+TOTALS="$(awk '/^Wakeups$/ { section = 1; next }
+               /^[^ ]/ { section = 0 }
+               section && $1 == "Total:" { print $2 }' "$WORKDIR/dump" 2>/dev/null)"
+
+if [ "$(echo "$TOTALS" | wc -w)" -ne 2 ]; then
+    echo "Expected two dumps, got: $TOTALS"
+    cat "$WORKDIR/log" 2>/dev/null
+    exit 1
+fi
+
+FIRST="$(echo "$TOTALS" | sed -n 1p)"
+SECOND="$(echo "$TOTALS" | sed -n 2p)"
+
+# The second SIGUSR1 wakes SmallWM up, as does the worker finishing the first
+# dump - anything else happened while it should have been idle
+if [ $((SECOND - FIRST)) -gt 2 ]; then
+    echo "SmallWM woke up $((SECOND - FIRST - 2)) times in $IDLE_SECONDS idle seconds:"
+    awk '/^Wakeups$/ { section = 1; print; next }
+         /^[^ ]/ { section = 0 }
+         section' "$WORKDIR/dump"
+    exit 1
+fi
+
+echo "SmallWM stayed asleep for $IDLE_SECONDS seconds"